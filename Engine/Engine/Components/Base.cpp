@@ -112,8 +112,6 @@ namespace HotBite {
 			}
 
 			Mesh::Mesh() {
-				end_animation_event.SetSender(this);
-				end_animation_event.SetType(EVENT_ID_ANIMATION_END);
 				skeleton_mutex = std::make_shared<std::recursive_mutex>();
 			}
 
@@ -142,7 +140,6 @@ namespace HotBite {
 			void Mesh::SetCoordinatorInfo(ECS::Entity e, ECS::Coordinator* c) {
 				coordinator = c;
 				entity = e;
-				end_animation_event.SetEntity(e);
 			}			
 				
 			void Mesh::SetAnimationDefaultTransitionTime(float time) {
@@ -206,7 +203,7 @@ namespace HotBite {
 				return current_animation.key_frame;
 			}
 
-			matrix Mesh::GetAnimationMatrix(int64_t elapsed_nsec, int64_t total_nsec, std::vector<Core::JointCpuData>* cpu_data, int joint_id, Animation& anim) {
+			matrix Mesh::GetAnimationMatrix(int64_t elapsed_nsec, int64_t total_nsec, std::vector<Core::JointCpuData>* cpu_data, int joint_id, Animation& anim, const Core::JointAnim** ended) {
 				matrix ret = DirectX::XMMatrixIdentity();
 				Core::JointAnim* animation = &((*cpu_data)[joint_id].animations[anim.id]);
 				if (animation != nullptr && animation->key_frames.size() > 0) {
@@ -242,20 +239,22 @@ namespace HotBite {
 					matrix bp = XMLoadFloat4x4(&data->skeletons[0]->CpuData()[joint_id].model_to_bindpose);
 
 					ret = bp * (m0 * w0 + m1 * w1);
-					if (!animation->key_frames.empty() && (k1 + 1) >= animation->key_frames.size() && coordinator != nullptr) {
-						end_animation_event.SetParam(EVENT_PARAM_ANIMATION_ID, anim.id);
-						end_animation_event.SetParam(EVENT_PARAM_ANIMATION_NAME, anim.name);
-						coordinator->SendEvent(end_animation_event);						
+					if (!animation->key_frames.empty() && (k1 + 1) >= animation->key_frames.size()) {
+						//Reported once per update by the caller, not per joint
+						*ended = animation;
 					}
 					if (anim.key_frame != k0) {
 						anim.key_frame = k0;
 						Core::AutoLock l(animation->lock);
-						if (const auto it = animation->frame_events.find(k0); it != animation->frame_events.cend()) {
-							ECS::Event frame_event(this, entity, EVENT_ID_ANIMATION_FRAME_EVENT);			
-							frame_event.SetParam(EVENT_PARAM_ANIMATION_NAME, anim.name);
-							frame_event.SetParam(EVENT_PARAM_ANIMATION_FRAME, it->first);
-							frame_event.SetParam(EVENT_PARAM_ANIMATION_FRAME_ID, it->second.ids);
-							coordinator->SendEvent(frame_event);
+						if (const auto it = animation->frame_events.find(k0); it != animation->frame_events.cend() && coordinator != nullptr) {
+							AnimationFrameEvent ev{ entity, it->first, animation->name };
+							for (const int id : it->second.ids) {
+								if (ev.id_count == MAX_EVENT_FRAME_IDS) {
+									break;
+								}
+								ev.ids[ev.id_count++] = id;
+							}
+							coordinator->PostEvent(ev);
 						}
 					}
 				}
@@ -278,16 +277,26 @@ namespace HotBite {
 					}
 					if (current_animation.id >= 0) {
 						matrix m;
+						const Core::JointAnim* prev_ended = nullptr;
+						const Core::JointAnim* current_ended = nullptr;
 						for (int i = 0; i < current_cpu_data->size(); ++i) {							
 							if (w0 > 0.0f) {								
-								m = GetAnimationMatrix(elapsed_nsec, total_nsec, prev_cpu_data, i, previous_animation) * w0 +
-									GetAnimationMatrix(elapsed_nsec, total_nsec, current_cpu_data, i, current_animation) * w1;		
+								m = GetAnimationMatrix(elapsed_nsec, total_nsec, prev_cpu_data, i, previous_animation, &prev_ended) * w0 +
+									GetAnimationMatrix(elapsed_nsec, total_nsec, current_cpu_data, i, current_animation, &current_ended) * w1;		
 							}
 							else {
-								m = GetAnimationMatrix(elapsed_nsec, total_nsec, current_cpu_data, i, current_animation);
+								m = GetAnimationMatrix(elapsed_nsec, total_nsec, current_cpu_data, i, current_animation, &current_ended);
 							}
 							DirectX::XMStoreFloat4x4(&joint_gpu_data[i].skinning_matrix, XMMatrixTranspose(m));
-						}						
+						}
+						if (coordinator != nullptr) {
+							if (prev_ended != nullptr) {
+								coordinator->PostEvent(AnimationEndEvent{ entity, previous_animation.id, prev_ended->name });
+							}
+							if (current_ended != nullptr) {
+								coordinator->PostEvent(AnimationEndEvent{ entity, current_animation.id, current_ended->name });
+							}
+						}
 					}
 					if (animation_change_current_time < animation_change_time) {
 						animation_change_current_time += elapsed_nsec / 1000000;
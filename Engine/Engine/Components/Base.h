@@ -31,6 +31,7 @@ SOFTWARE.
 #include <Core/Utils.h>
 #include <Core/SpinLock.h>
 #include <Core/Scheduler.h>
+#include <span>
 #include <DirectXMath.h>
 #include <d3d11.h>
 
@@ -85,9 +86,6 @@ namespace HotBite {
 			struct Transform {
 				//Event triggered when transform is changed
 				static inline ECS::EventId EVENT_ID_TRANSFORM_CHANGED = ECS::GetEventId<Transform>(0x00);
-				//The cached last parent position to check if parent has changed
-				float3 last_parent_position = {};
-				float4 last_parent_rotation = {};
 				//The entity position
 				float3 position = { 0.0f, 0.0f, 0.0f };
 				//The entity scale
@@ -104,7 +102,9 @@ namespace HotBite {
 				float4x4 world_inv_matrix = {};
 				//The entity world matrix to be used in the application
 				matrix world_xmmatrix = {};
-				//True if the world matrix is dirty and needs to be recalculated
+				//True if the world matrix is dirty and needs to be recalculated.
+				//Systems recalculating the world matrix mark the component as changed in the coordinator,
+				//so children entities can detect when the parent has moved
 				bool dirty = true;
 
 				static void Rotate(struct Transform& t, const float3& axis, float value) {
@@ -185,17 +185,27 @@ namespace HotBite {
 			 */
 			class Mesh : public ECS::IEventSender {
 			public:
-				//Event triggered when animation ends
-				static inline ECS::EventId EVENT_ID_ANIMATION_END = ECS::GetEventId<Mesh>(0x01);
-				static inline ECS::EventId EVENT_ID_ANIMATION_FRAME_EVENT = ECS::GetEventId<Mesh>(0x02);
-				//Animation parameter id
-				static inline ECS::ParamId EVENT_PARAM_ANIMATION_ID = 0x00;
-				//Animation name parameter id
-				static inline ECS::ParamId EVENT_PARAM_ANIMATION_NAME = 0x01;
-				//Animation event frame
-				static inline ECS::ParamId EVENT_PARAM_ANIMATION_FRAME = 0x02;
-				//Animation event id
-				static inline ECS::ParamId EVENT_PARAM_ANIMATION_FRAME_ID = 0x04;
+				static constexpr size_t MAX_EVENT_ANIMATION_NAME = 64;
+				static constexpr size_t MAX_EVENT_FRAME_IDS = 8;
+
+				//Event triggered when animation ends, the name is copied as events are delivered deferred
+				struct AnimationEndEvent {
+					ECS::Entity entity = ECS::INVALID_ENTITY_ID;
+					int animation_id = -1;
+					ECS::EventString<MAX_EVENT_ANIMATION_NAME> animation_name;
+				};
+
+				//Event triggered when animation reaches a frame with events, name and ids are copied
+				//as the skeleton data can change before the event is delivered
+				struct AnimationFrameEvent {
+					ECS::Entity entity = ECS::INVALID_ENTITY_ID;
+					int frame = -1;
+					ECS::EventString<MAX_EVENT_ANIMATION_NAME> animation_name;
+					uint32_t id_count = 0;
+					int ids[MAX_EVENT_FRAME_IDS] = {};
+
+					std::span<const int> Ids() const { return { ids, id_count }; }
+				};
 
 				std::vector<matrix> joint_cpu_data;
 				std::vector<Core::JointGpuData> joint_gpu_data;
@@ -224,7 +234,6 @@ namespace HotBite {
 				uint32_t time_offset = rand();
 				
 				ECS::Entity entity = ECS::INVALID_ENTITY_ID;
-				ECS::Event end_animation_event;
 				ECS::Coordinator* coordinator = nullptr;
 				std::shared_ptr<std::recursive_mutex> skeleton_mutex;
 
@@ -233,7 +242,7 @@ namespace HotBite {
 				Core::MeshData* data = nullptr;
 				matrix GetAnimationMatrix(int64_t elapsed_nsec, int64_t total_nsec,
 					std::vector<Core::JointCpuData>* cpu_data,
-					int joint_id, Animation& anim);
+					int joint_id, Animation& anim, const Core::JointAnim** ended);
 
 			public:
 				Mesh();
@@ -150,6 +150,7 @@ namespace HotBite {
 				void AddSkipEntity(ECS::Entity e) { skip.insert(e); }
 				void RemoteSkipEntity(ECS::Entity e) { if (skip.contains(e)) skip.erase(e); }
 				bool IsSkipEntity(ECS::Entity e) const { return skip.contains(e); }
+				const std::unordered_set<ECS::Entity>& GetSkipEntities() const { return skip; }
 				
 				HRESULT Init(const float3& c, const float3& dir,
 					bool cast_shadow, int shadow_resolution_divisor,
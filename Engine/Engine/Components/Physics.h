@@ -46,6 +46,8 @@ namespace HotBite {
 				reactphysics3d::RigidBody* body = nullptr;
 				reactphysics3d::Collider* collider = nullptr;
 				reactphysics3d::Transform last_body_transform;
+				//Body transform before the last fixed physics step, used to interpolate
+				reactphysics3d::Transform prev_body_transform;
 				reactphysics3d::PhysicsWorld* world = nullptr;
 				float bounce = -1.0f;
 				float friction = -1.0f;
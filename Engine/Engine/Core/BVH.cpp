@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include "BVH.h"
+#include "Profiler.h"
 
 namespace HotBite {
 	namespace Engine {
@@ -94,6 +95,8 @@ namespace HotBite {
 			}
 
 			void TBVH::Load(const ObjectInfo* objects, int size) {
+				HOTBITE_PROFILE_ZONE("TBVH::Load");
+				int64_t t0 = Profiler::Now();
 				//store only first index of the triangle
 				for (int i = 0; i < size; ++i) {
 					uint32_t vidx = i;
@@ -109,13 +112,68 @@ namespace HotBite {
 				ridx.index_offset = 0;
 				ridx.index_count = (int32_t)size;
 
-				UpdateNodeBounds(root_idx, objects, indices);
-				Subdivide(root_idx, objects, indices);
+				object_count = (uint32_t)size;
+				if (size > 0) {
+					UpdateNodeBounds(root_idx, objects, indices);
+					Subdivide(root_idx, objects, indices);
+				}
+				else {
+					root = BVHNode{};
+				}
+				stats.cost = Cost();
+				stats.build_cost = stats.cost;
+				stats.builds++;
+				stats.last_build_nsec = Profiler::Now() - t0;
+			}
+
+			void TBVH::Refit(const ObjectInfo* objects) {
+				HOTBITE_PROFILE_ZONE("TBVH::Refit");
+				if (object_count == 0) {
+					return;
+				}
+				int64_t t0 = Profiler::Now();
+				//Children are always allocated after their parent, so going backwards
+				//every node is updated after its children
+				for (int32_t i = (int32_t)nodes_used - 1; i >= 0; --i) {
+					BVHNode& node = nodes[i];
+					if (node.left_child == 0 && node.right_child == 0) {
+						node.aabb_min = objects[node.index].aabb_min;
+						node.aabb_max = objects[node.index].aabb_max;
+					}
+					else {
+						const BVHNode& l = nodes[node.left_child];
+						const BVHNode& r = nodes[node.right_child];
+						node.aabb_min = { fminf(l.aabb_min.x, r.aabb_min.x), fminf(l.aabb_min.y, r.aabb_min.y), fminf(l.aabb_min.z, r.aabb_min.z) };
+						node.aabb_max = { fmaxf(l.aabb_max.x, r.aabb_max.x), fmaxf(l.aabb_max.y, r.aabb_max.y), fmaxf(l.aabb_max.z, r.aabb_max.z) };
+					}
+				}
+				stats.cost = Cost();
+				stats.refits++;
+				stats.last_refit_nsec = Profiler::Now() - t0;
+			}
+
+			float TBVH::Cost() const {
+				auto area = [](const BVHNode& n) {
+					float3 d = { n.aabb_max.x - n.aabb_min.x, n.aabb_max.y - n.aabb_min.y, n.aabb_max.z - n.aabb_min.z };
+					return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+				};
+				if (object_count == 0) {
+					return 0.0f;
+				}
+				float total = 0.0f;
+				for (uint32_t i = 0; i < nodes_used; ++i) {
+					total += area(nodes[i]);
+				}
+				float root_area = area(nodes[root_idx]);
+				return (root_area > FLT_EPSILON) ? total / root_area : (float)nodes_used;
 			}
 
 			void TBVH::UpdateNodeBounds(uint32_t node_idx, const ObjectInfo* objects, const uint32_t* indices) {
 				BVHNode& node = nodes[node_idx];
 				NodeIdx& nidx = nodes_idxs[node_idx];
+				//Nodes are reused between loads
+				node.aabb_min = { FLT_MAX, FLT_MAX, FLT_MAX };
+				node.aabb_max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
 				for (uint32_t i = nidx.index_offset; i < nidx.index_offset + nidx.index_count; ++i)
 				{
 					const auto& o = objects[indices[i]];
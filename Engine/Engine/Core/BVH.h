@@ -63,6 +63,15 @@ namespace HotBite {
 			};
 
 
+			/**
+			 * TBVH - Top level BVH of the ray traced objects.
+			 * 
+			 * Load() builds the tree from scratch. When the objects are the same (same index for the same
+			 * object) and only their bounds changed, Refit() recomputes the node bounds bottom-up keeping
+			 * the topology. The tree quality is measured with the SAH cost (sum of the nodes surface area
+			 * relative to the root), when it grows over REBUILD_COST_RATIO times the cost of the last
+			 * build the tree should be rebuilt.
+			 */
 			class TBVH {
 			private:
 				struct NodeIdx
@@ -71,14 +80,30 @@ namespace HotBite {
 					uint32_t index_count = 0;
 				};
 			public:
+				static constexpr float REBUILD_COST_RATIO = 1.3f;
+
+				struct Stats {
+					uint64_t builds = 0;
+					uint64_t refits = 0;
+					int64_t last_build_nsec = 0;
+					int64_t last_refit_nsec = 0;
+					//SAH cost of the current tree and of the tree after the last build
+					float cost = 0.0f;
+					float build_cost = 0.0f;
+				};
 
 				TBVH(uint32_t max_size);
 				~TBVH();
 
 				void Load(const ObjectInfo* objects, int size);
+				//Updates the bounds of the tree loaded with the same objects
+				void Refit(const ObjectInfo* objects);
+				bool NeedsRebuild() const { return stats.cost > stats.build_cost * REBUILD_COST_RATIO; }
 
 				const BVHNode* Root() const { return nodes; }
 				uint32_t Size() const { return nodes_used; }
+				uint32_t ObjectCount() const { return object_count; }
+				const Stats& GetStats() const { return stats; }
 
 			private:
 				BVHNode* nodes = nullptr;
@@ -86,7 +111,10 @@ namespace HotBite {
 				uint32_t* indices = nullptr;
 				uint32_t root_idx = 0;
 				uint32_t nodes_used = 0;
+				uint32_t object_count = 0;
+				Stats stats;
 
+				float Cost() const;
 				void UpdateNodeBounds(uint32_t node_idx, const ObjectInfo* objects, const uint32_t* indices);
 				void Subdivide(uint32_t node_idx, const ObjectInfo* objects, uint32_t* indices);
 			};
@@ -0,0 +1,227 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Culling.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//AVX code is compiled for the AVX functions only, the engine runs in CPUs without it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define HOTBITE_TARGET_AVX
+#else
+#define HOTBITE_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+using namespace HotBite::Engine;
+using namespace HotBite::Engine::Core;
+using namespace DirectX;
+
+namespace {
+	constexpr float EMPTY_EXTENT = -FLT_MAX;
+	constexpr size_t CHUNK_WORDS = CullingSet::CHUNK_BOXES / 64;
+
+	bool CpuHasAVX() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		//The OS must save the YMM registers too
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+
+	const bool has_avx = CpuHasAVX();
+
+	struct Boxes {
+		const float* cx;
+		const float* cy;
+		const float* cz;
+		const float* ex;
+		const float* ey;
+		const float* ez;
+	};
+
+	HOTBITE_TARGET_AVX void CullAVX(const Frustum& f, const Boxes& b, uint64_t* bits, size_t begin_word, size_t end_word) {
+		__m256 pa[6], pb[6], pc[6], pd[6], aa[6], ab[6], ac[6];
+		for (int p = 0; p < 6; ++p) {
+			pa[p] = _mm256_set1_ps(f.planes[p].x);
+			pb[p] = _mm256_set1_ps(f.planes[p].y);
+			pc[p] = _mm256_set1_ps(f.planes[p].z);
+			pd[p] = _mm256_set1_ps(f.planes[p].w);
+			aa[p] = _mm256_set1_ps(std::fabs(f.planes[p].x));
+			ab[p] = _mm256_set1_ps(std::fabs(f.planes[p].y));
+			ac[p] = _mm256_set1_ps(std::fabs(f.planes[p].z));
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		for (size_t w = begin_word; w < end_word; ++w) {
+			uint64_t word = 0;
+			for (size_t j = 0; j < 64; j += 8) {
+				size_t i = w * 64 + j;
+				__m256 cx = _mm256_loadu_ps(b.cx + i);
+				__m256 cy = _mm256_loadu_ps(b.cy + i);
+				__m256 cz = _mm256_loadu_ps(b.cz + i);
+				__m256 ex = _mm256_loadu_ps(b.ex + i);
+				__m256 ey = _mm256_loadu_ps(b.ey + i);
+				__m256 ez = _mm256_loadu_ps(b.ez + i);
+				__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+				for (int p = 0; p < 6; ++p) {
+					//Signed distance of the center plus the projected radius of the box
+					__m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa[p], cx), _mm256_mul_ps(pb[p], cy)), _mm256_mul_ps(pc[p], cz)), pd[p]);
+					__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(aa[p], ex), _mm256_mul_ps(ab[p], ey)), _mm256_mul_ps(ac[p], ez));
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(s, r), zero, _CMP_GE_OQ));
+				}
+				word |= (uint64_t)(uint32_t)_mm256_movemask_ps(inside) << j;
+			}
+			bits[w] = word;
+		}
+	}
+
+	void CullSSE(const Frustum& f, const Boxes& b, uint64_t* bits, size_t begin_word, size_t end_word) {
+		__m128 pa[6], pb[6], pc[6], pd[6], aa[6], ab[6], ac[6];
+		for (int p = 0; p < 6; ++p) {
+			pa[p] = _mm_set1_ps(f.planes[p].x);
+			pb[p] = _mm_set1_ps(f.planes[p].y);
+			pc[p] = _mm_set1_ps(f.planes[p].z);
+			pd[p] = _mm_set1_ps(f.planes[p].w);
+			aa[p] = _mm_set1_ps(std::fabs(f.planes[p].x));
+			ab[p] = _mm_set1_ps(std::fabs(f.planes[p].y));
+			ac[p] = _mm_set1_ps(std::fabs(f.planes[p].z));
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (size_t w = begin_word; w < end_word; ++w) {
+			uint64_t word = 0;
+			for (size_t j = 0; j < 64; j += 4) {
+				size_t i = w * 64 + j;
+				__m128 cx = _mm_loadu_ps(b.cx + i);
+				__m128 cy = _mm_loadu_ps(b.cy + i);
+				__m128 cz = _mm_loadu_ps(b.cz + i);
+				__m128 ex = _mm_loadu_ps(b.ex + i);
+				__m128 ey = _mm_loadu_ps(b.ey + i);
+				__m128 ez = _mm_loadu_ps(b.ez + i);
+				__m128 inside = _mm_cmpeq_ps(zero, zero);
+				for (int p = 0; p < 6; ++p) {
+					__m128 s = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(pa[p], cx), _mm_mul_ps(pb[p], cy)), _mm_mul_ps(pc[p], cz)), pd[p]);
+					__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aa[p], ex), _mm_mul_ps(ab[p], ey)), _mm_mul_ps(ac[p], ez));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(s, r), zero));
+				}
+				word |= (uint64_t)(uint32_t)_mm_movemask_ps(inside) << j;
+			}
+			bits[w] = word;
+		}
+	}
+}
+
+Frustum Frustum::FromViewProjection(const XMMATRIX& view_projection) {
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, view_projection);
+	auto column = [&m](int c) {
+		return XMVectorSet(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+	};
+	XMVECTOR c0 = column(0);
+	XMVECTOR c1 = column(1);
+	XMVECTOR c2 = column(2);
+	XMVECTOR c3 = column(3);
+	Frustum f;
+	XMStoreFloat4(&f.planes[0], XMVectorAdd(c3, c0)); //Left
+	XMStoreFloat4(&f.planes[1], XMVectorSubtract(c3, c0)); //Right
+	XMStoreFloat4(&f.planes[2], XMVectorAdd(c3, c1)); //Bottom
+	XMStoreFloat4(&f.planes[3], XMVectorSubtract(c3, c1)); //Top
+	XMStoreFloat4(&f.planes[4], c2); //Near
+	XMStoreFloat4(&f.planes[5], XMVectorSubtract(c3, c2)); //Far
+	return f;
+}
+
+void CullingSet::Reset(size_t count) {
+	this->count = count;
+	size_t padded = (count + 63) & ~(size_t)63;
+	center_x.assign(padded, 0.0f);
+	center_y.assign(padded, 0.0f);
+	center_z.assign(padded, 0.0f);
+	extent_x.assign(padded, EMPTY_EXTENT);
+	extent_y.assign(padded, EMPTY_EXTENT);
+	extent_z.assign(padded, EMPTY_EXTENT);
+}
+
+void CullingSet::Set(size_t index, const BoundingBox& b) {
+	center_x[index] = b.Center.x;
+	center_y[index] = b.Center.y;
+	center_z[index] = b.Center.z;
+	extent_x[index] = b.Extents.x;
+	extent_y[index] = b.Extents.y;
+	extent_z[index] = b.Extents.z;
+}
+
+void CullingSet::SetEmpty(size_t index) {
+	center_x[index] = center_y[index] = center_z[index] = 0.0f;
+	extent_x[index] = extent_y[index] = extent_z[index] = EMPTY_EXTENT;
+}
+
+bool CullingSet::HasAVX() {
+	return has_avx;
+}
+
+void CullingSet::Cull(const Frustum& frustum, Bitset& visibility, Simd simd) const {
+	size_t words = (count + 63) / 64;
+	visibility.resize(words);
+	Boxes b{ center_x.data(), center_y.data(), center_z.data(), extent_x.data(), extent_y.data(), extent_z.data() };
+	uint64_t* bits = visibility.data();
+	size_t chunks = (words + CHUNK_WORDS - 1) / CHUNK_WORDS;
+	bool avx = has_avx && simd != Simd::SSE;
+	JobSystem::ParallelFor(0, chunks, [&frustum, &b, bits, words, avx](size_t chunk) {
+		size_t begin = chunk * CHUNK_WORDS;
+		size_t end = std::min(begin + CHUNK_WORDS, words);
+		if (avx) {
+			CullAVX(frustum, b, bits, begin, end);
+		}
+		else {
+			CullSSE(frustum, b, bits, begin, end);
+		}
+		}, 1);
+}
+
+void CullingSet::CullScalar(const Frustum& frustum, Bitset& visibility) const {
+	size_t words = (count + 63) / 64;
+	visibility.assign(words, 0);
+	for (size_t i = 0; i < words * 64; ++i) {
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p) {
+			const XMFLOAT4& plane = frustum.planes[p];
+			float s = plane.x * center_x[i] + plane.y * center_y[i] + plane.z * center_z[i] + plane.w;
+			float r = std::fabs(plane.x) * extent_x[i] + std::fabs(plane.y) * extent_y[i] + std::fabs(plane.z) * extent_z[i];
+			inside = (s + r >= 0.0f);
+		}
+		if (inside) {
+			visibility[i / 64] |= (uint64_t)1 << (i % 64);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+//Only DirectXMath, without Defines.h, so the culling can be built without the Windows headers
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			//Frustum planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them
+			struct Frustum {
+				DirectX::XMFLOAT4 planes[6];
+
+				//Planes of a row vector (v * vp) view projection matrix with D3D clip depth
+				static Frustum FromViewProjection(const DirectX::XMMATRIX& view_projection);
+			};
+
+			/**
+			 * CullingSet - World AABBs stored as structure of arrays for frustum culling.
+			 * 
+			 * Boxes are tested 8 at a time with AVX (4 with SSE if the CPU has no AVX) against the six
+			 * frustum planes, the result is a bitset with one bit per box. The set is split in chunks of
+			 * CHUNK_BOXES boxes that run in parallel in the job system.
+			 * Storage is padded to 64 boxes, so every bitset word is computed without tails. Empty slots
+			 * have negative extents and are never visible.
+			 */
+			class CullingSet {
+			public:
+				static constexpr size_t CHUNK_BOXES = 1024;
+				using Bitset = std::vector<uint64_t>;
+
+				//Instruction set used by Cull, BEST is AVX when the CPU has it. AVX falls back to SSE
+				//in CPUs without it
+				enum class Simd {
+					BEST,
+					SSE,
+					AVX
+				};
+
+			private:
+				std::vector<float> center_x;
+				std::vector<float> center_y;
+				std::vector<float> center_z;
+				std::vector<float> extent_x;
+				std::vector<float> extent_y;
+				std::vector<float> extent_z;
+				size_t count = 0;
+
+			public:
+				//Sets the number of slots, all of them empty
+				void Reset(size_t count);
+				size_t Size() const { return count; }
+				void Set(size_t index, const DirectX::BoundingBox& b);
+				void SetEmpty(size_t index);
+
+				//Bit i of visibility is set if the box i intersects the frustum
+				void Cull(const Frustum& frustum, Bitset& visibility, Simd simd = Simd::BEST) const;
+				//Reference implementation, one box and plane at a time
+				void CullScalar(const Frustum& frustum, Bitset& visibility) const;
+
+				static bool HasAVX();
+
+				static bool Test(const Bitset& visibility, size_t index) {
+					size_t word = index / 64;
+					return word < visibility.size() && ((visibility[word] >> (index % 64)) & 1) != 0;
+				}
+			};
+		}
+	}
+}
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "DXCore.h"
 #include "Scheduler.h"
+#include "JobSystem.h"
+#include "Profiler.h"
 #include "Texture.h"
 #include "PostProcess.h"
 #include "Vertex.h"
@@ -183,6 +185,7 @@ DXCore::DXCore(
 	}
 	DXCoreInstance = this;
 	Scheduler::Init(NTHREADS);
+	JobSystem::Init();
 	this->windowed = window;
 	this->hInstance = hInstance;
 	this->titleBarText = titleBarText;
@@ -617,9 +620,12 @@ HRESULT DXCore::Run()
 		return true;
 		});
 
+	static const char* thread_names[NTHREADS] = { "Main", "Background", "Background2", "Background3", "Physics", "LockStep", "Audio" };
+	Profiler::SetThreadName(thread_names[MAIN_THREAD]);
 	//SetThreadAffinityMask(GetCurrentThread(), 1);
 	for (int i = 1; i < NTHREADS; ++i) {
 		threads.emplace(std::thread([&e = this->end, i](){
+			Profiler::SetThreadName(thread_names[i]);
 			if (i == AUDIO_THREAD) {
 				if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
 					printf("DXCore::Run: Failed to set thread priority to real-time. Error code: %d\n", GetLastError());
@@ -659,6 +665,7 @@ void DXCore::Stop() {
 		threads.front().join();
 		threads.pop();
 	}
+	JobSystem::Release();
 }
 
 void DXCore::Quit()
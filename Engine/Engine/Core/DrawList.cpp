@@ -0,0 +1,101 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "DrawList.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace HotBite::Engine::Core;
+
+uint64_t DrawList::MakeKey(uint32_t pass, uint32_t shader, uint32_t material, float depth, bool back_to_front) {
+	//The last pass value is reserved, INVALID_KEY must sort after every valid command
+	assert(pass < MAX_PASSES - 1 && shader < MAX_SHADERS && material < MAX_MATERIALS && "Draw key out of range");
+	//Positive floats keep their order when compared as integers
+	uint32_t depth_bits = 0;
+	if (depth > 0.0f) {
+		memcpy(&depth_bits, &depth, sizeof(depth_bits));
+	}
+	uint64_t key = (uint64_t)pass << (1 + SHADER_BITS + MATERIAL_BITS + DEPTH_BITS);
+	if (back_to_front) {
+		return key | BACK_TO_FRONT |
+			((uint64_t)~depth_bits << (SHADER_BITS + MATERIAL_BITS)) |
+			((uint64_t)shader << MATERIAL_BITS) |
+			(uint64_t)material;
+	}
+	return key |
+		((uint64_t)shader << (MATERIAL_BITS + DEPTH_BITS)) |
+		((uint64_t)material << DEPTH_BITS) |
+		(uint64_t)depth_bits;
+}
+
+void DrawList::Reset(size_t count) {
+	commands.assign(count, Command{});
+}
+
+void DrawList::Sort() {
+	//LSD radix sort, 8 bits per digit. All the histograms are counted in one read of the keys
+	//and the digits where all the keys are equal (usually the high pass/shader bits) are skipped
+	constexpr uint32_t DIGITS = sizeof(uint64_t);
+	constexpr uint32_t BUCKETS = 256;
+	size_t count = commands.size();
+	std::vector<uint32_t> histogram(DIGITS * BUCKETS, 0);
+	for (const Command& c : commands) {
+		for (uint32_t d = 0; d < DIGITS; ++d) {
+			histogram[d * BUCKETS + ((c.key >> (d * 8)) & 0xFF)]++;
+		}
+	}
+	scratch.resize(count);
+	for (uint32_t d = 0; d < DIGITS; ++d) {
+		uint32_t* h = &histogram[d * BUCKETS];
+		if (count == 0 || h[(commands[0].key >> (d * 8)) & 0xFF] == count) {
+			continue;
+		}
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < BUCKETS; ++b) {
+			uint32_t n = h[b];
+			h[b] = offset;
+			offset += n;
+		}
+		for (const Command& c : commands) {
+			scratch[h[(c.key >> (d * 8)) & 0xFF]++] = c;
+		}
+		commands.swap(scratch);
+	}
+
+	//Drop the unused slots, they are at the end after sorting
+	auto by_key = [](const Command& c, uint64_t key) { return c.key < key; };
+	auto last = std::lower_bound(commands.begin(), commands.end(), INVALID_KEY, by_key);
+	commands.erase(last, commands.end());
+	for (uint32_t p = 0; p < MAX_PASSES; ++p) {
+		uint64_t first_key = (uint64_t)p << (1 + SHADER_BITS + MATERIAL_BITS + DEPTH_BITS);
+		passes[p] = (uint32_t)(std::lower_bound(commands.begin(), commands.end(), first_key, by_key) - commands.begin());
+	}
+	passes[MAX_PASSES] = (uint32_t)commands.size();
+}
+
+std::span<const DrawList::Command> DrawList::GetCommands(uint32_t pass) const {
+	assert(pass < MAX_PASSES && "Invalid draw pass");
+	return std::span<const Command>(commands.data() + passes[pass], passes[pass + 1] - passes[pass]);
+}
@@ -0,0 +1,96 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			/**
+			 * DrawList - Flat list of draw commands sorted by a 64 bit key.
+			 *
+			 * Opaque commands use the key [pass:3][0][shader:14][material:14][depth:32], so after sorting the
+			 * commands of a pass are contiguous and grouped by shader first and material second, the
+			 * submission loop only changes state when the key prefix changes. Inside a group the commands go
+			 * front to back. Blended commands set the BACK_TO_FRONT bit and use [pass:3][1][~depth:32]
+			 * [shader:14][material:14] instead: they go after all the opaque commands of the pass and
+			 * are sorted back to front across shaders and materials, as blending needs.
+			 * The list is rebuilt every frame: Reset() leaves a fixed number of slots that can be filled
+			 * in parallel (unused slots keep INVALID_KEY) and Sort() radix sorts the commands and drops
+			 * the unused slots.
+			 */
+			class DrawList {
+			public:
+				static constexpr uint32_t PASS_BITS = 3;
+				static constexpr uint32_t SHADER_BITS = 14;
+				static constexpr uint32_t MATERIAL_BITS = 14;
+				static constexpr uint32_t DEPTH_BITS = 32;
+				static constexpr uint32_t MAX_PASSES = 1 << PASS_BITS;
+				static constexpr uint32_t MAX_SHADERS = 1 << SHADER_BITS;
+				static constexpr uint32_t MAX_MATERIALS = 1 << MATERIAL_BITS;
+				static constexpr uint64_t BACK_TO_FRONT = 1ull << (SHADER_BITS + MATERIAL_BITS + DEPTH_BITS);
+				static constexpr uint64_t INVALID_KEY = UINT64_MAX;
+
+				struct Command {
+					uint64_t key = INVALID_KEY;
+					uint32_t index = 0;
+				};
+
+			private:
+				std::vector<Command> commands;
+				std::vector<Command> scratch;
+				//First command of every pass after sorting, passes[MAX_PASSES] is the end of the list
+				uint32_t passes[MAX_PASSES + 1] = {};
+
+			public:
+				//Key of a command, depth must be >= 0. Blended commands use back_to_front = true
+				static uint64_t MakeKey(uint32_t pass, uint32_t shader, uint32_t material, float depth, bool back_to_front = false);
+				static uint32_t GetPass(uint64_t key) { return (uint32_t)(key >> (1 + SHADER_BITS + MATERIAL_BITS + DEPTH_BITS)); }
+				static bool IsBackToFront(uint64_t key) { return (key & BACK_TO_FRONT) != 0; }
+				static uint32_t GetShader(uint64_t key) {
+					return (uint32_t)(key >> (IsBackToFront(key) ? MATERIAL_BITS : MATERIAL_BITS + DEPTH_BITS)) & (MAX_SHADERS - 1);
+				}
+				static uint32_t GetMaterial(uint64_t key) {
+					return (uint32_t)(key >> (IsBackToFront(key) ? 0 : DEPTH_BITS)) & (MAX_MATERIALS - 1);
+				}
+
+				//Clears the list leaving count unused slots
+				void Reset(size_t count);
+				Command& operator[](size_t index) { return commands[index]; }
+				size_t Size() const { return commands.size(); }
+
+				//Sorts the commands by key and removes the unused slots
+				void Sort();
+
+				//Sorted commands of a pass
+				std::span<const Command> GetCommands(uint32_t pass) const;
+			};
+		}
+	}
+}
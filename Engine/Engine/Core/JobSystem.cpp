@@ -0,0 +1,180 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace HotBite::Engine::Core;
+
+JobSystem* JobSystem::instance = nullptr;
+thread_local int32_t JobSystem::worker_index = -1;
+
+JobSystem::JobSystem(int nworkers) {
+	for (int i = 0; i < nworkers; ++i) {
+		workers.emplace_back(std::make_unique<Worker>());
+	}
+	for (int i = 0; i < nworkers; ++i) {
+		threads.emplace_back(std::thread([this, i]() { WorkerLoop(i); }));
+	}
+}
+
+JobSystem::~JobSystem() {
+	end = true;
+	{
+		std::lock_guard<std::mutex> l(sleep_mutex);
+		sleep_cv.notify_all();
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+}
+
+void JobSystem::Init(int nworkers) {
+	Release();
+	if (nworkers <= 0) {
+		nworkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	}
+	instance = new JobSystem(nworkers);
+}
+
+JobSystem* JobSystem::Get() {
+	return instance;
+}
+
+void JobSystem::Release() {
+	if (instance != nullptr) {
+		delete instance;
+		instance = nullptr;
+	}
+}
+
+int32_t JobSystem::GetWorkerCount() const {
+	return (int32_t)workers.size();
+}
+
+void JobSystem::Submit(Job&& job, Counter* counter) {
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (worker_index >= 0 && worker_index < (int32_t)workers.size()) {
+		Worker* w = workers[worker_index].get();
+		AutoLock l(w->lock);
+		w->jobs.emplace_back(std::move(job), counter);
+	}
+	else {
+		AutoLock l(injector_lock);
+		injector.emplace_back(std::move(job), counter);
+	}
+	queued.fetch_add(1, std::memory_order_release);
+	sleep_cv.notify_one();
+}
+
+bool JobSystem::Pop(std::pair<Job, Counter*>& job) {
+	if (queued.load(std::memory_order_acquire) <= 0) {
+		return false;
+	}
+	int32_t n = (int32_t)workers.size();
+	//Own jobs first, newest first as they are hot in cache
+	if (worker_index >= 0 && worker_index < n) {
+		Worker* w = workers[worker_index].get();
+		AutoLock l(w->lock);
+		if (!w->jobs.empty()) {
+			job = std::move(w->jobs.back());
+			w->jobs.pop_back();
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	{
+		AutoLock l(injector_lock);
+		if (!injector.empty()) {
+			job = std::move(injector.front());
+			injector.pop_front();
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	//Steal the oldest job of other workers
+	int32_t start = (worker_index >= 0) ? worker_index + 1 : 0;
+	for (int32_t i = 0; i < n; ++i) {
+		Worker* w = workers[(start + i) % n].get();
+		if (w->lock.try_lock()) {
+			if (!w->jobs.empty()) {
+				job = std::move(w->jobs.front());
+				w->jobs.pop_front();
+				w->lock.unlock();
+				queued.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+			w->lock.unlock();
+		}
+	}
+	return false;
+}
+
+void JobSystem::Run(std::pair<Job, Counter*>& job) {
+	job.first();
+	if (job.second != nullptr) {
+		job.second->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+bool JobSystem::ExecuteOne() {
+	std::pair<Job, Counter*> job;
+	if (Pop(job)) {
+		Run(job);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::Wait(Counter& counter) {
+	while (!counter.Done()) {
+		if (!ExecuteOne()) {
+			_mm_pause();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(int32_t index) {
+	worker_index = index;
+	Profiler::SetThreadName("Worker " + std::to_string(index));
+	int spins = 0;
+	while (!end) {
+		if (ExecuteOne()) {
+			spins = 0;
+		}
+		else if (++spins < 64) {
+			_mm_pause();
+		}
+		else {
+			//Nothing to do, sleep until a job is submitted
+			std::unique_lock<std::mutex> l(sleep_mutex);
+			sleep_cv.wait_for(l, std::chrono::milliseconds(1), [this]() { return end || queued.load(std::memory_order_acquire) > 0; });
+			spins = 0;
+		}
+	}
+}
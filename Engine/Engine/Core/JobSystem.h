@@ -0,0 +1,176 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Core/SpinLock.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			/**
+			 * JobSystem - Work stealing job system.
+			 * 
+			 * The Scheduler runs periodic tasks in fixed threads, the job system runs short jobs in a
+			 * pool of workers so a system can split its own work between all the cores.
+			 * Every worker has its own deque of jobs: it pushes and pops from the back and steals from the
+			 * front of the other workers deques when it runs out of jobs. Jobs submitted from threads that
+			 * are not workers (i.e. the scheduler threads) go to a global injector queue.
+			 * Threads waiting for a counter execute pending jobs instead of blocking.
+			 *
+			 * Example, updating all the entities of a system:
+			 *
+			 * JobSystem::ParallelForEach(entities, [](Entity& e) {
+			 *		e.Update();
+			 *	});
+			 *
+			 * If the job system has not been initialized the parallel loops run in the calling thread.
+			 */
+			class JobSystem {
+			public:
+				using Job = std::function<void()>;
+
+				//Pending jobs counter, a job decrements its counter when finished
+				class Counter {
+					friend class JobSystem;
+				private:
+					std::atomic<int32_t> pending{ 0 };
+				public:
+					bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+				};
+
+			private:
+				struct Worker {
+					spin_lock lock;
+					std::deque<std::pair<Job, Counter*>> jobs;
+				};
+
+				static JobSystem* instance;
+				static thread_local int32_t worker_index;
+
+				std::vector<std::unique_ptr<Worker>> workers;
+				std::vector<std::thread> threads;
+				spin_lock injector_lock;
+				std::deque<std::pair<Job, Counter*>> injector;
+				std::atomic<int32_t> queued{ 0 };
+				std::atomic<bool> end{ false };
+				std::mutex sleep_mutex;
+				std::condition_variable sleep_cv;
+
+				JobSystem(int nworkers);
+				virtual ~JobSystem();
+
+				bool Pop(std::pair<Job, Counter*>& job);
+				void Run(std::pair<Job, Counter*>& job);
+				void WorkerLoop(int32_t index);
+
+			public:
+				//Job system management, nworkers = 0 uses one worker per core minus one
+				static void Init(int nworkers = 0);
+				static JobSystem* Get();
+				static void Release();
+
+				int32_t GetWorkerCount() const;
+
+				//Queues a job, the counter (optional) is incremented until the job is done
+				void Submit(Job&& job, Counter* counter = nullptr);
+
+				//Queues a job returning a future with its result
+				template<typename F>
+				std::future<std::invoke_result_t<F>> Async(F&& f) {
+					using R = std::invoke_result_t<F>;
+					auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+					std::future<R> ret = task->get_future();
+					Submit([task]() { (*task)(); });
+					return ret;
+				}
+
+				//Executes one pending job in the calling thread, returns false if there were no jobs
+				bool ExecuteOne();
+
+				//Waits until all the jobs of the counter are done, executing pending jobs meanwhile
+				void Wait(Counter& counter);
+
+				//Calls f(i) for every i in [begin, end) splitting the range in jobs of grain size (0 = automatic)
+				template<typename F>
+				static void ParallelFor(size_t begin, size_t end, F&& f, size_t grain = 0) {
+					if (end <= begin) {
+						return;
+					}
+					size_t count = end - begin;
+					JobSystem* js = instance;
+					if (grain == 0) {
+						size_t chunks = (js != nullptr) ? (size_t)(js->GetWorkerCount() + 1) * 4 : 1;
+						grain = std::max<size_t>(1, count / chunks);
+					}
+					if (js == nullptr || count <= grain) {
+						for (size_t i = begin; i < end; ++i) {
+							f(i);
+						}
+						return;
+					}
+					Counter counter;
+					for (size_t b = begin + grain; b < end; b += grain) {
+						size_t e = std::min(b + grain, end);
+						js->Submit([&f, b, e]() {
+							for (size_t i = b; i < e; ++i) {
+								f(i);
+							}
+							}, &counter);
+					}
+					//The calling thread does the first chunk
+					for (size_t i = begin; i < begin + grain; ++i) {
+						f(i);
+					}
+					js->Wait(counter);
+				}
+
+				//Calls f(item) for every item of a container with indexed access (EntityVector, PagedVector, std::vector...)
+				template<typename C, typename F>
+				static void ParallelForEach(C& c, F&& f, size_t grain = 0) {
+					size_t count;
+					if constexpr (requires { c.Size(); }) {
+						count = c.Size();
+					}
+					else {
+						count = c.size();
+					}
+					ParallelFor(0, count, [&c, &f](size_t i) { f(c[i]); }, grain);
+				}
+			};
+		}
+	}
+}
@@ -0,0 +1,213 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			static constexpr uint32_t INVALID_NAME_ID = UINT32_MAX;
+
+			/**
+			 * Wildcard pattern "prefix*suffix", only the first '*' is a wildcard.
+			 */
+			struct WildcardPattern {
+				std::string_view prefix;
+				std::string_view suffix;
+				bool wildcard = false;
+
+				WildcardPattern(std::string_view pattern) {
+					size_t pos = pattern.find('*');
+					if (pos != std::string_view::npos) {
+						wildcard = true;
+						prefix = pattern.substr(0, pos);
+						suffix = pattern.substr(pos + 1);
+					}
+					else {
+						prefix = pattern;
+					}
+				}
+
+				bool Match(std::string_view str) const {
+					if (!wildcard) {
+						return str == prefix;
+					}
+					return str.size() >= prefix.size() + suffix.size() &&
+						str.starts_with(prefix) && str.ends_with(suffix);
+				}
+			};
+
+			/**
+			 * Calls f(key, value) for every entry of an ordered string map matching the pattern.
+			 * Patterns with prefix only visit the range of keys starting with the prefix.
+			 */
+			template<class Map, class F>
+			void ForEachMatch(const Map& m, const WildcardPattern& pattern, F&& f) {
+				if (!pattern.wildcard) {
+					if (auto it = m.find(pattern.prefix); it != m.end()) {
+						f(it->first, it->second);
+					}
+					return;
+				}
+				for (auto it = m.lower_bound(pattern.prefix); it != m.end(); ++it) {
+					std::string_view key = it->first;
+					if (!key.starts_with(pattern.prefix)) {
+						break;
+					}
+					if (pattern.Match(key)) {
+						f(it->first, it->second);
+					}
+				}
+			}
+
+			/**
+			 * String interning table, each name is stored once and identified by a 32 bits id.
+			 * Ids of released names are reused.
+			 */
+			class NameTable {
+			private:
+				//deque keeps string addresses stable so the index can use views
+				std::deque<std::string> names;
+				std::unordered_map<std::string_view, uint32_t> ids;
+				std::vector<uint32_t> free_ids;
+
+			public:
+				uint32_t Intern(std::string_view name) {
+					if (auto it = ids.find(name); it != ids.end()) {
+						return it->second;
+					}
+					uint32_t id;
+					if (!free_ids.empty()) {
+						id = free_ids.back();
+						free_ids.pop_back();
+						names[id] = name;
+					}
+					else {
+						id = (uint32_t)names.size();
+						names.emplace_back(name);
+					}
+					ids[names[id]] = id;
+					return id;
+				}
+
+				uint32_t Find(std::string_view name) const {
+					auto it = ids.find(name);
+					return (it != ids.end()) ? it->second : INVALID_NAME_ID;
+				}
+
+				const std::string& Get(uint32_t id) const {
+					return names[id];
+				}
+
+				void Release(uint32_t id) {
+					ids.erase(names[id]);
+					names[id].clear();
+					names[id].shrink_to_fit();
+					free_ids.push_back(id);
+				}
+
+				size_t Size() const {
+					return ids.size();
+				}
+			};
+
+			/**
+			 * Index of unique names supporting wildcard lookups.
+			 * Names are kept sorted so "prefix*" and "prefix*suffix" patterns only visit the names with
+			 * that prefix. A second index with the reversed names is built the first time a "*suffix"
+			 * pattern is used. Names are views, their storage (i.e. a NameTable) must outlive the index.
+			 */
+			template<class V>
+			class WildcardIndex {
+			private:
+				std::map<std::string_view, V, std::less<>> by_name;
+				mutable std::map<std::string, V, std::less<>> by_reversed_name;
+				mutable bool suffix_index = false;
+
+				static std::string Reverse(std::string_view name) {
+					return std::string(name.rbegin(), name.rend());
+				}
+
+			public:
+				using Map = std::map<std::string_view, V, std::less<>>;
+
+				void Insert(std::string_view name, const V& v) {
+					by_name[name] = v;
+					if (suffix_index) {
+						by_reversed_name[Reverse(name)] = v;
+					}
+				}
+
+				void Remove(std::string_view name) {
+					by_name.erase(name);
+					if (suffix_index) {
+						by_reversed_name.erase(Reverse(name));
+					}
+				}
+
+				const V* Find(std::string_view name) const {
+					auto it = by_name.find(name);
+					return (it != by_name.end()) ? &it->second : nullptr;
+				}
+
+				template<class F>
+				void Match(std::string_view pattern, F&& f) const {
+					WildcardPattern p(pattern);
+					if (!p.wildcard || !p.prefix.empty() || p.suffix.empty()) {
+						ForEachMatch(by_name, p, [&](std::string_view, const V& v) { f(v); });
+						return;
+					}
+					if (!suffix_index) {
+						for (const auto& e : by_name) {
+							by_reversed_name[Reverse(e.first)] = e.second;
+						}
+						suffix_index = true;
+					}
+					std::string reversed_suffix = Reverse(p.suffix);
+					for (auto it = by_reversed_name.lower_bound(reversed_suffix); it != by_reversed_name.end() && it->first.starts_with(reversed_suffix); ++it) {
+						f(it->second);
+					}
+				}
+
+				const Map& GetData() const {
+					return by_name;
+				}
+
+				size_t Size() const {
+					return by_name.size();
+				}
+			};
+		}
+	}
+}
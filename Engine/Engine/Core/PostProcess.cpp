@@ -89,6 +89,7 @@ void PostProcess::Prepare() {
 	if (TargetRenderView() == DXCore::Get()->RenderTarget()) {
 		context->RSSetViewports(1, &DXCore::Get()->screenport);
 	}
+	AutoLock l(params_lock);
 	for (const auto& srv : srvs) {
 		ps->SetShaderResourceView(srv.first, srv.second);
 	}
@@ -101,6 +102,7 @@ void PostProcess::UnPrepare() {
 	ID3D11RenderTargetView* rv[1] = { nullptr };
 	context->OMSetRenderTargets(1, rv, nullptr);
 	ps->SetShaderResourceView("renderTexture", nullptr);
+	AutoLock l(params_lock);
 	for (auto srv : srvs) {
 		ps->SetShaderResourceView(srv.first, nullptr);
 	}
@@ -171,13 +173,17 @@ void PostProcess::SetTarget(IRenderTarget* t, IDepthResource* d) {
 }
 
 void PostProcess::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv) {
-	srvs[name] = srv;
+	{
+		AutoLock l(params_lock);
+		srvs[name] = srv;
+	}
 	if (next != nullptr) {
 		next->SetShaderResourceView(name, srv);
 	}
 }
 
 void PostProcess::SetVariable(const std::string& name, const void* value, size_t size) {
+	AutoLock l(params_lock);
 	std::vector<uint8_t>& data = vars[name];
 	data.clear();
 	data.resize(size);
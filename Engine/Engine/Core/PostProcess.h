@@ -27,6 +27,7 @@ SOFTWARE.
 #include "Defines.h"
 #include "SimpleShader.h"
 #include "Texture.h"
+#include "SpinLock.h"
 #include <d3d11.h>
 #include <PrimitiveBatch.h>
 #include <VertexTypes.h>
@@ -84,6 +85,8 @@ namespace HotBite {
 				int w = 0;
 				int h = 0;
 				PostProcess* next = nullptr;
+				//Resources and variables can be set from game threads while the chain is rendered
+				spin_lock params_lock;
 				std::map<std::string, ID3D11ShaderResourceView*> srvs;
 				std::map<std::string, std::vector<uint8_t>> vars;
 
@@ -0,0 +1,174 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Profiler.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <unordered_map>
+
+using namespace HotBite::Engine::Core;
+
+std::atomic<bool> Profiler::enabled = false;
+std::mutex Profiler::mutex;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::buffers;
+thread_local Profiler::ThreadBuffer* Profiler::thread_buffer = nullptr;
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer() {
+	if (thread_buffer == nullptr) {
+		std::lock_guard<std::mutex> l(mutex);
+		auto b = std::make_unique<ThreadBuffer>();
+		b->tid = (uint32_t)buffers.size();
+		b->name = "Thread " + std::to_string(b->tid);
+		b->zones = std::make_unique<Zone[]>(BUFFER_SIZE);
+		thread_buffer = b.get();
+		buffers.emplace_back(std::move(b));
+	}
+	return thread_buffer;
+}
+
+template<typename F>
+void Profiler::ForEachZone(int64_t since, F&& f) {
+	//Skip the oldest zones of the ring as the owner thread can be overwriting them
+	static constexpr uint64_t SAFETY_ZONES = 1024;
+	for (auto& b : buffers) {
+		uint64_t count = b->count.load(std::memory_order_acquire);
+		uint64_t first = (count > BUFFER_SIZE - SAFETY_ZONES) ? count - (BUFFER_SIZE - SAFETY_ZONES) : 0;
+		first = std::max(first, b->first);
+		for (uint64_t i = first; i < count; ++i) {
+			const Zone& z = b->zones[i % BUFFER_SIZE];
+			if (z.end >= since) {
+				f(*b, z);
+			}
+		}
+	}
+}
+
+void Profiler::Enable(bool enable) {
+	enabled = enable;
+}
+
+int64_t Profiler::Now() {
+	return Scheduler::GetNanoSeconds();
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+	ThreadBuffer* b = GetThreadBuffer();
+	std::lock_guard<std::mutex> l(mutex);
+	b->name = name;
+}
+
+const char* Profiler::Intern(const std::string& name) {
+	static std::set<std::string> names;
+	std::lock_guard<std::mutex> l(mutex);
+	return names.insert(name).first->c_str();
+}
+
+void Profiler::Record(const char* name, int64_t start, int64_t end) {
+	ThreadBuffer* b = GetThreadBuffer();
+	uint64_t n = b->count.load(std::memory_order_relaxed);
+	b->zones[n % BUFFER_SIZE] = { name, start, end };
+	b->count.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::Clear() {
+	std::lock_guard<std::mutex> l(mutex);
+	for (auto& b : buffers) {
+		//The zones are not touched, the owner thread can be writing them
+		b->first = b->count.load(std::memory_order_acquire);
+	}
+}
+
+std::vector<Profiler::ZoneStats> Profiler::GetStats(int64_t window_nsec) {
+	std::unordered_map<const char*, std::vector<int64_t>> durations;
+	{
+		std::lock_guard<std::mutex> l(mutex);
+		ForEachZone(Now() - window_nsec, [&durations](const ThreadBuffer&, const Zone& z) {
+			durations[z.name].push_back(z.end - z.start);
+			});
+	}
+	std::vector<ZoneStats> ret;
+	ret.reserve(durations.size());
+	for (auto& [name, d] : durations) {
+		ZoneStats s;
+		s.name = name;
+		s.count = d.size();
+		for (int64_t t : d) {
+			s.total_nsec += t;
+		}
+		size_t p50 = d.size() / 2;
+		size_t p99 = std::min(d.size() - 1, (d.size() * 99) / 100);
+		std::nth_element(d.begin(), d.begin() + p50, d.end());
+		s.p50_nsec = d[p50];
+		std::nth_element(d.begin(), d.begin() + p99, d.end());
+		s.p99_nsec = d[p99];
+		s.max_nsec = *std::max_element(d.begin(), d.end());
+		ret.emplace_back(std::move(s));
+	}
+	std::sort(ret.begin(), ret.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.total_nsec > b.total_nsec; });
+	return ret;
+}
+
+static void WriteJsonString(std::ofstream& out, const char* str) {
+	out << '"';
+	for (const char* c = str; *c != 0; ++c) {
+		if (*c == '"' || *c == '\\') {
+			out << '\\';
+		}
+		out << *c;
+	}
+	out << '"';
+}
+
+bool Profiler::ExportChromeTrace(const std::string& file) {
+	std::ofstream out(file, std::ios::out | std::ios::trunc);
+	if (!out.is_open()) {
+		printf("Profiler::ExportChromeTrace: Can't open file %s.\n", file.c_str());
+		return false;
+	}
+	std::lock_guard<std::mutex> l(mutex);
+	int64_t t0 = INT64_MAX;
+	ForEachZone(0, [&t0](const ThreadBuffer&, const Zone& z) { t0 = std::min(t0, z.start); });
+	bool first = true;
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	for (auto& b : buffers) {
+		out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << b->tid << ",\"args\":{\"name\":";
+		WriteJsonString(out, b->name.c_str());
+		out << "}}";
+		first = false;
+	}
+	out.precision(3);
+	out << std::fixed;
+	ForEachZone(0, [&out, &first, t0](const ThreadBuffer& b, const Zone& z) {
+		out << (first ? "" : ",") << "\n{\"name\":";
+		WriteJsonString(out, z.name);
+		//Chrome trace times are in microseconds
+		out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << b.tid << ",\"ts\":" << (double)(z.start - t0) / 1000.0
+			<< ",\"dur\":" << (double)(z.end - z.start) / 1000.0 << "}";
+		first = false;
+		});
+	out << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,134 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			/**
+			 * Profiler - Scoped zones profiler.
+			 * 
+			 * Every thread records its zones (name, start and end nanoseconds) in its own ring buffer,
+			 * so recording a zone is two clock reads and a store, without locks. When the profiler is
+			 * disabled (default) a zone only checks a flag.
+			 * The recorded zones can be exported as Chrome trace JSON (chrome://tracing, Perfetto) and
+			 * summarized per zone name for the last period of time.
+			 * 
+			 * Zone names must outlive the profiler (literals), dynamic names must be interned.
+			 * 
+			 * {
+			 *		HOTBITE_PROFILE_ZONE("MySystem::Update");
+			 *		...
+			 * }
+			 */
+			class Profiler {
+			public:
+				static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+				struct Zone {
+					const char* name;
+					int64_t start;
+					int64_t end;
+				};
+
+				struct ZoneStats {
+					std::string name;
+					uint64_t count = 0;
+					int64_t total_nsec = 0;
+					int64_t p50_nsec = 0;
+					int64_t p99_nsec = 0;
+					int64_t max_nsec = 0;
+				};
+
+			private:
+				struct ThreadBuffer {
+					uint32_t tid = 0;
+					std::string name;
+					std::unique_ptr<Zone[]> zones;
+					std::atomic<uint64_t> count{ 0 };
+					//First zone reported, Clear moves it to count. Only accessed with the mutex locked,
+					//the owner thread never reads it
+					uint64_t first = 0;
+				};
+
+				static std::atomic<bool> enabled;
+				static std::mutex mutex;
+				static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+				static thread_local ThreadBuffer* thread_buffer;
+
+				static ThreadBuffer* GetThreadBuffer();
+				//Calls f with the zones of every thread that ended after the given time
+				template<typename F>
+				static void ForEachZone(int64_t since, F&& f);
+
+			public:
+				static void Enable(bool enable);
+				static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+				static int64_t Now();
+
+				static void SetThreadName(const std::string& name);
+				//Returns a copy of the name that lives as long as the process
+				static const char* Intern(const std::string& name);
+				static void Record(const char* name, int64_t start, int64_t end);
+				//Drops all the recorded zones, threads can keep recording while clearing
+				static void Clear();
+
+				//Statistics of the zones ended in the last window_nsec, sorted by total time
+				static std::vector<ZoneStats> GetStats(int64_t window_nsec);
+				static bool ExportChromeTrace(const std::string& file);
+			};
+
+			class ProfileZone {
+			private:
+				const char* name;
+				int64_t start = 0;
+			public:
+				ProfileZone(const char* zone_name) : name(Profiler::IsEnabled() ? zone_name : nullptr) {
+					if (name != nullptr) {
+						start = Profiler::Now();
+					}
+				}
+
+				~ProfileZone() {
+					if (name != nullptr) {
+						Profiler::Record(name, start, Profiler::Now());
+					}
+				}
+			};
+
+#define HOTBITE_PROFILE_CONCAT_(a, b) a##b
+#define HOTBITE_PROFILE_CONCAT(a, b) HOTBITE_PROFILE_CONCAT_(a, b)
+#define HOTBITE_PROFILE_ZONE(name) HotBite::Engine::Core::ProfileZone HOTBITE_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+		}
+	}
+}
@@ -0,0 +1,239 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <immintrin.h>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			//Number of threads that can push and pop at the same time
+			enum class QueueMode {
+				SPSC,
+				MPSC,
+				MPMC
+			};
+
+			/**
+			 * RingQueue - Lock-free bounded queue.
+			 * 
+			 * Ring of cells with a sequence number each (Vyukov's bounded queue), producers and consumers
+			 * only contend on their own position counter and only need a CAS when the mode allows more than
+			 * one thread in that side. Push never blocks nor allocates, it fails when the queue is full.
+			 * 
+			 * Same interface as LockingQueue, the blocking pops spin for a while and then park in a
+			 * condition variable. Producers only take its mutex to wake consumers that are parked.
+			 */
+			template<typename T, size_t CAPACITY = 1024, QueueMode MODE = QueueMode::MPMC>
+			class RingQueue {
+			public:
+				static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "RingQueue capacity must be a power of two");
+				static constexpr size_t MASK = CAPACITY - 1;
+
+			private:
+				static constexpr uint32_t SPIN_COUNT = 64;
+				using Clock = std::chrono::steady_clock;
+
+				struct Cell {
+					std::atomic<size_t> sequence;
+					T data;
+				};
+
+				std::unique_ptr<Cell[]> cells;
+				//Read position
+				alignas(64) std::atomic<size_t> head{ 0 };
+				//Write position
+				alignas(64) std::atomic<size_t> tail{ 0 };
+				//Consumers parked in wait_cv
+				alignas(64) std::atomic<uint32_t> waiters{ 0 };
+				std::mutex wait_mutex;
+				std::condition_variable wait_cv;
+
+				//Spins on ready() and then parks until a push makes it true, or until the deadline if any
+				template<typename F>
+				bool Wait(F&& ready, const Clock::time_point* deadline) {
+					for (uint32_t n = 0; n < SPIN_COUNT; ++n) {
+						if (ready()) {
+							return true;
+						}
+						_mm_pause();
+					}
+					//Paired with the fence in Enqueue, either we see the value or the producer sees us
+					waiters.fetch_add(1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					bool ret = true;
+					{
+						std::unique_lock<std::mutex> l(wait_mutex);
+						if (deadline != nullptr) {
+							ret = wait_cv.wait_until(l, *deadline, ready);
+						}
+						else {
+							wait_cv.wait(l, ready);
+						}
+					}
+					waiters.fetch_sub(1, std::memory_order_relaxed);
+					return ret;
+				}
+
+				template<typename V>
+				bool Enqueue(V&& value) {
+					Cell* cell;
+					size_t pos = tail.load(std::memory_order_relaxed);
+					for (;;) {
+						cell = &cells[pos & MASK];
+						size_t seq = cell->sequence.load(std::memory_order_acquire);
+						intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+						if (diff == 0) {
+							if constexpr (MODE == QueueMode::SPSC) {
+								tail.store(pos + 1, std::memory_order_relaxed);
+								break;
+							}
+							else if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+								break;
+							}
+						}
+						else if (diff < 0) {
+							//Full
+							return false;
+						}
+						else {
+							pos = tail.load(std::memory_order_relaxed);
+						}
+					}
+					cell->data = std::forward<V>(value);
+					cell->sequence.store(pos + 1, std::memory_order_release);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (waiters.load(std::memory_order_relaxed) > 0) {
+						//Taking the mutex makes sure a consumer checking the queue is already waiting
+						std::lock_guard<std::mutex> l(wait_mutex);
+						wait_cv.notify_all();
+					}
+					return true;
+				}
+
+			public:
+				RingQueue() : cells(std::make_unique<Cell[]>(CAPACITY)) {
+					for (size_t i = 0; i < CAPACITY; ++i) {
+						cells[i].sequence.store(i, std::memory_order_relaxed);
+					}
+				}
+
+				RingQueue(const RingQueue&) = delete;
+				RingQueue& operator=(const RingQueue&) = delete;
+
+				//Returns false if the queue is full
+				bool Push(T const& data) {
+					return Enqueue(data);
+				}
+
+				bool Emplace(T&& data) {
+					return Enqueue(std::move(data));
+				}
+
+				bool TryPop(T& value) {
+					Cell* cell;
+					size_t pos = head.load(std::memory_order_relaxed);
+					for (;;) {
+						cell = &cells[pos & MASK];
+						size_t seq = cell->sequence.load(std::memory_order_acquire);
+						intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+						if (diff == 0) {
+							if constexpr (MODE != QueueMode::MPMC) {
+								head.store(pos + 1, std::memory_order_relaxed);
+								break;
+							}
+							else if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+								break;
+							}
+						}
+						else if (diff < 0) {
+							//Empty
+							return false;
+						}
+						else {
+							pos = head.load(std::memory_order_relaxed);
+						}
+					}
+					value = std::move(cell->data);
+					//Don't keep resources of the popped value alive in the ring
+					cell->data = T{};
+					cell->sequence.store(pos + CAPACITY, std::memory_order_release);
+					return true;
+				}
+
+				//Pops up to max values, returns the number of values popped
+				size_t TryPopMany(T* values, size_t max) {
+					size_t count = 0;
+					while (count < max && TryPop(values[count])) {
+						++count;
+					}
+					return count;
+				}
+
+				//Approximated when other threads are pushing or popping
+				size_t Size() const {
+					size_t t = tail.load(std::memory_order_acquire);
+					size_t h = head.load(std::memory_order_acquire);
+					return (t > h) ? t - h : 0;
+				}
+
+				bool Empty() const {
+					return Size() == 0;
+				}
+
+				constexpr size_t Capacity() const {
+					return CAPACITY;
+				}
+
+				T Pop() {
+					T value;
+					WaitAndPop(value);
+					return value;
+				}
+
+				void WaitAndPop(T& value) {
+					Wait([this, &value]() { return TryPop(value); }, nullptr);
+				}
+
+				bool TimedWaitAndPop(T& value, int milli) {
+					Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(milli);
+					return Wait([this, &value]() { return TryPop(value); }, &deadline);
+				}
+
+				bool TimedWait(int milli) {
+					Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(milli);
+					return Wait([this]() { return !Empty(); }, &deadline);
+				}
+			};
+		}
+	}
+}
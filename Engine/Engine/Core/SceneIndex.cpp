@@ -0,0 +1,298 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SceneIndex.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace HotBite::Engine;
+using namespace HotBite::Engine::Core;
+
+SceneIndex::SceneIndex(float margin): margin(margin) {
+}
+
+SceneIndex::Aabb SceneIndex::ToAabb(const DirectX::BoundingBox& b, float margin) {
+	Aabb a;
+	a.min[0] = b.Center.x - b.Extents.x - margin;
+	a.min[1] = b.Center.y - b.Extents.y - margin;
+	a.min[2] = b.Center.z - b.Extents.z - margin;
+	a.max[0] = b.Center.x + b.Extents.x + margin;
+	a.max[1] = b.Center.y + b.Extents.y + margin;
+	a.max[2] = b.Center.z + b.Extents.z + margin;
+	return a;
+}
+
+SceneIndex::Aabb SceneIndex::Combine(const Aabb& a, const Aabb& b) {
+	Aabb c;
+	for (int i = 0; i < 3; ++i) {
+		c.min[i] = std::min(a.min[i], b.min[i]);
+		c.max[i] = std::max(a.max[i], b.max[i]);
+	}
+	return c;
+}
+
+float SceneIndex::Area(const Aabb& a) {
+	float dx = a.max[0] - a.min[0];
+	float dy = a.max[1] - a.min[1];
+	float dz = a.max[2] - a.min[2];
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+bool SceneIndex::Contains(const Aabb& outer, const Aabb& inner) {
+	for (int i = 0; i < 3; ++i) {
+		if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SceneIndex::Overlaps(const Aabb& a, const Aabb& b) {
+	for (int i = 0; i < 3; ++i) {
+		if (a.max[i] < b.min[i] || a.min[i] > b.max[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int32_t SceneIndex::AllocNode() {
+	int32_t index;
+	if (free_nodes != NIL) {
+		index = free_nodes;
+		free_nodes = nodes[index].parent;
+		nodes[index] = Node{};
+	}
+	else {
+		index = (int32_t)nodes.size();
+		nodes.emplace_back();
+	}
+	nodes[index].height = 0;
+	return index;
+}
+
+void SceneIndex::FreeNode(int32_t index) {
+	//Free nodes are linked through the parent index
+	nodes[index].parent = free_nodes;
+	nodes[index].height = -1;
+	free_nodes = index;
+}
+
+void SceneIndex::Clear() {
+	nodes.clear();
+	leaves.clear();
+	root = NIL;
+	free_nodes = NIL;
+	count = 0;
+}
+
+bool SceneIndex::Update(Key key, const DirectX::BoundingBox& b) {
+	assert(key >= 0);
+	if (key >= (Key)leaves.size()) {
+		leaves.resize((size_t)key + 1, NIL);
+	}
+	int32_t leaf = leaves[key];
+	if (leaf != NIL) {
+		if (Contains(nodes[leaf].aabb, ToAabb(b, 0.0f))) {
+			return false;
+		}
+		RemoveLeaf(leaf);
+	}
+	else {
+		leaf = AllocNode();
+		leaves[key] = leaf;
+		nodes[leaf].key = key;
+		++count;
+	}
+	nodes[leaf].aabb = ToAabb(b, margin);
+	InsertLeaf(leaf);
+	return true;
+}
+
+void SceneIndex::Remove(Key key) {
+	if (Contains(key)) {
+		int32_t leaf = leaves[key];
+		RemoveLeaf(leaf);
+		FreeNode(leaf);
+		leaves[key] = NIL;
+		--count;
+	}
+}
+
+void SceneIndex::Refit(int32_t index) {
+	//Walk up to the root fixing heights and boxes
+	while (index != NIL) {
+		index = Balance(index);
+		Node& node = nodes[index];
+		node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+		node.aabb = Combine(nodes[node.left].aabb, nodes[node.right].aabb);
+		index = node.parent;
+	}
+}
+
+void SceneIndex::InsertLeaf(int32_t leaf) {
+	if (root == NIL) {
+		root = leaf;
+		nodes[root].parent = NIL;
+		return;
+	}
+
+	//Find the best sibling, the cost is the area of the new parent plus the area growth of the ancestors
+	const Aabb leaf_aabb = nodes[leaf].aabb;
+	int32_t index = root;
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+		float area = Area(node.aabb);
+		float combined_area = Area(Combine(node.aabb, leaf_aabb));
+		float cost = 2.0f * combined_area;
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		auto child_cost = [this, &leaf_aabb, inheritance_cost](int32_t child) {
+			const Node& c = nodes[child];
+			float new_area = Area(Combine(leaf_aabb, c.aabb));
+			return (c.IsLeaf() ? new_area : new_area - Area(c.aabb)) + inheritance_cost;
+		};
+		float cost_left = child_cost(node.left);
+		float cost_right = child_cost(node.right);
+		if (cost < cost_left && cost < cost_right) {
+			break;
+		}
+		index = (cost_left < cost_right) ? node.left : node.right;
+	}
+
+	int32_t sibling = index;
+	int32_t old_parent = nodes[sibling].parent;
+	int32_t new_parent = AllocNode();
+	Node& np = nodes[new_parent];
+	np.parent = old_parent;
+	np.aabb = Combine(leaf_aabb, nodes[sibling].aabb);
+	np.height = nodes[sibling].height + 1;
+	np.left = sibling;
+	np.right = leaf;
+	if (old_parent != NIL) {
+		if (nodes[old_parent].left == sibling) {
+			nodes[old_parent].left = new_parent;
+		}
+		else {
+			nodes[old_parent].right = new_parent;
+		}
+	}
+	else {
+		root = new_parent;
+	}
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+	Refit(old_parent);
+}
+
+void SceneIndex::RemoveLeaf(int32_t leaf) {
+	if (leaf == root) {
+		root = NIL;
+		return;
+	}
+	int32_t parent = nodes[leaf].parent;
+	int32_t grand_parent = nodes[parent].parent;
+	int32_t sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+	if (grand_parent != NIL) {
+		if (nodes[grand_parent].left == parent) {
+			nodes[grand_parent].left = sibling;
+		}
+		else {
+			nodes[grand_parent].right = sibling;
+		}
+		nodes[sibling].parent = grand_parent;
+		FreeNode(parent);
+		Refit(grand_parent);
+	}
+	else {
+		root = sibling;
+		nodes[sibling].parent = NIL;
+		FreeNode(parent);
+	}
+	nodes[leaf].parent = NIL;
+}
+
+int32_t SceneIndex::Balance(int32_t a) {
+	Node& A = nodes[a];
+	if (A.IsLeaf() || A.height < 2) {
+		return a;
+	}
+	int32_t b = A.left;
+	int32_t c = A.right;
+	Node& B = nodes[b];
+	Node& C = nodes[c];
+	int32_t balance = C.height - B.height;
+
+	//Rotate the higher child up, its lower child goes down to a
+	auto rotate_up = [this, a](int32_t up, int32_t other, bool up_is_right) {
+		Node& A = nodes[a];
+		Node& U = nodes[up];
+		Node& O = nodes[other];
+		int32_t f = U.left;
+		int32_t g = U.right;
+		Node& F = nodes[f];
+		Node& G = nodes[g];
+
+		U.left = a;
+		U.parent = A.parent;
+		A.parent = up;
+		if (U.parent != NIL) {
+			if (nodes[U.parent].left == a) {
+				nodes[U.parent].left = up;
+			}
+			else {
+				nodes[U.parent].right = up;
+			}
+		}
+		else {
+			root = up;
+		}
+
+		//The highest grandchild stays with up, the other one replaces up in a
+		int32_t keep = (F.height > G.height) ? f : g;
+		int32_t move = (keep == f) ? g : f;
+		U.right = keep;
+		if (up_is_right) {
+			A.right = move;
+		}
+		else {
+			A.left = move;
+		}
+		nodes[move].parent = a;
+		A.aabb = Combine(O.aabb, nodes[move].aabb);
+		A.height = 1 + std::max(O.height, nodes[move].height);
+		U.aabb = Combine(A.aabb, nodes[keep].aabb);
+		U.height = 1 + std::max(A.height, nodes[keep].height);
+	};
+
+	if (balance > 1) {
+		rotate_up(c, b, true);
+		return c;
+	}
+	if (balance < -1) {
+		rotate_up(b, c, false);
+		return b;
+	}
+	return a;
+}
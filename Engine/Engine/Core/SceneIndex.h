@@ -0,0 +1,219 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Culling.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			/**
+			 * SceneIndex - Dynamic AABB tree for spatial queries over the scene objects.
+			 * 
+			 * Objects are identified by a non negative key (the entity) and stored as leaves with their box
+			 * enlarged by a margin, so small movements don't touch the tree. When an object leaves its enlarged
+			 * box it's removed and inserted again, the insertion picks the sibling with the lowest surface
+			 * area cost and the tree is kept balanced with rotations (AVL like), so queries are O(log n).
+			 * 
+			 * Queries report the keys of the leaves whose enlarged box passes the test, callers needing the
+			 * exact result check the real bounds of the candidates:
+			 * 
+			 * index.QuerySphere(light_position, light_range, [&](SceneIndex::Key key) {
+			 *		//key is a candidate for the light
+			 *	});
+			 * 
+			 * The index is not thread safe, queries can run concurrently only while nobody updates it.
+			 */
+			class SceneIndex {
+			public:
+				using Key = int32_t;
+
+			private:
+				static constexpr int32_t NIL = -1;
+
+				struct Aabb {
+					float min[3];
+					float max[3];
+				};
+
+				struct Node {
+					Aabb aabb;
+					int32_t parent = NIL;
+					int32_t left = NIL;
+					int32_t right = NIL;
+					//Leaf height is 0, free nodes are -1
+					int32_t height = -1;
+					Key key = NIL;
+					bool IsLeaf() const { return left == NIL; }
+				};
+
+				std::vector<Node> nodes;
+				//Leaf node of every key
+				std::vector<int32_t> leaves;
+				int32_t root = NIL;
+				int32_t free_nodes = NIL;
+				size_t count = 0;
+				float margin;
+
+				static Aabb ToAabb(const DirectX::BoundingBox& b, float margin);
+				static Aabb Combine(const Aabb& a, const Aabb& b);
+				static float Area(const Aabb& a);
+				static bool Contains(const Aabb& outer, const Aabb& inner);
+				static bool Overlaps(const Aabb& a, const Aabb& b);
+
+				int32_t AllocNode();
+				void FreeNode(int32_t index);
+				void InsertLeaf(int32_t leaf);
+				void RemoveLeaf(int32_t leaf);
+				int32_t Balance(int32_t index);
+				void Refit(int32_t index);
+
+				//Walks the tree calling f(key) for the leaves that pass the node test, test(aabb) returns
+				//0 when outside, 1 when intersecting and 2 when the node is fully inside (no more tests)
+				template<typename T, typename F>
+				void Traverse(T&& test, F&& f) const {
+					if (root == NIL) {
+						return;
+					}
+					std::vector<std::pair<int32_t, bool>> stack;
+					stack.reserve(64);
+					stack.emplace_back(root, false);
+					while (!stack.empty()) {
+						auto [index, inside] = stack.back();
+						stack.pop_back();
+						const Node& node = nodes[index];
+						if (!inside) {
+							int result = test(node.aabb);
+							if (result == 0) {
+								continue;
+							}
+							inside = (result == 2);
+						}
+						if (node.IsLeaf()) {
+							f(node.key);
+						}
+						else {
+							stack.emplace_back(node.left, inside);
+							stack.emplace_back(node.right, inside);
+						}
+					}
+				}
+
+			public:
+				//Margin added to each side of the boxes
+				explicit SceneIndex(float margin = 0.5f);
+
+				void Clear();
+				size_t Size() const { return count; }
+				bool Contains(Key key) const { return key >= 0 && key < (Key)leaves.size() && leaves[key] != NIL; }
+				//Inserts the key or updates its box, returns true if the tree has been modified
+				bool Update(Key key, const DirectX::BoundingBox& b);
+				void Remove(Key key);
+				//Height of the tree, 0 with one object
+				int32_t GetHeight() const { return root == NIL ? 0 : nodes[root].height; }
+
+				template<typename F>
+				void QueryBox(const DirectX::BoundingBox& b, F&& f) const {
+					Aabb q = ToAabb(b, 0.0f);
+					Traverse([&q](const Aabb& a) { return Overlaps(a, q) ? 1 : 0; }, f);
+				}
+
+				template<typename F>
+				void QuerySphere(const DirectX::XMFLOAT3& center, float radius, F&& f) const {
+					const float c[3] = { center.x, center.y, center.z };
+					float r2 = radius * radius;
+					Traverse([&c, r2](const Aabb& a) {
+						float d2 = 0.0f;
+						for (int i = 0; i < 3; ++i) {
+							float d = (c[i] < a.min[i]) ? a.min[i] - c[i] : ((c[i] > a.max[i]) ? c[i] - a.max[i] : 0.0f);
+							d2 += d * d;
+						}
+						return d2 <= r2 ? 1 : 0;
+						}, f);
+				}
+
+				template<typename F>
+				void QueryFrustum(const Frustum& frustum, F&& f) const {
+					Traverse([&frustum](const Aabb& a) {
+						int result = 2;
+						for (int p = 0; p < 6; ++p) {
+							const DirectX::XMFLOAT4& plane = frustum.planes[p];
+							const float n[3] = { plane.x, plane.y, plane.z };
+							//Distance of the box corners farthest and nearest along the plane normal
+							float far_d = plane.w;
+							float near_d = plane.w;
+							for (int i = 0; i < 3; ++i) {
+								far_d += n[i] * (n[i] >= 0.0f ? a.max[i] : a.min[i]);
+								near_d += n[i] * (n[i] >= 0.0f ? a.min[i] : a.max[i]);
+							}
+							if (far_d < 0.0f) {
+								return 0;
+							}
+							if (near_d < 0.0f) {
+								result = 1;
+							}
+						}
+						return result;
+						}, f);
+				}
+
+				//Objects crossed by the segment origin + t * direction, t in [0, max_t]
+				template<typename F>
+				void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float max_t, F&& f) const {
+					const float o[3] = { origin.x, origin.y, origin.z };
+					const float d[3] = { direction.x, direction.y, direction.z };
+					Traverse([&o, &d, max_t](const Aabb& a) {
+						float t0 = 0.0f;
+						float t1 = max_t;
+						for (int i = 0; i < 3; ++i) {
+							if (d[i] == 0.0f) {
+								if (o[i] < a.min[i] || o[i] > a.max[i]) {
+									return 0;
+								}
+								continue;
+							}
+							float inv = 1.0f / d[i];
+							float ta = (a.min[i] - o[i]) * inv;
+							float tb = (a.max[i] - o[i]) * inv;
+							if (ta > tb) {
+								std::swap(ta, tb);
+							}
+							t0 = ta > t0 ? ta : t0;
+							t1 = tb < t1 ? tb : t1;
+							if (t0 > t1) {
+								return 0;
+							}
+						}
+						return 1;
+						}, f);
+				}
+			};
+		}
+	}
+}
@@ -23,18 +23,30 @@ SOFTWARE.
 */
 
 #include "Scheduler.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <thread>
+#ifndef _WIN32
+#include <errno.h>
+#endif
 
 using namespace HotBite::Engine::Core;
 
 std::vector<Scheduler*> Scheduler::instances;
-int64_t Scheduler::cycles_to_nsec = 0;
+thread_local Scheduler* Scheduler::updating = nullptr;
 
 Scheduler::Scheduler() {
 	InitTimer();
+	wheel.assign(LEVEL0_SLOTS + LEVEL_SLOTS * (LEVELS - 1), NIL);
+	firing.reserve(CHUNK_SIZE);
+	t0 = GetCycles();
+	next_tick = ExpiryTick(GetElapsedNanoSeconds());
 }
 
 Scheduler::~Scheduler() {
+#ifdef _WIN32
 	CloseHandle(htimer);
+#endif
 }
 
 void Scheduler::Init(int count) {
@@ -58,6 +70,11 @@ Scheduler* Scheduler::Get(SchedulerId id) {
 	return instances[id];
 }
 
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 int64_t Scheduler::GetCycles()
 {
 	LARGE_INTEGER T1;
@@ -65,16 +82,24 @@ int64_t Scheduler::GetCycles()
 	return static_cast<int64_t>(T1.QuadPart);
 }
 
+int64_t Scheduler::GetFrequency()
+{
+	//Initialized on first use, static time functions can be called before any scheduler exists
+	static const int64_t frequency = [] {
+		LARGE_INTEGER Freq;
+		QueryPerformanceFrequency(&Freq);
+		return static_cast<int64_t>(Freq.QuadPart);
+	}();
+	return frequency;
+}
+
 void Scheduler::InitTimer() {
-	LARGE_INTEGER Freq;
 	TIMECAPS tc;
-	for (int i = 0; i < MAX_TIMERS; ++i) {
-		timer_id_counters.push((TimerId)i);
+	//High resolution waitable timers don't depend on the system timer period (Windows 10 1803+)
+	htimer = CreateWaitableTimerEx(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (htimer == NULL) {
+		htimer = CreateWaitableTimer(NULL, FALSE, NULL);
 	}
-	QueryPerformanceFrequency(&Freq);
-	cycles_to_nsec = NSEC/(static_cast<int64_t>(Freq.QuadPart));
-	t0 = GetCycles();
-	htimer = CreateWaitableTimer(NULL, FALSE, NULL);
 	if (timeGetDevCaps(&tc, sizeof(TIMECAPS)) == TIMERR_NOERROR)
 	{
 		min_sleep_msec = tc.wPeriodMin;
@@ -83,6 +108,7 @@ void Scheduler::InitTimer() {
 	else {
 		printf("InitTimer: Can't activate high resolution timers.\n");
 	}
+	oversleep_nsec = MSEC_TO_NSEC(min_sleep_msec);
 }
 
 void Scheduler::NanoSleep(int64_t nsec) {
@@ -94,152 +120,350 @@ void Scheduler::NanoSleep(int64_t nsec) {
 	}
 	WaitForSingleObject(htimer, 100);
 }
+#else
+int64_t Scheduler::GetCycles()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * NSEC + ts.tv_nsec;
+}
+
+int64_t Scheduler::GetFrequency()
+{
+	return NSEC;
+}
+
+void Scheduler::InitTimer() {
+	oversleep_nsec = MIN_SPIN_NSEC_TIME;
+}
+
+void Scheduler::NanoSleep(int64_t nsec) {
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(nsec / NSEC);
+	ts.tv_nsec = static_cast<long>(nsec % NSEC);
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR) {}
+}
+#endif
+
+int64_t Scheduler::CyclesToNanoSeconds(int64_t cycles) {
+	//Split to keep the precision without overflowing
+	const int64_t frequency = GetFrequency();
+	return (cycles / frequency) * NSEC + ((cycles % frequency) * NSEC) / frequency;
+}
+
+void Scheduler::SleepUntil(int64_t elapsed_nsec) {
+	int64_t now = GetElapsedNanoSeconds();
+	if (now >= elapsed_nsec) {
+		return;
+	}
+	int64_t spin_time = std::clamp<int64_t>(oversleep_nsec * 2, MIN_SPIN_NSEC_TIME, MAX_SPIN_NSEC_TIME);
+	int64_t sleep_time = elapsed_nsec - now - spin_time;
+	if (sleep_time > 0) {
+		NanoSleep(sleep_time);
+		int64_t woken = GetElapsedNanoSeconds();
+		int64_t oversleep = std::max<int64_t>(woken - (now + sleep_time), 0);
+		oversleep_nsec += (oversleep - oversleep_nsec) / 8;
+		now = woken;
+	}
+	while (now < elapsed_nsec) {
+		std::this_thread::yield();
+		now = GetElapsedNanoSeconds();
+	}
+	int64_t late_usec = (now - elapsed_nsec) / 1000;
+	int bucket = 0;
+	while (bucket < LATENESS_BUCKETS - 1 && late_usec >= (1LL << bucket)) {
+		++bucket;
+	}
+	lateness[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+Scheduler::LatenessHistogram Scheduler::GetLatenessHistogram() const {
+	LatenessHistogram ret;
+	for (int i = 0; i < LATENESS_BUCKETS; ++i) {
+		ret[i] = lateness[i].load(std::memory_order_relaxed);
+	}
+	return ret;
+}
+
+void Scheduler::ResetLatenessHistogram() {
+	for (auto& l : lateness) {
+		l.store(0, std::memory_order_relaxed);
+	}
+}
 
 void Scheduler::Idle() {
-	if (!timers.empty()) {
-		int64_t sleep_time = min(timers.begin()->first - GetElapsedNanoSeconds() - MSEC_TO_NSEC(min_sleep_msec), MAX_SLEEP_NSEC_TIME);
-		if (sleep_time > MSEC_TO_NSEC(min_sleep_msec + 2)) {
-			NanoSleep(sleep_time);
-		}
+	timer_mutex.lock();
+	int64_t next = NextExpiry();
+	timer_mutex.unlock();
+	if (next >= 0) {
+		SleepUntil(std::min<int64_t>(next, GetElapsedNanoSeconds() + MAX_SLEEP_NSEC_TIME));
 	}
 }
 
 int64_t Scheduler::GetNanoSeconds() {
-	return ((Scheduler::GetCycles())) * cycles_to_nsec;
+	return CyclesToNanoSeconds(Scheduler::GetCycles());
 }
 
 int64_t Scheduler::GetElapsedNanoSeconds() {
-	return ((GetCycles() - t0)) * cycles_to_nsec;
+	return CyclesToNanoSeconds(GetCycles() - t0);
 }
 
 int64_t Scheduler::GetElapsedMilliSeconds() {
 	return NSEC_TO_MSEC(Scheduler::GetElapsedNanoSeconds());
 }
 
-int Scheduler::RegisterTimer(int64_t period_nsec, std::function<bool(const TimerData&)> cb) {
-	TimerData td = {};
-	if (cb != nullptr) {
-		bool done = false;
-		td.period = period_nsec;
-		td.cb = cb;
-		td.start = GetElapsedNanoSeconds();
-		new_timer_mutex.lock();
-		assert(!timer_id_counters.empty() && "max scheduler timers reached.");
-		td.id = timer_id_counters.front();
-		timer_id_counters.pop();
-		new_timers.push_back(td);
-		new_timer_mutex.unlock();
+Scheduler::Timer* Scheduler::FindTimer(TimerId id) {
+	Timer* ret = nullptr;
+	if (id != INVALID_TIMER_ID) {
+		uint32_t index = TimerIndex(id);
+		if (index < timer_count) {
+			Timer& timer = GetTimer(index);
+			if (timer.state != TimerState::FREE && timer.data.id == id) {
+				ret = &timer;
+			}
+		}
 	}
-	return td.id;
+	return ret;
 }
 
-Scheduler::TimerId Scheduler::Exec(std::function<bool(const TimerData&)> cb) {
-	return RegisterTimer(0, cb);
+uint32_t Scheduler::AllocTimer() {
+	uint32_t index;
+	if (!free_timers.empty()) {
+		index = free_timers.back();
+		free_timers.pop_back();
+	}
+	else {
+		assert(timer_count <= ID_INDEX_MASK && "max scheduler timers reached.");
+		if (timer_count % CHUNK_SIZE == 0) {
+			timer_chunks.emplace_back(std::make_unique<Timer[]>(CHUNK_SIZE));
+		}
+		index = timer_count++;
+	}
+	return index;
 }
 
+void Scheduler::FreeTimer(uint32_t index) {
+	Timer& timer = GetTimer(index);
+	timer.data.cb = nullptr;
+	timer.state = TimerState::FREE;
+	timer.generation = (timer.generation + 1) & ID_GENERATION_MASK;
+	free_timers.push_back(index);
+}
 
-void Scheduler::_RegisterTimer(TimerData&& td) {
-	bool done = false;
-	//If we already have a timer with that period
-	//add the callback to the timer
-	for (auto timer = timers.begin(); timer != timers.end(); ++timer) {
-		if (!timer->second.empty() && timer->second.front().period == td.period) {
-			timer->second.push_back(td);
-			td.total = timer->first;
-			done = true;
-			break;
+void Scheduler::Link(uint32_t index) {
+	Timer& timer = GetTimer(index);
+	int64_t tick = ExpiryTick(timer.expiry);
+	int64_t delta = tick - next_tick;
+	uint32_t slot;
+	if (delta < 0) {
+		//Already expired, run in the next tick
+		slot = (uint32_t)(next_tick & (LEVEL0_SLOTS - 1));
+	}
+	else if (delta < LEVEL0_SLOTS) {
+		slot = (uint32_t)(tick & (LEVEL0_SLOTS - 1));
+	}
+	else {
+		if (delta >= WHEEL_TICKS) {
+			//Out of range, park it in the farthest slot, it will be cascaded again until due
+			tick = next_tick + WHEEL_TICKS - 1;
+		}
+		int level = 1;
+		int shift = LEVEL0_BITS;
+		while (level < LEVELS - 1 && delta >= (1LL << (shift + LEVEL_BITS))) {
+			++level;
+			shift += LEVEL_BITS;
 		}
+		slot = LEVEL0_SLOTS + (level - 1) * LEVEL_SLOTS + (uint32_t)((tick >> shift) & (LEVEL_SLOTS - 1));
 	}
-	if (!done) {
-		td.total = GetElapsedNanoSeconds();
-		timers[td.total + td.period].emplace_back(td);
+	timer.slot = slot;
+	timer.prev = NIL;
+	timer.next = wheel[slot];
+	if (timer.next != NIL) {
+		GetTimer(timer.next).prev = index;
 	}
+	wheel[slot] = index;
+	timer.state = TimerState::ARMED;
 }
 
-void Scheduler::RemoveTimerAsync(Scheduler::TimerId id) {
-	if (id != INVALID_TIMER_ID) {
-		remove_timer_mutex.lock();
-		removed_timers.push_back(id);
-		remove_timer_mutex.unlock();
+void Scheduler::Unlink(uint32_t index) {
+	Timer& timer = GetTimer(index);
+	if (timer.prev != NIL) {
+		GetTimer(timer.prev).next = timer.next;
+	}
+	else {
+		wheel[timer.slot] = timer.next;
+	}
+	if (timer.next != NIL) {
+		GetTimer(timer.next).prev = timer.prev;
+	}
+	timer.prev = timer.next = timer.slot = NIL;
+}
+
+void Scheduler::Cascade(int level) {
+	int shift = LEVEL0_BITS + (level - 1) * LEVEL_BITS;
+	uint32_t slot = LEVEL0_SLOTS + (level - 1) * LEVEL_SLOTS + (uint32_t)((next_tick >> shift) & (LEVEL_SLOTS - 1));
+	uint32_t index = wheel[slot];
+	wheel[slot] = NIL;
+	while (index != NIL) {
+		uint32_t next = GetTimer(index).next;
+		Link(index);
+		index = next;
+	}
+}
+
+int64_t Scheduler::NextExpiry() const {
+	//Exact in level 0, otherwise the next cascade point is returned as upper levels are not sorted
+	for (uint32_t i = 0; i < LEVEL0_SLOTS; ++i) {
+		if (wheel[(next_tick + i) & (LEVEL0_SLOTS - 1)] != NIL) {
+			return (next_tick + i) << TICK_SHIFT;
+		}
+	}
+	for (size_t slot = LEVEL0_SLOTS; slot < wheel.size(); ++slot) {
+		if (wheel[slot] != NIL) {
+			return ((next_tick | (LEVEL0_SLOTS - 1)) + 1) << TICK_SHIFT;
+		}
 	}
+	return -1;
+}
+
+Scheduler::TimerId Scheduler::RegisterTimer(int64_t period_nsec, std::function<bool(const TimerData&)> cb, const char* name) {
+	TimerId id = INVALID_TIMER_ID;
+	if (cb != nullptr) {
+		int64_t now = GetElapsedNanoSeconds();
+		timer_mutex.lock();
+		uint32_t index = AllocTimer();
+		Timer& timer = GetTimer(index);
+		id = (TimerId)((timer.generation << ID_INDEX_BITS) | index);
+		timer.data.period = period_nsec;
+		timer.data.elapsed = 0;
+		timer.data.total = now;
+		timer.data.start = now;
+		timer.data.id = id;
+		timer.data.name = name;
+		timer.data.cb = std::move(cb);
+		timer.expiry = now + period_nsec;
+		Link(index);
+		timer_mutex.unlock();
+	}
+	return id;
+}
+
+Scheduler::TimerId Scheduler::Exec(std::function<bool(const TimerData&)> cb) {
+	return RegisterTimer(0, cb, "Scheduler::Exec");
+}
+
+void Scheduler::RemoveTimerAsync(Scheduler::TimerId id) {
+	CancelTimer(id, false);
 }
  
 bool Scheduler::RemoveTimer(Scheduler::TimerId id) {
+	return CancelTimer(id, true);
+}
+
+bool Scheduler::CancelTimer(Scheduler::TimerId id, bool wait) {
 	bool done = false;
-	if (id != INVALID_TIMER_ID) {
-		new_timer_mutex.lock();
-		for (auto t = new_timers.begin(); t != new_timers.end(); ++t) {
-			if (t->id == id) {
-				new_timers.erase(t);
-				done = true;
-				break;
-			}
-		}
-		new_timer_mutex.unlock();
-		if (!done)
-		{
-			timer_mutex.lock();
-			for (auto timer = timers.begin(); timer != timers.end(); ++timer) {
-				for (auto timer_data = timer->second.begin(); timer_data != timer->second.end(); ++timer_data) {
-					if (timer_data->id == id) {
-						timer->second.erase(timer_data);
-						done = true;
-						break;
-					}
-				}
-			}
-			timer_mutex.unlock();
+	bool running = false;
+	uint32_t index = TimerIndex(id);
+	timer_mutex.lock();
+	Timer* timer = FindTimer(id);
+	if (timer != nullptr) {
+		switch (timer->state) {
+		case TimerState::ARMED:
+			Unlink(index);
+			FreeTimer(index);
+			done = true;
+			break;
+		case TimerState::FIRING:
+			//Released by Update once the callback returns
+			timer->state = TimerState::CANCELLED;
+			running = (running_timer.load(std::memory_order_relaxed) == index);
+			done = true;
+			break;
+		default:
+			break;
 		}
-		if (done) {
-			new_timer_mutex.lock();
-			timer_id_counters.push(id);
-			new_timer_mutex.unlock();
+	}
+	timer_mutex.unlock();
+	if (running && wait && updating != this) {
+		//The callback may be using what the caller is about to release
+		uint32_t current = running_timer.load(std::memory_order_acquire);
+		while (current == index) {
+			running_timer.wait(current, std::memory_order_acquire);
+			current = running_timer.load(std::memory_order_acquire);
 		}
 	}
 	return done;
 }
 
 void Scheduler::Update() {
-	remove_timer_mutex.lock();
-	while (!removed_timers.empty()) {
-		RemoveTimer(removed_timers.front());
-		removed_timers.pop_front();
-	}
-	remove_timer_mutex.unlock();
-	new_timer_mutex.lock();
-	while (!new_timers.empty()) {
-		_RegisterTimer(std::move(new_timers.front()));
-		new_timers.pop_front();
-	}
-	new_timer_mutex.unlock();
-
 	timer_mutex.lock();
 	int64_t t = GetElapsedNanoSeconds();
-	while (!timers.empty()) {
-		std::map<int64_t, std::list<TimerData>>::iterator timer = timers.begin();
-		if (timer->first < t) {
-			for (auto timer_data = timer->second.begin(); timer_data != timer->second.end(); ++timer_data) {
-				timer_data->elapsed = t - timer_data->total;
-				timer_data->total = t;
-				if (timer_data->cb(*timer_data)) {
-					if (timer->first + timer_data->period < t) {
-						timers[t].emplace_back(*timer_data);
-					}
-					else {
-						timers[timer->first + timer_data->period].emplace_back(*timer_data);
-					}
-				}
-				else {
-					timer_id_counters.push(timer_data->id);
+	int64_t current_tick = t >> TICK_SHIFT;
+	firing.clear();
+	while (next_tick <= current_tick) {
+		uint32_t slot = (uint32_t)(next_tick & (LEVEL0_SLOTS - 1));
+		if (slot == 0) {
+			//Cascade upper levels when the lower one wraps
+			for (int level = 1; level < LEVELS; ++level) {
+				Cascade(level);
+				if (((next_tick >> (LEVEL0_BITS + (level - 1) * LEVEL_BITS)) & (LEVEL_SLOTS - 1)) != 0) {
+					break;
 				}
 			}
-			timers.erase(timer);
 		}
-		else {
-			break;
+		int64_t tick = next_tick++;
+		uint32_t index = wheel[slot];
+		wheel[slot] = NIL;
+		while (index != NIL) {
+			Timer& timer = GetTimer(index);
+			uint32_t next = timer.next;
+			timer.prev = timer.next = timer.slot = NIL;
+			if (ExpiryTick(timer.expiry) <= tick) {
+				timer.state = TimerState::FIRING;
+				firing.push_back(&timer);
+			}
+			else {
+				Link(index);
+			}
+			index = next;
 		}
 	}
 	timer_mutex.unlock();
+
+	//Callbacks run unlocked so they can register and remove timers
+	Scheduler* prev_updating = updating;
+	updating = this;
+	for (Timer* timer : firing) {
+		uint32_t index = TimerIndex(timer->data.id);
+		//A previous callback may have cancelled it
+		timer_mutex.lock();
+		bool cancelled = (timer->state == TimerState::CANCELLED);
+		if (!cancelled) {
+			running_timer.store(index, std::memory_order_relaxed);
+		}
+		timer_mutex.unlock();
+		bool keep = false;
+		if (!cancelled) {
+			timer->data.elapsed = t - timer->data.total;
+			timer->data.total = t;
+			{
+				ProfileZone zone(timer->data.name);
+				keep = timer->data.cb(timer->data);
+			}
+			running_timer.store(NIL, std::memory_order_release);
+			running_timer.notify_all();
+		}
+		timer_mutex.lock();
+		if (keep && timer->state == TimerState::FIRING) {
+			timer->expiry = std::max<int64_t>(timer->expiry + timer->data.period, t);
+			Link(index);
+		}
+		else {
+			FreeTimer(index);
+		}
+		timer_mutex.unlock();
+	}
+	updating = prev_updating;
 }
 
 void Scheduler::StartCount(Scheduler::CounterId count_id) {
@@ -24,22 +24,32 @@ SOFTWARE.
 
 #pragma once
 
-#include "Defines.h"
-#include "Utils.h"
-
-
+#ifdef _WIN32
+//winsock2 goes before windows.h, like in Defines.h
+#include <winsock2.h>
 #include <windows.h>
-#include <inttypes.h>
 #include <profileapi.h>
+#else
+#include <time.h>
+#endif
+#include <inttypes.h>
+#include <cassert>
+#include <cstdio>
+#include <array>
+#include <atomic>
 #include <unordered_map>
 #include <map>
 #include <mutex>
 #include <functional>
 #include <queue>
+#include <memory>
+#include <vector>
 #include <Core/SpinLock.h>
 
+#ifdef _WIN32
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "winmm.lib")
+#endif
 
 namespace HotBite {
 	namespace Engine {
@@ -78,6 +88,7 @@ namespace HotBite {
 						return true;
                     });
 			 * 
+			 * Sequential operations that wait for timers or other threads can be written as coroutines, see Task.
 			 */
 			class Scheduler {
 			public:
@@ -88,9 +99,16 @@ namespace HotBite {
 					int64_t total;
 					int64_t start;
 					int id;
+					//Profiler zone name
+					const char* name;
 					std::function<bool(const TimerData&)> cb;
 				};
 
+				//Wake up lateness histogram, bucket i counts wake ups less than 2^i usec late,
+				//the last bucket counts all the later ones
+				static constexpr int LATENESS_BUCKETS = 16;
+				using LatenessHistogram = std::array<uint64_t, LATENESS_BUCKETS>;
+
 				using SchedulerId = int32_t;
 				using TimerId = int32_t;
 				using CounterId = int32_t;
@@ -100,32 +118,92 @@ namespace HotBite {
 
 			private:
 				static int constexpr MAX_SLEEP_NSEC_TIME = 100000000; //Maximum sleep 100 msec.
-				static int constexpr MAX_TIMERS = 256;
+				static int constexpr MIN_SPIN_NSEC_TIME = 50000; //Spin at least the last 50 usec.
+				static int constexpr MAX_SPIN_NSEC_TIME = 4000000; //Spin at most the last 4 msec.
+
+				/**
+				 * Timers are kept in a hierarchical timing wheel: level 0 has one slot per tick, each
+				 * upper level slot spans a whole lower level and is cascaded down when the wheel reaches it.
+				 * Slots are intrusive lists of timer indices so insert and cancel are O(1), and re-arming
+				 * a timer just links the same node again.
+				 * Timer ids pack the node index with a generation, so stale ids of reused nodes are ignored.
+				 */
+				static constexpr int TICK_SHIFT = 16; //~65 usec per tick
+				static constexpr int LEVEL0_BITS = 8;
+				static constexpr int LEVEL_BITS = 6;
+				static constexpr int LEVELS = 4;
+				static constexpr uint32_t LEVEL0_SLOTS = 1 << LEVEL0_BITS;
+				static constexpr uint32_t LEVEL_SLOTS = 1 << LEVEL_BITS;
+				static constexpr int64_t WHEEL_TICKS = 1LL << (LEVEL0_BITS + LEVEL_BITS * (LEVELS - 1));
+				static constexpr uint32_t NIL = 0xFFFFFFFF;
+				static constexpr int ID_INDEX_BITS = 20;
+				static constexpr uint32_t ID_INDEX_MASK = (1 << ID_INDEX_BITS) - 1;
+				static constexpr uint32_t ID_GENERATION_MASK = 0x7FF;
+				static constexpr uint32_t CHUNK_SIZE = 256;
+
+				enum class TimerState: uint8_t {
+					FREE,
+					ARMED,
+					FIRING,
+					CANCELLED
+				};
+
+				struct Timer {
+					TimerData data;
+					int64_t expiry = 0;
+					uint32_t prev = NIL;
+					uint32_t next = NIL;
+					uint32_t slot = NIL;
+					uint32_t generation = 0;
+					TimerState state = TimerState::FREE;
+				};
 
 				static std::vector<Scheduler*> instances;
-				static int64_t cycles_to_nsec;
+				static int64_t GetFrequency();
 				static int64_t GetCycles();
+				static int64_t CyclesToNanoSeconds(int64_t cycles);
 				
 				int64_t t0;
-				int min_sleep_msec;
+				int min_sleep_msec = 0;
+				//How late the OS wakes us up (moving average), it's the time we spin before a deadline
+				int64_t oversleep_nsec = 0;
+				std::array<std::atomic<uint64_t>, LATENESS_BUCKETS> lateness{};
 				std::unordered_map<CounterId, int64_t> counters;
-				std::list<TimerData> new_timers;
-				std::list<TimerId> removed_timers;
-				std::map<int64_t, std::list<TimerData>> timers;
-				std::queue<TimerId> timer_id_counters;
+				
+				//Timer nodes live in fixed size chunks so pointers stay valid while the pool grows
+				std::vector<std::unique_ptr<Timer[]>> timer_chunks;
+				uint32_t timer_count = 0;
+				std::vector<uint32_t> free_timers;
+				std::vector<uint32_t> wheel;
+				std::vector<Timer*> firing;
+				int64_t next_tick = 0;
+				//Index of the timer whose callback is running, removals from other threads wait on it
+				std::atomic<uint32_t> running_timer{ NIL };
+				//Scheduler updated by the current thread, its own callbacks never wait for themselves
+				static thread_local Scheduler* updating;
 				
 				std::recursive_mutex counters_mutex;
 				spin_lock timer_mutex;
-				spin_lock new_timer_mutex;
-				spin_lock remove_timer_mutex;
 
+#ifdef _WIN32
 				HANDLE htimer;
+#endif
 				
 				void InitTimer();
 				Scheduler();
 				virtual ~Scheduler();
 
-				void _RegisterTimer(TimerData&& td);
+				Timer& GetTimer(uint32_t index) { return timer_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]; }
+				Timer* FindTimer(TimerId id);
+				uint32_t AllocTimer();
+				void FreeTimer(uint32_t index);
+				void Link(uint32_t index);
+				void Unlink(uint32_t index);
+				void Cascade(int level);
+				int64_t NextExpiry() const;
+				bool CancelTimer(TimerId id, bool wait);
+				static int64_t ExpiryTick(int64_t expiry) { return (expiry + (1LL << TICK_SHIFT) - 1) >> TICK_SHIFT; }
+				static uint32_t TimerIndex(TimerId id) { return (uint32_t)id & ID_INDEX_MASK; }
 
 			public:
 				//Scheduler management
@@ -141,13 +219,20 @@ namespace HotBite {
 
 				//Time functions				
 				void NanoSleep(int64_t nsec);
+				//Sleeps until the given elapsed time, the OS sleep is followed by a spin to hit the deadline
+				void SleepUntil(int64_t elapsed_nsec);
+				LatenessHistogram GetLatenessHistogram() const;
+				void ResetLatenessHistogram();
 				int64_t GetElapsedNanoSeconds();
 				int64_t GetElapsedMilliSeconds();
 
-				//Timers management
-				TimerId RegisterTimer(int64_t period_nsec, std::function<bool(const TimerData&)> cb);
+				//Timers management, timers can be removed from any thread, also from their own callback
+				TimerId RegisterTimer(int64_t period_nsec, std::function<bool(const TimerData&)> cb, const char* name = "Scheduler::Timer");
 				TimerId Exec(std::function<bool(const TimerData&)> cb);
+				//Once it returns the callback is not running and won't run again, so its captures can be released.
+				//If the callback is running in other thread it waits for it, don't call it holding locks the callback takes.
 				bool RemoveTimer(TimerId id);
+				//Cancels the timer without waiting, a running callback may still be finishing when it returns
 				void RemoveTimerAsync(TimerId id);
 
 
@@ -26,40 +26,233 @@ SOFTWARE.
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <thread>
+#include <immintrin.h>
+#ifdef HOTBITE_LOCK_STATS
+#include <algorithm>
+#include <chrono>
+#include <source_location>
+#include <vector>
+#endif
 
 namespace HotBite {
     namespace Engine {
         namespace Core {
 
+#ifdef HOTBITE_LOCK_STATS
+            //Lock statistics of one call site
+            struct LockReport {
+                const char* file = nullptr;
+                uint32_t line = 0;
+                uint64_t acquisitions = 0;
+                uint64_t contended = 0;
+                uint64_t wait_nsec = 0;
+                uint64_t max_wait_nsec = 0;
+                uint64_t hold_nsec = 0;
+            };
+
+            struct LockSite {
+                std::atomic<uint32_t> state{ 0 };
+                const char* file = nullptr;
+                uint32_t line = 0;
+                std::atomic<uint64_t> acquisitions{ 0 };
+                std::atomic<uint64_t> contended{ 0 };
+                std::atomic<uint64_t> wait_nsec{ 0 };
+                std::atomic<uint64_t> max_wait_nsec{ 0 };
+                std::atomic<uint64_t> hold_nsec{ 0 };
+
+                void RecordAcquire(bool was_contended, uint64_t wait) {
+                    acquisitions.fetch_add(1, std::memory_order_relaxed);
+                    if (was_contended) {
+                        contended.fetch_add(1, std::memory_order_relaxed);
+                        wait_nsec.fetch_add(wait, std::memory_order_relaxed);
+                        uint64_t m = max_wait_nsec.load(std::memory_order_relaxed);
+                        while (wait > m && !max_wait_nsec.compare_exchange_weak(m, wait, std::memory_order_relaxed)) {}
+                    }
+                }
+
+                void RecordRelease(uint64_t hold) {
+                    hold_nsec.fetch_add(hold, std::memory_order_relaxed);
+                }
+            };
+
+            /**
+             * Lock instrumentation, enabled defining HOTBITE_LOCK_STATS.
+             * Locks record per call site the number of acquisitions, how many of them found the lock taken,
+             * the time waiting and the time holding the lock (exclusive locks only).
+             * Sites are kept in a fixed lock-free table so recording never takes a lock.
+             */
+            class LockStats {
+            private:
+                static constexpr size_t MAX_SITES = 1024;
+                static constexpr uint32_t SITE_EMPTY = 0;
+                static constexpr uint32_t SITE_WRITING = 1;
+                static constexpr uint32_t SITE_READY = 2;
+                static inline LockSite sites[MAX_SITES];
+                static inline LockSite overflow;
+
+            public:
+                static int64_t Now() {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+                static LockSite* GetSite(const std::source_location& loc) {
+                    size_t h = (std::hash<const void*>{}(loc.file_name()) ^ (loc.line() * 0x9E3779B1u)) % MAX_SITES;
+                    for (size_t i = 0; i < MAX_SITES; ++i) {
+                        LockSite& s = sites[(h + i) % MAX_SITES];
+                        uint32_t state = s.state.load(std::memory_order_acquire);
+                        if (state == SITE_EMPTY && s.state.compare_exchange_strong(state, SITE_WRITING, std::memory_order_acquire)) {
+                            s.file = loc.file_name();
+                            s.line = loc.line();
+                            s.state.store(SITE_READY, std::memory_order_release);
+                            return &s;
+                        }
+                        while (state == SITE_WRITING) {
+                            _mm_pause();
+                            state = s.state.load(std::memory_order_acquire);
+                        }
+                        if (s.line == loc.line() && s.file == loc.file_name()) {
+                            return &s;
+                        }
+                    }
+                    return &overflow;
+                }
+
+                //Sites sorted by the worst wait time
+                static std::vector<LockReport> GetWorstSites(size_t count) {
+                    std::vector<LockReport> ret;
+                    for (LockSite& s : sites) {
+                        if (s.state.load(std::memory_order_acquire) == SITE_READY) {
+                            ret.push_back({ s.file, s.line, s.acquisitions.load(), s.contended.load(),
+                                s.wait_nsec.load(), s.max_wait_nsec.load(), s.hold_nsec.load() });
+                        }
+                    }
+                    std::sort(ret.begin(), ret.end(), [](const LockReport& a, const LockReport& b) { return a.max_wait_nsec > b.max_wait_nsec; });
+                    if (ret.size() > count) {
+                        ret.resize(count);
+                    }
+                    return ret;
+                }
+
+                static void Reset() {
+                    for (LockSite& s : sites) {
+                        s.acquisitions = 0;
+                        s.contended = 0;
+                        s.wait_nsec = 0;
+                        s.max_wait_nsec = 0;
+                        s.hold_nsec = 0;
+                    }
+                }
+            };
+
+#define HOTBITE_LOCK_SITE const std::source_location& site_loc = std::source_location::current()
+#else
+#define HOTBITE_LOCK_SITE
+#endif
+
+            /**
+             * Backoff used while a lock is taken: exponential spin, then yield to the OS
+             * and finally the caller parks the thread in the lock address.
+             */
+            class LockBackoff {
+            private:
+                static constexpr uint32_t SPIN_ROUNDS = 7; //Up to 64 pauses per round
+                static constexpr uint32_t YIELD_ROUNDS = 8;
+                uint32_t n = 0;
+
+            public:
+                bool Spinning() const {
+                    return n < SPIN_ROUNDS + YIELD_ROUNDS;
+                }
+
+                void Pause() {
+                    if (n < SPIN_ROUNDS) {
+                        for (uint32_t i = 0; i < (1u << n); ++i) {
+                            _mm_pause();
+                        }
+                    }
+                    else {
+                        std::this_thread::yield();
+                    }
+                    ++n;
+                }
+            };
+
             /**
              * Spin lock class, it follows naming convention of stl 
              * so we can switch between mutex to spin_locks.
+             * When the lock is not released after a short spin the waiting threads
+             * are parked (futex/WaitOnAddress), so oversubscribed threads don't burn
+             * the time slice of the owner.
              */
             class spin_lock {
             private:
-                std::atomic<bool> l{ false };
+                static constexpr uint32_t UNLOCKED = 0;
+                static constexpr uint32_t LOCKED = 1;
+                //Locked and there can be parked threads
+                static constexpr uint32_t PARKED = 2;
+
+                std::atomic<uint32_t> l{ UNLOCKED };
+#ifdef HOTBITE_LOCK_STATS
+                LockSite* site = nullptr;
+                int64_t acquired = 0;
+#endif
+
+                void lock_slow() {
+                    LockBackoff backoff;
+                    while (backoff.Spinning()) {
+                        uint32_t expected = UNLOCKED;
+                        if (l.load(std::memory_order_relaxed) == UNLOCKED &&
+                            l.compare_exchange_weak(expected, LOCKED, std::memory_order_acquire)) {
+                            return;
+                        }
+                        backoff.Pause();
+                    }
+                    while (l.exchange(PARKED, std::memory_order_acquire) != UNLOCKED) {
+                        l.wait(PARKED, std::memory_order_relaxed);
+                    }
+                }
 
             public:
                 spin_lock(){}
                 spin_lock(const spin_lock& other) {}
                 spin_lock& operator=(const spin_lock& other) { return *this; }
-                void lock() {
-                    while (true) {
-                        if (!l.exchange(true, std::memory_order_acquire)) {
-                            return;
-                        }
-                        while (l.load(std::memory_order_relaxed)) {
-                            _mm_pause();
-                        }
+                void lock(HOTBITE_LOCK_SITE) {
+#ifdef HOTBITE_LOCK_STATS
+                    int64_t t0 = LockStats::Now();
+                    bool contended = false;
+#endif
+                    uint32_t expected = UNLOCKED;
+                    if (!l.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire)) {
+#ifdef HOTBITE_LOCK_STATS
+                        contended = true;
+#endif
+                        lock_slow();
                     }
+#ifdef HOTBITE_LOCK_STATS
+                    acquired = LockStats::Now();
+                    site = LockStats::GetSite(site_loc);
+                    site->RecordAcquire(contended, acquired - t0);
+#endif
                 }
 
                 bool try_lock() {
-                    return !l.load(std::memory_order_relaxed) && !l.exchange(true, std::memory_order_acquire);
+                    uint32_t expected = UNLOCKED;
+                    return l.load(std::memory_order_relaxed) == UNLOCKED &&
+                        l.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
                 }
 
                 void unlock() {
-                    l.store(false, std::memory_order_release);
+#ifdef HOTBITE_LOCK_STATS
+                    if (site != nullptr) {
+                        site->RecordRelease(LockStats::Now() - acquired);
+                        site = nullptr;
+                    }
+#endif
+                    if (l.exchange(UNLOCKED, std::memory_order_release) == PARKED) {
+                        l.notify_one();
+                    }
                 }
             };
 
@@ -67,9 +260,20 @@ namespace HotBite {
             class AutoLock {
                 L& l;
             public:
+#ifdef HOTBITE_LOCK_STATS
+                AutoLock(L& lock, const std::source_location& site_loc = std::source_location::current()) : l(lock) {
+                    if constexpr (requires { l.lock(site_loc); }) {
+                        l.lock(site_loc);
+                    }
+                    else {
+                        l.lock();
+                    }
+                }
+#else
                 AutoLock(L& lock) : l(lock) {
                     l.lock();
                 }
+#endif
 
                 ~AutoLock() {
                     l.unlock();
@@ -78,104 +282,133 @@ namespace HotBite {
 
             /**
              * Read shared/write exclusive spin lock class, it follows naming convention of stl.
+             * Writer preferring: once a writer is waiting new readers wait, so a steady
+             * stream of readers can't starve writers. Read locks are not reentrant
+             * for this reason. Waiting threads back off and park like spin_lock.
              */
             class rw_spin_lock {
             private:
-                static constexpr int SPIN_LOCK_UNLOCK = 0;
-                static constexpr int SPIN_LOCK_WRITE_LOCK = -1;
+                static constexpr uint32_t WRITER = 0x80000000;
+
+                //Readers count, or WRITER when write locked
+                std::atomic<uint32_t> state{ 0 };
+                //Writers waiting or holding the lock
+                std::atomic<uint32_t> writers{ 0 };
+                //Threads parked in state or writers
+                std::atomic<uint32_t> parked{ 0 };
+#ifdef HOTBITE_LOCK_STATS
+                LockSite* site = nullptr;
+                int64_t acquired = 0;
+#endif
 
-                std::atomic<int> l;
             public:
 
-                rw_spin_lock()
-                {
-                    std::atomic_store_explicit(&l, SPIN_LOCK_UNLOCK, std::memory_order_relaxed);
-                }
+                rw_spin_lock() {}
 
-                void read_lock()
+                void read_lock(HOTBITE_LOCK_SITE)
                 {
-                    int expected;
-                    int desired;
-
+#ifdef HOTBITE_LOCK_STATS
+                    int64_t t0 = LockStats::Now();
+                    bool contended = false;
+#endif
+                    LockBackoff backoff;
                     while (true)
                     {
-                        expected = atomic_load_explicit(&l, std::memory_order_relaxed);
-                        if (expected >= 0)
+                        uint32_t w = writers.load(std::memory_order_acquire);
+                        if (w == 0)
                         {
-                            desired = 1 + expected;
-                            if (atomic_compare_exchange_weak_explicit(&l, &expected, desired, std::memory_order_relaxed, std::memory_order_relaxed))
+                            uint32_t expected = state.load(std::memory_order_relaxed);
+                            if ((expected & WRITER) == 0 &&
+                                state.compare_exchange_weak(expected, expected + 1, std::memory_order_acquire))
                                 break; // success
                         }
-                    }
-                    std::atomic_thread_fence(std::memory_order_acquire); // sync
-                }
-
-                void read_unlock()
-                {
-                    int expected;
-                    int desired;
-
-                    while (true)
-                    {
-                        expected = atomic_load_explicit(&l, std::memory_order_relaxed);
-
-                        if (expected > 0)
+#ifdef HOTBITE_LOCK_STATS
+                        contended = true;
+#endif
+                        if (backoff.Spinning())
                         {
-                            desired = expected - 1;
-
-                            std::atomic_thread_fence(std::memory_order_release); // sync
-                            if (atomic_compare_exchange_weak_explicit(&l, &expected, desired, std::memory_order_relaxed, std::memory_order_relaxed))
-                                break; // success
+                            backoff.Pause();
+                        }
+                        else if (w != 0)
+                        {
+                            parked.fetch_add(1);
+                            writers.wait(w);
+                            parked.fetch_sub(1);
                         }
                         else
                         {
-                            assert(false);
+                            std::this_thread::yield();
                         }
                     }
+#ifdef HOTBITE_LOCK_STATS
+                    LockStats::GetSite(site_loc)->RecordAcquire(contended, LockStats::Now() - t0);
+#endif
                 }
 
-                void write_lock()
+                void read_unlock()
                 {
-                    int expected;
-                    int desired;
-
-                    while (true)
+                    uint32_t prev = state.fetch_sub(1, std::memory_order_release);
+                    assert(prev > 0 && (prev & WRITER) == 0);
+                    if (prev == 1 && parked.load() > 0)
                     {
-                        expected = atomic_load_explicit(&l, std::memory_order_relaxed);
-
-                        if (expected == SPIN_LOCK_UNLOCK)
-                        {
-                            desired = SPIN_LOCK_WRITE_LOCK;
-                            if (atomic_compare_exchange_weak_explicit(&l, &expected, desired, std::memory_order_relaxed, std::memory_order_relaxed))
-                                break; // success
-                        }
+                        state.notify_all();
                     }
-
-                    std::atomic_thread_fence(std::memory_order_release); // sync
                 }
 
-                void write_unlock()
+                void write_lock(HOTBITE_LOCK_SITE)
                 {
-                    int expected;
-                    int desired;
-
+#ifdef HOTBITE_LOCK_STATS
+                    int64_t t0 = LockStats::Now();
+                    bool contended = false;
+#endif
+                    writers.fetch_add(1);
+                    LockBackoff backoff;
                     while (true)
                     {
-                        expected = atomic_load_explicit(&l, std::memory_order_relaxed);
-
-                        if (expected == SPIN_LOCK_WRITE_LOCK)
+                        uint32_t expected = 0;
+                        if (state.compare_exchange_weak(expected, WRITER, std::memory_order_acquire))
+                            break; // success
+#ifdef HOTBITE_LOCK_STATS
+                        contended = true;
+#endif
+                        if (backoff.Spinning())
                         {
-                            desired = SPIN_LOCK_UNLOCK;
-
-                            std::atomic_thread_fence(std::memory_order_release); // sync
-                            if (atomic_compare_exchange_weak_explicit(&l, &expected, desired, std::memory_order_relaxed, std::memory_order_relaxed))
-                                break; // success
+                            backoff.Pause();
                         }
                         else
                         {
-                            assert(false);
+                            parked.fetch_add(1);
+                            expected = state.load();
+                            if (expected != 0)
+                            {
+                                state.wait(expected);
+                            }
+                            parked.fetch_sub(1);
                         }
                     }
+#ifdef HOTBITE_LOCK_STATS
+                    acquired = LockStats::Now();
+                    site = LockStats::GetSite(site_loc);
+                    site->RecordAcquire(contended, acquired - t0);
+#endif
+                }
+
+                void write_unlock()
+                {
+                    assert(state.load(std::memory_order_relaxed) == WRITER);
+#ifdef HOTBITE_LOCK_STATS
+                    if (site != nullptr) {
+                        site->RecordRelease(LockStats::Now() - acquired);
+                        site = nullptr;
+                    }
+#endif
+                    state.store(0, std::memory_order_release);
+                    writers.fetch_sub(1);
+                    if (parked.load() > 0)
+                    {
+                        state.notify_all();
+                        writers.notify_all();
+                    }
                 }
             };
         }
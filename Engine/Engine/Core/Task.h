@@ -0,0 +1,317 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Core/Scheduler.h>
+#include <Core/JobSystem.h>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			//Resumes the coroutine in the next update of the scheduler, or right now if there is no scheduler
+			inline void ResumeOn(Scheduler* scheduler, std::coroutine_handle<> handle) {
+				if (scheduler != nullptr) {
+					scheduler->RegisterTimer(0, [handle](const Scheduler::TimerData&) {
+						handle.resume();
+						return false;
+						}, "Task::Resume");
+				}
+				else {
+					handle.resume();
+				}
+			}
+
+			template<typename T>
+			struct TaskResult {
+				std::optional<T> value;
+				template<typename U>
+				void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+				T Take() { return std::move(*value); }
+			};
+
+			template<>
+			struct TaskResult<void> {
+				void return_void() {}
+				void Take() {}
+			};
+
+			/**
+			 * Task - Coroutine driven by the scheduler threads.
+			 * 
+			 * Long operations (loading assets, AI behaviours...) can be written sequentially instead of
+			 * chaining timers, each co_await suspends the coroutine without blocking the thread and
+			 * resumes it later in the scheduler given to the awaiter:
+			 * 
+			 * Task<> LoadLevel(World* world) {
+			 *		Scheduler* background = Scheduler::Get(DXCore::BACKGROUND_THREAD);
+			 *		//Parse the file in a worker and continue in the background thread
+			 *		std::string json = co_await RunJob([]() { return ReadFile("level.json"); }, background);
+			 *		...
+			 *		co_await Delay(background, SEC_TO_NSEC(1));
+			 *		//Wait for other task
+			 *		Texture* t = co_await LoadTexture("sky.dds");
+			 *	}
+			 * 
+			 * A task starts running when it's called until its first suspension. The returned Task can be
+			 * awaited (only once) to get the result, if it's dropped the coroutine finishes alone and frees
+			 * its frame. A suspended task costs its coroutine frame plus the timer or job that resumes it.
+			 * An exception leaving a task terminates the program.
+			 */
+			template<typename T = void>
+			class Task {
+			private:
+				//Promise state, when a coroutine awaits the task it holds the address of its handle
+				static constexpr uintptr_t RUNNING = 0;
+				static constexpr uintptr_t DETACHED = 1;
+				static constexpr uintptr_t DONE = 2;
+
+			public:
+				struct promise_type : public TaskResult<T> {
+					std::atomic<uintptr_t> state{ RUNNING };
+
+					struct FinalAwaiter {
+						bool await_ready() const noexcept { return false; }
+						std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+							uintptr_t s = h.promise().state.exchange(DONE, std::memory_order_acq_rel);
+							if (s == DETACHED) {
+								h.destroy();
+							}
+							else if (s != RUNNING) {
+								//Continue the awaiting coroutine in this thread
+								return std::coroutine_handle<>::from_address((void*)s);
+							}
+							return std::noop_coroutine();
+						}
+						void await_resume() const noexcept {}
+					};
+
+					Task get_return_object() { return Task{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+					std::suspend_never initial_suspend() noexcept { return {}; }
+					FinalAwaiter final_suspend() noexcept { return {}; }
+					void unhandled_exception() noexcept { std::terminate(); }
+				};
+
+			private:
+				std::coroutine_handle<promise_type> handle;
+
+				explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+			public:
+				Task() = default;
+				Task(const Task&) = delete;
+				Task& operator=(const Task&) = delete;
+				Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+				Task& operator=(Task&& other) noexcept {
+					if (this != &other) {
+						Detach();
+						handle = std::exchange(other.handle, {});
+					}
+					return *this;
+				}
+				~Task() { Detach(); }
+
+				//Lets the coroutine finish alone, the frame is freed when it ends
+				void Detach() {
+					if (handle) {
+						if (handle.promise().state.exchange(DETACHED, std::memory_order_acq_rel) == DONE) {
+							handle.destroy();
+						}
+						handle = {};
+					}
+				}
+
+				bool Done() const {
+					return handle && handle.promise().state.load(std::memory_order_acquire) == DONE;
+				}
+
+				//Awaiter interface, the awaiting coroutine is resumed by the thread finishing the task
+				bool await_ready() const noexcept {
+					return Done();
+				}
+
+				bool await_suspend(std::coroutine_handle<> waiter) noexcept {
+					uintptr_t expected = RUNNING;
+					//Fails if the task finished meanwhile, then the waiter doesn't suspend
+					return handle.promise().state.compare_exchange_strong(expected, (uintptr_t)waiter.address(), std::memory_order_acq_rel);
+				}
+
+				T await_resume() {
+					return handle.promise().Take();
+				}
+			};
+
+			//Suspends the coroutine during nsec, it's resumed in the given scheduler
+			class Delay {
+			private:
+				Scheduler* scheduler;
+				int64_t nsec;
+			public:
+				Delay(Scheduler* scheduler, int64_t nsec) : scheduler(scheduler), nsec(nsec) {}
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) {
+					scheduler->RegisterTimer(nsec, [handle](const Scheduler::TimerData&) {
+						handle.resume();
+						return false;
+						}, "Task::Delay");
+				}
+				void await_resume() const noexcept {}
+			};
+
+			//Moves the coroutine to the next update of the given scheduler
+			class NextTick {
+			private:
+				Scheduler* scheduler;
+			public:
+				explicit NextTick(Scheduler* scheduler) : scheduler(scheduler) {}
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) { ResumeOn(scheduler, handle); }
+				void await_resume() const noexcept {}
+			};
+
+			//Runs f in the job system and resumes the coroutine with its result in the given scheduler
+			//(or in the worker if the scheduler is null)
+			template<typename F>
+			class JobAwaiter {
+			private:
+				using R = std::invoke_result_t<F&>;
+				using Storage = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+				F f;
+				Scheduler* scheduler;
+				std::optional<Storage> result;
+
+			public:
+				JobAwaiter(F&& f, Scheduler* scheduler) : f(std::move(f)), scheduler(scheduler) {}
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> handle) {
+					auto job = [this, handle]() {
+						if constexpr (std::is_void_v<R>) {
+							f();
+							result.emplace();
+						}
+						else {
+							result.emplace(f());
+						}
+						ResumeOn(scheduler, handle);
+					};
+					JobSystem* js = JobSystem::Get();
+					if (js != nullptr) {
+						js->Submit(std::move(job));
+					}
+					else {
+						job();
+					}
+				}
+				R await_resume() {
+					if constexpr (!std::is_void_v<R>) {
+						return std::move(*result);
+					}
+				}
+			};
+
+			template<typename F>
+			JobAwaiter<std::decay_t<F>> RunJob(F&& f, Scheduler* scheduler = nullptr) {
+				return JobAwaiter<std::decay_t<F>>(std::decay_t<F>(std::forward<F>(f)), scheduler);
+			}
+
+			/**
+			 * TaskEvent - Manual reset event coroutines can wait for, i.e. to wait for an I/O completion.
+			 * Set can be called from any thread (an OS callback), the waiting coroutines are resumed in the
+			 * scheduler they gave when waiting. Waiters are linked through their awaiters, waiting doesn't allocate.
+			 */
+			class TaskEvent {
+			private:
+				struct Awaiter {
+					TaskEvent* event;
+					Scheduler* scheduler;
+					std::coroutine_handle<> handle;
+					Awaiter* next = nullptr;
+
+					bool await_ready() const noexcept { return event->IsSet(); }
+					bool await_suspend(std::coroutine_handle<> h) noexcept {
+						handle = h;
+						void* old = event->state.load(std::memory_order_acquire);
+						do {
+							if (old == event) {
+								//Set meanwhile, don't suspend
+								return false;
+							}
+							next = static_cast<Awaiter*>(old);
+						} while (!event->state.compare_exchange_weak(old, this, std::memory_order_acq_rel, std::memory_order_acquire));
+						return true;
+					}
+					void await_resume() const noexcept {}
+				};
+
+				//This event when it's set, otherwise the list of waiters
+				std::atomic<void*> state{ nullptr };
+
+			public:
+				TaskEvent() = default;
+				TaskEvent(const TaskEvent&) = delete;
+				TaskEvent& operator=(const TaskEvent&) = delete;
+
+				Awaiter Wait(Scheduler* scheduler = nullptr) {
+					return Awaiter{ this, scheduler };
+				}
+
+				void Set() {
+					void* old = state.exchange(this, std::memory_order_acq_rel);
+					if (old == this) {
+						return;
+					}
+					Awaiter* waiter = static_cast<Awaiter*>(old);
+					while (waiter != nullptr) {
+						//The awaiter lives in the coroutine frame, it can be gone after the resume
+						Awaiter* next = waiter->next;
+						ResumeOn(waiter->scheduler, waiter->handle);
+						waiter = next;
+					}
+				}
+
+				void Reset() {
+					void* expected = this;
+					state.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+				}
+
+				bool IsSet() const {
+					return state.load(std::memory_order_acquire) == this;
+				}
+			};
+		}
+	}
+}
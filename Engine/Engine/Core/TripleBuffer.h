@@ -0,0 +1,85 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Core {
+
+			/**
+			 * TripleBuffer - Wait-free hand off of a value from one producer thread to one consumer thread.
+			 * 
+			 * The producer always owns a buffer to fill and the consumer always owns a buffer to read, the
+			 * third one is exchanged between them with a single atomic operation. Neither side ever waits,
+			 * the producer can publish faster than the consumer reads (older values are dropped) and the
+			 * consumer keeps reading the last value until a new one is published.
+			 * 
+			 * The write buffer keeps the contents of an older publish, the producer must overwrite it fully.
+			 */
+			template<typename T>
+			class TripleBuffer {
+			private:
+				static constexpr uint32_t INDEX_MASK = 0x3;
+				static constexpr uint32_t NEW_FLAG = 0x4;
+
+				T buffers[3] = {};
+				//Index of the exchanged buffer, flagged when it holds a value not read yet
+				alignas(64) std::atomic<uint32_t> shared{ 1 };
+				//Owned by the producer
+				alignas(64) uint32_t write = 0;
+				//Owned by the consumer
+				alignas(64) uint32_t read = 2;
+
+			public:
+				//Producer: buffer to fill before calling Publish
+				T& Write() {
+					return buffers[write];
+				}
+
+				//Producer: makes the write buffer visible to the consumer
+				void Publish() {
+					write = shared.exchange(write | NEW_FLAG, std::memory_order_acq_rel) & INDEX_MASK;
+				}
+
+				//Consumer: takes the last published value, returns false if nothing new was published
+				bool Acquire() {
+					if ((shared.load(std::memory_order_relaxed) & NEW_FLAG) == 0) {
+						return false;
+					}
+					read = shared.exchange(read, std::memory_order_acq_rel) & INDEX_MASK;
+					return true;
+				}
+
+				//Consumer: last acquired value
+				const T& Read() const {
+					return buffers[read];
+				}
+			};
+		}
+	}
+}
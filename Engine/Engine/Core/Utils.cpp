@@ -83,22 +83,7 @@ namespace HotBite {
 			}
 
 			bool Match(const std::string& str, const std::string& pattern) {
-				size_t wildcard_pos = pattern.find("*");
-				if (wildcard_pos != std::string::npos)
-				{
-					bool f1 = true;
-					bool f2 = true;
-					if (wildcard_pos > 1) {
-						f1 = (str.find(pattern.substr(0, wildcard_pos)) != std::string::npos);
-					}
-					if (wildcard_pos < pattern.size() - 1) {
-						f2 = (str.find(pattern.substr(wildcard_pos + 1)) != std::string::npos);
-					}
-					return (f1 && f2);
-				}
-				else {
-					return (str == pattern);
-				}
+				return WildcardPattern(pattern).Match(str);
 			}
 			
 			float4 ColorFromStr(const std::string& color) {
@@ -33,6 +33,7 @@ SOFTWARE.
 #include <atomic>
 #include <string>
 #include <DirectXMath.h>
+#include "NameTable.h"
 
 namespace HotBite {
 	namespace Engine {
@@ -105,7 +106,7 @@ namespace HotBite {
             template <class K, class T>
             class FlatMap {
             private:
-                std::map<K, size_t> indexes;
+                std::map<K, size_t, std::less<>> indexes;
                 std::vector<T> data;
                 
             public:
@@ -145,19 +146,9 @@ namespace HotBite {
                 //Get matched values by string key
                 std::list<T*> GetStrMatch(const std::string& k) {
                     std::list<T*> ret;
-                    if (k.find("*") != std::string::npos) {
-                        for (auto& i : indexes) {
-                            if (Match(i.first, k)) {
-                                ret.push_back(&data[i.second]);
-                            }
-                        }
-                    }
-                    else {
-                        auto it = indexes.find(k);
-                        if (it != indexes.end()) {
-                            ret.push_back(&data[it->second]);
-                        }
-                    }
+                    ForEachMatch(indexes, WildcardPattern(k), [&](const K&, size_t index) {
+                        ret.push_back(&data[index]);
+                    });
                     return ret;
                 }
 
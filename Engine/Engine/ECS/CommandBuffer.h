@@ -0,0 +1,152 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Types.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+			class Coordinator;
+
+			/**
+			 * Records structural changes (entity creation/destruction, component add/remove and
+			 * signature notifications) to be applied later by the Coordinator.
+			 * 
+			 * A command buffer is owned by a single thread, so recording doesn't need any lock.
+			 * Once recorded, the buffer is handed to the coordinator with Coordinator::Submit and
+			 * all submitted buffers are played back in order at the world sync point.
+			 * 
+			 * Entities created by the buffer are not real until playback, CreateEntity returns a
+			 * pending entity that can only be used with commands of the same buffer.
+			 * Existing entities are referenced by their generational handle, commands for an entity
+			 * destroyed before the playback are skipped, even if its id was reused.
+			 * 
+			 * ECS::CommandBuffer cb;
+			 * ECS::EntityHandle e = cb.CreateEntity("bullet");
+			 * cb.AddComponent<Components::Base>(e);
+			 * cb.AddComponent<Components::Transform>(e, { .position = p });
+			 * cb.NotifySignatureChange(e);
+			 * coordinator->Submit(std::move(cb));
+			 */
+			class CommandBuffer {
+			public:
+				enum class eCommand {
+					CREATE_ENTITY,
+					DESTROY_ENTITY,
+					COMPONENT,
+					NOTIFY_SIGNATURE_CHANGE,
+					EXEC
+				};
+
+				struct Command {
+					eCommand type;
+					EntityHandle entity;
+					std::string name;
+					std::function<void(Coordinator*, Entity)> op;
+				};
+
+			private:
+				//Pending entities are encoded as negative ids below INVALID_ENTITY_ID
+				static constexpr Entity PENDING_ENTITY_BASE = INVALID_ENTITY_ID - 1;
+
+				std::vector<Command> commands;
+				int32_t pending_count = 0;
+
+			public:
+				static bool IsPending(const EntityHandle& entity) {
+					return entity.id <= PENDING_ENTITY_BASE;
+				}
+
+				static int32_t PendingIndex(const EntityHandle& entity) {
+					return PENDING_ENTITY_BASE - entity.id;
+				}
+
+				EntityHandle CreateEntity(const std::string& name) {
+					commands.push_back({ eCommand::CREATE_ENTITY, {}, name });
+					return EntityHandle{ PENDING_ENTITY_BASE - pending_count++, 0 };
+				}
+
+				void DestroyEntity(const EntityHandle& entity) {
+					commands.push_back({ eCommand::DESTROY_ENTITY, entity });
+				}
+
+				template<typename T>
+				void AddComponent(const EntityHandle& entity, const T& component) {
+					commands.push_back({ eCommand::COMPONENT, entity, {}, [component](auto* c, Entity e) {
+						c->template AddComponent<T>(e, component);
+					} });
+				}
+
+				template<typename T>
+				void AddComponent(const EntityHandle& entity) {
+					commands.push_back({ eCommand::COMPONENT, entity, {}, [](auto* c, Entity e) {
+						c->template AddComponent<T>(e);
+					} });
+				}
+
+				template<typename T>
+				void RemoveComponent(const EntityHandle& entity) {
+					commands.push_back({ eCommand::COMPONENT, entity, {}, [](auto* c, Entity e) {
+						c->template RemoveComponent<T>(e);
+					} });
+				}
+
+				void NotifySignatureChange(const EntityHandle& entity) {
+					commands.push_back({ eCommand::NOTIFY_SIGNATURE_CHANGE, entity });
+				}
+
+				//Calls f with the real entity during playback, for the setup that needs the entity and its components
+				void Exec(const EntityHandle& entity, std::function<void(Coordinator*, Entity)> f) {
+					commands.push_back({ eCommand::EXEC, entity, {}, std::move(f) });
+				}
+
+				bool Empty() const {
+					return commands.empty();
+				}
+
+				size_t Size() const {
+					return commands.size();
+				}
+
+				int32_t PendingEntityCount() const {
+					return pending_count;
+				}
+
+				const std::vector<Command>& GetCommands() const {
+					return commands;
+				}
+
+				void Clear() {
+					commands.clear();
+					pending_count = 0;
+				}
+			};
+		}
+	}
+}
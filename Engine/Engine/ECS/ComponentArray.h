@@ -24,10 +24,12 @@ SOFTWARE.
 
 #pragma once
 
+#include "PagedVector.h"
+#include "SparseIndex.h"
 #include "Types.h"
-#include <array>
+#include <atomic>
 #include <cassert>
-#include <unordered_map>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -39,83 +41,153 @@ namespace HotBite {
 				virtual Entity EntityDestroyed(Entity entity) = 0;
 			};
 
-
+			/**
+			 * Sparse set storage for components.
+			 * 
+			 * The sparse array maps an entity to the index of its component in the packed arrays, it is
+			 * split in pages that are only allocated when an entity of that range gets a component.
+			 * The dense arrays (entities and components) are always packed so systems can iterate them linearly,
+			 * components are stored in pages so cached pointers to them are not invalidated when the array grows.
+			 * Lookups are just two array accesses, no hashing and no allocations.
+			 * 
+			 * Each component also has a change version, taken from a per array counter when the component
+			 * is added or marked as changed, so systems can process only the components changed since
+			 * the version they saw in their last run.
+			 */
 			template<typename T>
 			class ComponentArray : public IComponentArray
 			{
+			private:
+				SparseIndex sparse;
+				std::vector<Entity> dense_entities;
+				PagedVector<T> component_array;
+				std::vector<uint64_t> versions;
+				std::atomic<uint64_t> version{ 0 };
+
 			public:
 				void InsertData(Entity entity, const T& component)
 				{
-					assert(entity_to_index_map.find(entity) == entity_to_index_map.end() && "Component added to same entity more than once.");
+					assert(entity >= 0 && "Invalid entity.");
+					uint32_t& slot = sparse.Slot(entity);
+					assert(slot == SparseIndex::INVALID_INDEX && "Component added to same entity more than once.");
 					// Put new entry at end
-					size_t new_index = component_array.size();
-					entity_to_index_map[entity] = new_index;
-					index_to_entity_map[new_index] = entity;
+					slot = (uint32_t)component_array.size();
+					dense_entities.push_back(entity);
 					component_array.push_back(component);
+					versions.push_back(++version);
 				}
 
-				std::vector<T>& Array() {
+				PagedVector<T>& Array() {
 					return component_array;
 				}
 
+				const std::vector<Entity>& Entities() const {
+					return dense_entities;
+				}
+
 				void EmplaceData(Entity entity, T&& component)
 				{
-					assert(entity_to_index_map.find(entity) == entity_to_index_map.end() && "Component added to same entity more than once.");
+					assert(entity >= 0 && "Invalid entity.");
+					uint32_t& slot = sparse.Slot(entity);
+					assert(slot == SparseIndex::INVALID_INDEX && "Component added to same entity more than once.");
 					// Put new entry at end
-					size_t new_index = component_array.size();
-					entity_to_index_map[entity] = new_index;
-					index_to_entity_map[new_index] = entity;
+					slot = (uint32_t)component_array.size();
+					dense_entities.push_back(entity);
 					component_array.emplace_back(std::forward<T>(component));
+					versions.push_back(++version);
 				}
 
 				Entity RemoveData(Entity entity)
 				{
-					assert(entity_to_index_map.find(entity) != entity_to_index_map.end() && "Removing non-existent component.");
-					// Copy element at end into deleted element's place to maintain density
-					size_t size = component_array.size();
-					size_t index_of_removed_entity = entity_to_index_map[entity];
-					size_t index_of_last_element = size - 1;
-					component_array[index_of_removed_entity] = component_array[index_of_last_element];
-
-					// Update map to point to moved spot
-					Entity entity_of_last_element = index_to_entity_map[index_of_last_element];
-					entity_to_index_map[entity_of_last_element] = index_of_removed_entity;
-					index_to_entity_map[index_of_removed_entity] = entity_of_last_element;
-
-					entity_to_index_map.erase(entity);
-					index_to_entity_map.erase(index_of_last_element);
+					uint32_t index_of_removed_entity = sparse.Get(entity);
+					assert(index_of_removed_entity != SparseIndex::INVALID_INDEX && "Removing non-existent component.");
+					// Move element at end into deleted element's place to maintain density
+					uint32_t index_of_last_element = (uint32_t)component_array.size() - 1;
+					Entity entity_of_last_element = dense_entities[index_of_last_element];
+					if (index_of_removed_entity != index_of_last_element) {
+						component_array[index_of_removed_entity] = std::move(component_array[index_of_last_element]);
+						dense_entities[index_of_removed_entity] = entity_of_last_element;
+						versions[index_of_removed_entity] = versions[index_of_last_element];
+						sparse.Set(entity_of_last_element, index_of_removed_entity);
+					}
+					sparse.Set(entity, SparseIndex::INVALID_INDEX);
+					dense_entities.pop_back();
 					component_array.pop_back();
+					versions.pop_back();
+					++version;
 					//return modified entity so
 					//references to the component stored in the game can be updated
 					return entity_of_last_element;
 				}
 
-				bool Contains(Entity entity) {
-					return (entity_to_index_map.find(entity) != entity_to_index_map.end());
+				bool Contains(Entity entity) const {
+					return sparse.Contains(entity);
 				}
 
 				const T& GetConstData(Entity entity) const
 				{
-					auto it = entity_to_index_map.find(entity);
-					if (it == entity_to_index_map.end()) {
+					uint32_t index = sparse.Get(entity);
+					if (index == SparseIndex::INVALID_INDEX) {
 						throw "Retrieving non-existent component.";
 					}
-					return component_array.at(it->second);
+					return component_array[index];
 				}
 
 				T& GetData(Entity entity)
 				{
-					auto it = entity_to_index_map.find(entity);
-					if (it == entity_to_index_map.end()) {
+					uint32_t index = sparse.Get(entity);
+					if (index == SparseIndex::INVALID_INDEX) {
 						throw "Retrieving non-existent component.";
 					}
-					return component_array[it->second];
+					return component_array[index];
+				}
+
+				T* TryGetData(Entity entity)
+				{
+					uint32_t index = sparse.Get(entity);
+					return (index != SparseIndex::INVALID_INDEX) ? &component_array[index] : nullptr;
+				}
+
+				//Gives a new version to the component of the entity, call it after writing the component
+				void MarkChanged(Entity entity)
+				{
+					uint32_t index = sparse.Get(entity);
+					if (index != SparseIndex::INVALID_INDEX) {
+						versions[index] = ++version;
+					}
+				}
+
+				//Version of the last change in the array (components added, removed or changed)
+				uint64_t GetVersion() const
+				{
+					return version.load(std::memory_order_relaxed);
+				}
+
+				//Version of the component of the entity, 0 if the entity has no component
+				uint64_t GetVersion(Entity entity) const
+				{
+					uint32_t index = sparse.Get(entity);
+					return (index != SparseIndex::INVALID_INDEX) ? versions[index] : 0;
+				}
+
+				//Calls f(entity, component) for the components changed after version since
+				template<typename F>
+				void ForEachChanged(uint64_t since, F&& f)
+				{
+					if (GetVersion() <= since) {
+						return;
+					}
+					for (size_t i = 0; i < versions.size(); ++i) {
+						if (versions[i] > since) {
+							f(dense_entities[i], component_array[i]);
+						}
+					}
 				}
 
 				Entity EntityDestroyed(Entity entity) override
 				{
 					Entity e = ECS::INVALID_ENTITY_ID;
-					if (entity_to_index_map.find(entity) != entity_to_index_map.end())
+					if (Contains(entity))
 					{
 						e = RemoveData(entity);
 					}
@@ -123,13 +195,7 @@ namespace HotBite {
 					return e;
 				}
 
-				ComponentArray() {
-					component_array.reserve(MAX_ENTITIES);
-				}
-			private:
-				std::vector<T> component_array;
-				std::unordered_map<Entity, size_t> entity_to_index_map;
-				std::unordered_map<size_t, Entity> index_to_entity_map;
+				ComponentArray() = default;
 			};
 		}
 	}
@@ -0,0 +1,166 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Types.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			/**
+			 * Reader/writer locks per component type.
+			 *
+			 * Task graph tasks lock the components they declare: reads shared and writes exclusive. TryLock
+			 * takes all of them or none and never blocks, a task that can't get its components is retried
+			 * later, so a thread waiting for jobs inside a task never blocks on a lock it already owns.
+			 * LockAll takes every component exclusively for the code that can touch any component (game
+			 * code, events, structural changes), it blocks the new TryLock calls until it gets them all.
+			 */
+			class ComponentLocks {
+			private:
+				static constexpr int32_t WRITER = -1;
+				//Number of readers or WRITER
+				std::atomic<int32_t> state[MAX_COMPONENTS] = {};
+				std::atomic<int32_t> waiting_all{ 0 };
+
+				bool TryLockRead(int32_t c) {
+					int32_t s = state[c].load(std::memory_order_relaxed);
+					while (s != WRITER) {
+						if (state[c].compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+							return true;
+						}
+					}
+					return false;
+				}
+
+				bool TryLockWrite(int32_t c) {
+					int32_t s = 0;
+					return state[c].compare_exchange_strong(s, WRITER, std::memory_order_acquire);
+				}
+
+			public:
+				bool TryLock(const Signature& reads, const Signature& writes) {
+					if (waiting_all.load(std::memory_order_acquire) > 0) {
+						return false;
+					}
+					Signature only_reads = reads & ~writes;
+					for (int32_t c = 0; c < MAX_COMPONENTS; ++c) {
+						bool locked = true;
+						if (writes.test(c)) {
+							locked = TryLockWrite(c);
+						}
+						else if (only_reads.test(c)) {
+							locked = TryLockRead(c);
+						}
+						if (!locked) {
+							//Release the components taken so far
+							Signature taken_writes = writes;
+							Signature taken_reads = only_reads;
+							for (int32_t i = c; i < MAX_COMPONENTS; ++i) {
+								taken_writes.reset(i);
+								taken_reads.reset(i);
+							}
+							Unlock(taken_reads, taken_writes);
+							return false;
+						}
+					}
+					return true;
+				}
+
+				void Unlock(const Signature& reads, const Signature& writes) {
+					Signature only_reads = reads & ~writes;
+					for (int32_t c = 0; c < MAX_COMPONENTS; ++c) {
+						if (writes.test(c)) {
+							state[c].store(0, std::memory_order_release);
+						}
+						else if (only_reads.test(c)) {
+							state[c].fetch_sub(1, std::memory_order_release);
+						}
+					}
+				}
+
+				//Only one thread at a time, see WorldMutex
+				void LockAll() {
+					waiting_all.fetch_add(1, std::memory_order_acq_rel);
+					for (int32_t c = 0; c < MAX_COMPONENTS; ++c) {
+						while (!TryLockWrite(c)) {
+							std::this_thread::yield();
+						}
+					}
+					waiting_all.fetch_sub(1, std::memory_order_release);
+				}
+
+				void UnlockAll() {
+					for (int32_t c = 0; c < MAX_COMPONENTS; ++c) {
+						state[c].store(0, std::memory_order_release);
+					}
+				}
+			};
+
+			/**
+			 * Recursive mutex that also locks all the components, so the code holding it excludes the task
+			 * graph tasks running with their own component locks.
+			 */
+			class WorldMutex {
+			private:
+				std::recursive_mutex mutex;
+				int32_t depth = 0;
+				ComponentLocks components;
+
+			public:
+				void lock() {
+					mutex.lock();
+					if (depth++ == 0) {
+						components.LockAll();
+					}
+				}
+
+				bool try_lock() {
+					if (!mutex.try_lock()) {
+						return false;
+					}
+					if (depth++ == 0) {
+						components.LockAll();
+					}
+					return true;
+				}
+
+				void unlock() {
+					if (--depth == 0) {
+						components.UnlockAll();
+					}
+					mutex.unlock();
+				}
+
+				ComponentLocks& GetComponentLocks() { return components; }
+			};
+		}
+	}
+}
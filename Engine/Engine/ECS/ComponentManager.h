@@ -26,10 +26,9 @@ SOFTWARE.
 
 #include "ComponentArray.h"
 #include "Types.h"
-#include <any>
 #include <memory>
-#include <unordered_map>
 #include <set>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -40,19 +39,25 @@ namespace HotBite {
 				template<typename T>
 				void RegisterComponent()
 				{
-					const char* typeName = typeid(T).name();
-					assert(component_types.find(typeName) == component_types.end() && "Registering component type more than once.");
-					component_types.insert({ typeName, next_component_type });
-					component_arrays.insert({ typeName, std::make_shared<ComponentArray<T>>() });
+					uint32_t index = TypeIndex<ComponentManager>::Get<T>();
+					if (index >= component_arrays.size()) {
+						component_arrays.resize(index + 1);
+						component_types.resize(index + 1);
+					}
+					assert(component_arrays[index] == nullptr && "Registering component type more than once.");
+					assert(next_component_type < MAX_COMPONENTS && "Too many component types.");
+					component_types[index] = next_component_type;
+					component_arrays[index] = std::make_shared<ComponentArray<T>>();
+					registered_arrays.push_back(component_arrays[index].get());
 					++next_component_type;
 				}
 
 				template<typename T>
-				ComponentType GetComponentType()
+				ComponentType GetComponentType() const
 				{
-					const char* typeName = typeid(T).name();
-					assert(component_types.find(typeName) != component_types.end() && "Component not registered before use.");
-					return component_types[typeName];
+					uint32_t index = TypeIndex<ComponentManager>::Get<T>();
+					assert(index < component_arrays.size() && component_arrays[index] != nullptr && "Component not registered before use.");
+					return component_types[index];
 				}
 
 				template<typename T>
@@ -94,15 +99,25 @@ namespace HotBite {
 				template<typename T>
 				std::shared_ptr<ComponentArray<T>> GetComponents()
 				{
-					return GetComponentArray<T>();
+					uint32_t index = TypeIndex<ComponentManager>::Get<T>();
+					assert(index < component_arrays.size() && component_arrays[index] != nullptr && "Component not registered before use.");
+					return std::static_pointer_cast<ComponentArray<T>>(component_arrays[index]);
+				}
+
+				//Direct access to the component array, no reference counting involved
+				template<typename T>
+				ComponentArray<T>* GetComponentArray()
+				{
+					uint32_t index = TypeIndex<ComponentManager>::Get<T>();
+					assert(index < component_arrays.size() && component_arrays[index] != nullptr && "Component not registered before use.");
+					return static_cast<ComponentArray<T>*>(component_arrays[index].get());
 				}
 
 				std::set<Entity> EntityDestroyed(Entity entity)
 				{
 					std::set<Entity> modified_entities;
-					for (auto const& pair : component_arrays)
+					for (IComponentArray* component : registered_arrays)
 					{
-						auto const& component = pair.second;
 						Entity e = component->EntityDestroyed(entity);
 						if (e != ECS::INVALID_ENTITY_ID) {
 							modified_entities.insert(e);
@@ -112,24 +127,19 @@ namespace HotBite {
 				}
 
 			private:
-				std::unordered_map<const char*, ComponentType> component_types;
-				std::unordered_map<const char*, std::shared_ptr<IComponentArray>> component_arrays;
-				ComponentType next_component_type;
-
-				template<typename T>
-				const std::shared_ptr<ComponentArray<T>> GetConstComponentArray() const
-				{
-					const char* typeName = typeid(T).name();
-					assert(component_types.find(typeName) != component_types.end() && "Component not registered before use.");
-					return std::static_pointer_cast<ComponentArray<T>>(component_arrays.at(typeName));
-				}
+				//Indexed by TypeIndex<ComponentManager>
+				std::vector<ComponentType> component_types;
+				std::vector<std::shared_ptr<IComponentArray>> component_arrays;
+				//Registered arrays in registration order
+				std::vector<IComponentArray*> registered_arrays;
+				ComponentType next_component_type{};
 
 				template<typename T>
-				::std::shared_ptr<ComponentArray<T>> GetComponentArray()
+				const ComponentArray<T>* GetConstComponentArray() const
 				{
-					const char* typeName = typeid(T).name();
-					assert(component_types.find(typeName) != component_types.end() && "Component not registered before use.");
-					return std::static_pointer_cast<ComponentArray<T>>(component_arrays[typeName]);
+					uint32_t index = TypeIndex<ComponentManager>::Get<T>();
+					assert(index < component_arrays.size() && component_arrays[index] != nullptr && "Component not registered before use.");
+					return static_cast<const ComponentArray<T>*>(component_arrays[index].get());
 				}
 			};
 		}
@@ -0,0 +1,97 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "ComponentArray.h"
+#include "Types.h"
+#include <tuple>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			/**
+			 * View over all the entities that have every component in Ts.
+			 * 
+			 * The iteration is driven by the packed entity list of the smallest component array,
+			 * so only candidate entities are visited and memory of the driving array is read linearly,
+			 * the rest of components are fetched with a sparse lookup (no hashing).
+			 * Entities are visited from last to first, so it's safe to remove components of the
+			 * current entity from inside the callback (the swapped entity was already visited).
+			 * 
+			 * Usage:
+			 * 
+			 * coordinator->ForEach<Transform, Bounds, Physics>([](Entity e, Transform& t, Bounds& b, Physics& p) {
+			 *     ...
+			 * });
+			 */
+			template<typename... Ts>
+			class ComponentView {
+			private:
+				std::tuple<ComponentArray<Ts>*...> arrays;
+				const std::vector<Entity>* driver = nullptr;
+
+			public:
+				ComponentView(ComponentArray<Ts>*... a) : arrays(a...) {
+					size_t min_size = SIZE_MAX;
+					((a->Entities().size() < min_size ? (min_size = a->Entities().size(), driver = &a->Entities()) : driver), ...);
+				}
+
+				//Upper bound of the entities visited by this view
+				size_t SizeHint() const {
+					return driver->size();
+				}
+
+				bool Contains(Entity entity) const {
+					return (std::get<ComponentArray<Ts>*>(arrays)->Contains(entity) && ...);
+				}
+
+				template<typename F>
+				void ForEach(F&& f) {
+					for (size_t i = driver->size(); i-- > 0;) {
+						Entity entity = (*driver)[i];
+						std::tuple<Ts*...> components{ std::get<ComponentArray<Ts>*>(arrays)->TryGetData(entity)... };
+						if (((std::get<Ts*>(components) != nullptr) && ...)) {
+							f(entity, *std::get<Ts*>(components)...);
+						}
+					}
+				}
+
+				//Collects the matching entities, useful to split the work between threads
+				std::vector<Entity> Entities() const {
+					std::vector<Entity> ret;
+					ret.reserve(driver->size());
+					for (Entity entity : *driver) {
+						if (Contains(entity)) {
+							ret.push_back(entity);
+						}
+					}
+					return ret;
+				}
+			};
+		}
+	}
+}
@@ -24,12 +24,17 @@ SOFTWARE.
 
 #pragma once
 
+#include "CommandBuffer.h"
 #include "ComponentManager.h"
+#include "ComponentView.h"
 #include "EntityManager.h"
 #include "EventManager.h"
 #include "SystemManager.h"
 #include "Types.h"
+#include <Core/SpinLock.h>
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -78,7 +83,7 @@ namespace HotBite {
 						//We need to refresh all the entities that 
 						//are internally moved from one index to another
 						//so the systems can refresh cached references to the components
-						system_manager->EntitySignatureChanged(e, entity_manager->GetSignature(e));
+						RefreshEntity(e);
 					}
 					event_manager->SendEvent(this, entity, EVENT_ID_ENTITY_REMOVED);
 				}
@@ -91,11 +96,32 @@ namespace HotBite {
 					return entity_manager->GetEntitiesByName(name);
 				}
 
-				const std::unordered_map<std::string, Entity>& GetEntites() const {
+				const std::string& GetEntityName(Entity e) const {
+					return entity_manager->GetEntityName(e);
+				}
+
+				const Core::WildcardIndex<Entity>::Map& GetEntites() const {
 					return entity_manager->GetEntities();
 				}
 
 
+				EntityHandle GetEntityHandle(Entity e) const {
+					return entity_manager->GetHandle(e);
+				}
+
+				bool IsEntityAlive(const EntityHandle& h) const {
+					return entity_manager->IsAlive(h);
+				}
+
+				//Returns the entity of the handle or INVALID_ENTITY_ID if the handle is stale
+				Entity GetEntity(const EntityHandle& h) const {
+					return entity_manager->IsAlive(h) ? h.id : INVALID_ENTITY_ID;
+				}
+
+				uint32_t GetLivingEntityCount() const {
+					return entity_manager->GetLivingEntityCount();
+				}
+
 				Signature GetEntitySignature(Entity e) {
 					return entity_manager->GetSignature(e);
 				}
@@ -146,11 +172,49 @@ namespace HotBite {
 				}
 
 				void NotifySignatureChange(Entity entity) {
+					if (batch_depth > 0) {
+						batched_notifications.push_back(entity);
+						return;
+					}
 					auto signature = entity_manager->GetSignature(entity);
 					system_manager->EntitySignatureChanged(entity, signature);
 					event_manager->SendEvent(this, entity, EVENT_ID_ENTITY_CHANGED);
 				}
 
+				/**
+				 * Notification batches: while a batch is open, signature notifications are
+				 * collected and sent once per entity when the last batch is closed.
+				 * Systems are not refreshed until then, so no system must be updated inside a batch (i.e. level loading).
+				 */
+				void BeginNotificationBatch() {
+					++batch_depth;
+				}
+
+				void EndNotificationBatch() {
+					assert(batch_depth > 0 && "No notification batch open.");
+					if (--batch_depth > 0) {
+						return;
+					}
+					std::vector<Entity> notifications;
+					std::vector<Entity> refreshes;
+					notifications.swap(batched_notifications);
+					refreshes.swap(batched_refreshes);
+					std::sort(notifications.begin(), notifications.end());
+					notifications.erase(std::unique(notifications.begin(), notifications.end()), notifications.end());
+					std::sort(refreshes.begin(), refreshes.end());
+					refreshes.erase(std::unique(refreshes.begin(), refreshes.end()), refreshes.end());
+					for (Entity e : refreshes) {
+						if (entity_manager->Exists(e) && !std::binary_search(notifications.begin(), notifications.end(), e)) {
+							system_manager->EntitySignatureChanged(e, entity_manager->GetSignature(e));
+						}
+					}
+					for (Entity e : notifications) {
+						if (entity_manager->Exists(e)) {
+							NotifySignatureChange(e);
+						}
+					}
+				}
+
 				template<typename T>
 				void RemoveComponent(Entity entity)
 				{
@@ -158,12 +222,12 @@ namespace HotBite {
 					//We need to refresh all the entities that 
 					//are internally moved from one index to another
 					//so the systems can refresh cached references to the components
-					system_manager->EntitySignatureChanged(e, entity_manager->GetSignature(e));
+					RefreshEntity(e);
 
 					auto signature = entity_manager->GetSignature(entity);
 					signature.set(component_manager->GetComponentType<T>(), false);
 					entity_manager->SetSignature(entity, signature);
-					system_manager->EntitySignatureChanged(entity, signature);
+					RefreshEntity(entity);
 
 				}
 
@@ -173,6 +237,69 @@ namespace HotBite {
 					return component_manager->ContainsComponent<T>(entity);
 				}
 
+				// Deferred commands
+				void Submit(CommandBuffer&& cb)
+				{
+					if (!cb.Empty()) {
+						Core::AutoLock l(submit_lock);
+						submitted_commands.emplace_back(std::move(cb));
+					}
+				}
+
+				//Applies all the submitted command buffers in submission order.
+				//Must be called from the sync point, where no other thread is accessing the ECS.
+				void PlaybackCommands()
+				{
+					std::vector<CommandBuffer> buffers;
+					{
+						Core::AutoLock l(submit_lock);
+						buffers.swap(submitted_commands);
+					}
+					BeginNotificationBatch();
+					for (const CommandBuffer& cb : buffers) {
+						Playback(cb);
+					}
+					EndNotificationBatch();
+				}
+
+				void Playback(const CommandBuffer& cb)
+				{
+					std::vector<EntityHandle> created;
+					created.reserve(cb.PendingEntityCount());
+					auto resolve = [&created](const EntityHandle& h) {
+						if (CommandBuffer::IsPending(h)) {
+							assert(CommandBuffer::PendingIndex(h) < (int32_t)created.size() && "Unknown pending entity.");
+							return created[CommandBuffer::PendingIndex(h)];
+						}
+						return h;
+					};
+					for (const CommandBuffer::Command& cmd : cb.GetCommands()) {
+						if (cmd.type == CommandBuffer::eCommand::CREATE_ENTITY) {
+							created.push_back(GetEntityHandle(CreateEntity(cmd.name)));
+							continue;
+						}
+						//The entity was destroyed after recording the command, its id may belong to a new entity
+						EntityHandle h = resolve(cmd.entity);
+						if (!IsEntityAlive(h)) {
+							continue;
+						}
+						switch (cmd.type) {
+						case CommandBuffer::eCommand::DESTROY_ENTITY:
+							DestroyEntity(h.id);
+							break;
+						case CommandBuffer::eCommand::COMPONENT:
+						case CommandBuffer::eCommand::EXEC:
+							cmd.op(this, h.id);
+							break;
+						case CommandBuffer::eCommand::NOTIFY_SIGNATURE_CHANGE:
+							NotifySignatureChange(h.id);
+							break;
+						default:
+							break;
+						}
+					}
+				}
+
 				template<typename T>
 				const T& GetConstComponent(Entity entity) const 
 				{
@@ -197,18 +324,67 @@ namespace HotBite {
 					return component_manager->GetComponents<T>();
 				}
 
+				//Marks the component of the entity as changed, systems reading the component versions will process it
+				template<typename T>
+				void MarkComponentChanged(Entity entity)
+				{
+					component_manager->GetComponentArray<T>()->MarkChanged(entity);
+				}
+
+				template<typename T>
+				uint64_t GetComponentVersion(Entity entity)
+				{
+					return component_manager->GetComponentArray<T>()->GetVersion(entity);
+				}
+
+				//Version of the last change of any component of type T
+				template<typename T>
+				uint64_t GetComponentsVersion()
+				{
+					return component_manager->GetComponentArray<T>()->GetVersion();
+				}
+
+				//Calls f(entity, component) for the components of type T changed after version since
+				template<typename T, typename F>
+				void ForEachChanged(uint64_t since, F&& f)
+				{
+					component_manager->GetComponentArray<T>()->ForEachChanged(since, std::forward<F>(f));
+				}
+
+				template<typename... Ts>
+				ComponentView<Ts...> View()
+				{
+					return ComponentView<Ts...>(component_manager->GetComponentArray<Ts>()...);
+				}
+
+				template<typename... Ts, typename F>
+				void ForEach(F&& f)
+				{
+					View<Ts...>().ForEach(std::forward<F>(f));
+				}
+
 				template<typename T>
 				ComponentType GetComponentType()
 				{
 					return component_manager->GetComponentType<T>();
 				}
 
+				//Signature with the bits of all the given component types set
+				template<typename... Ts>
+				Signature MakeSignature()
+				{
+					Signature signature;
+					(signature.set(component_manager->GetComponentType<Ts>(), true), ...);
+					return signature;
+				}
+
 				// System methods
 				template<typename T>
 				std::shared_ptr<T> RegisterSystem()
 				{
 					std::shared_ptr<T> system = system_manager->RegisterSystem<T>();
 					system->OnRegister(this);
+					system_manager->UpdateSystemRoutes(system.get());
 					return system;
 				}
 				template<typename T>
@@ -217,6 +393,12 @@ namespace HotBite {
 					return system_manager->GetSystem<T>();
 				}
 
+				template<typename T>
+				T* GetSystemPtr()
+				{
+					return system_manager->GetSystemPtr<T>();
+				}
+
 				// Event methods
 				EventListenerId AddEventListener(EventId eventId, std::function<void(Event&)> const&& listener)
 				{
@@ -248,11 +430,58 @@ namespace HotBite {
 					event_manager->SendEvent(sender, entity, type);
 				}
 
+				// Typed event methods
+				template<TypedEvent E>
+				EventListenerId AddEventListener(std::function<void(const E&)>&& listener)
+				{
+					return event_manager->AddListener<E>(INVALID_ENTITY_ID, std::move(listener));
+				}
+
+				template<TypedEvent E>
+				EventListenerId AddEventListenerByEntity(Entity e, std::function<void(const E&)>&& listener)
+				{
+					return event_manager->AddListener<E>(e, std::move(listener));
+				}
+
+				//Sends the event to the listeners immediately in the calling thread
+				template<TypedEvent E>
+				void SendEvent(const E& event)
+				{
+					event_manager->SendEvent(event);
+				}
+
+				//Queues the event to be sent in the next FlushEvents, can be called from any thread
+				template<TypedEvent E>
+				void PostEvent(const E& event)
+				{
+					event_manager->PostEvent(event);
+				}
+
+				void FlushEvents()
+				{
+					event_manager->FlushEvents();
+				}
+
 			private:
 				std::unique_ptr<ComponentManager> component_manager;
 				std::unique_ptr<EntityManager> entity_manager;
 				std::unique_ptr<EventManager> event_manager;
 				std::unique_ptr<SystemManager> system_manager;
+				Core::spin_lock submit_lock;
+				std::vector<CommandBuffer> submitted_commands;
+				int32_t batch_depth = 0;
+				std::vector<Entity> batched_notifications;
+				std::vector<Entity> batched_refreshes;
+
+				//Notifies the systems without sending the entity changed event
+				void RefreshEntity(Entity e) {
+					if (batch_depth > 0) {
+						batched_refreshes.push_back(e);
+					}
+					else {
+						system_manager->EntitySignatureChanged(e, entity_manager->GetSignature(e));
+					}
+				}
 			};
 
 			class EventListener {
@@ -295,6 +524,22 @@ namespace HotBite {
 					ev_list_ids.push_back(id);
 					return id;
 				}
+
+				template<TypedEvent E>
+				EventListenerId AddEventListener(std::function<void(const E&)>&& listener)
+				{
+					EventListenerId id = event_coordinator->AddEventListener<E>(std::move(listener));
+					ev_list_ids.push_back(id);
+					return id;
+				}
+
+				template<TypedEvent E>
+				EventListenerId AddEventListenerByEntity(Entity e, std::function<void(const E&)>&& listener)
+				{
+					EventListenerId id = event_coordinator->AddEventListenerByEntity<E>(e, std::move(listener));
+					ev_list_ids.push_back(id);
+					return id;
+				}
 			};
 		}
 	}
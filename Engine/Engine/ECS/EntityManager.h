@@ -25,10 +25,12 @@ SOFTWARE.
 #pragma once
 
 #include "Types.h"
-#include <Core/Utils.h>
-#include <array>
+#include <Core/NameTable.h>
 #include <cassert>
+#include <list>
 #include <queue>
+#include <string>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -36,100 +38,132 @@ namespace HotBite {
 			class EntityManager
 			{
 			public:
-				EntityManager()
-				{
-					for (Entity entity = 0; entity < MAX_ENTITIES; ++entity)
-					{
-						available_entities.push(entity);
-					}
-				}
+				EntityManager() = default;
 
 				Entity CreateEntity(const std::string& name)
 				{
-					assert(living_entity_count < MAX_ENTITIES && "Too many entities in existence.");
-					Entity id = available_entities.front();
-					available_entities.pop();
+					Entity id;
+					if (!available_entities.empty()) {
+						id = available_entities.front();
+						available_entities.pop();
+					}
+					else {
+						assert(next_entity < INT32_MAX && "Too many entities in existence.");
+						id = next_entity++;
+						if ((size_t)id >= signatures.size()) {
+							//Grow entity storage by pages
+							signatures.resize(signatures.size() + ENTITY_PAGE_SIZE);
+							versions.resize(versions.size() + ENTITY_PAGE_SIZE);
+							name_by_entity.resize(name_by_entity.size() + ENTITY_PAGE_SIZE, Core::INVALID_NAME_ID);
+						}
+					}
 					++living_entity_count;
-					assert(entity_by_name.find(name) == entity_by_name.end() && "Entity already exists.");
-					entity_by_name[name] = id;
-					name_by_entity[id] = name;
+					assert(entity_by_name.Find(name) == nullptr && "Entity already exists.");
+					uint32_t name_id = names.Intern(name);
+					name_by_entity[id] = name_id;
+					entity_by_name.Insert(names.Get(name_id), id);
 					return id;
 				}
 
 				void ChangeEntityName(const std::string& old_name, const std::string& new_name) {
-					auto it0 = entity_by_name.find(old_name);
-					if (it0 != entity_by_name.end()) {
-						auto it1 = name_by_entity.find(it0->second);
-						assert(it1 != name_by_entity.end());
-						it1->second = new_name;
-						assert(entity_by_name.find(new_name) == entity_by_name.end() && "Name already exists.");
-						entity_by_name[new_name] = it0->second;
-						entity_by_name.erase(it0);
+					const Entity* e = entity_by_name.Find(old_name);
+					if (e != nullptr) {
+						Entity id = *e;
+						assert(entity_by_name.Find(new_name) == nullptr && "Name already exists.");
+						entity_by_name.Remove(old_name);
+						names.Release(name_by_entity[id]);
+						uint32_t name_id = names.Intern(new_name);
+						name_by_entity[id] = name_id;
+						entity_by_name.Insert(names.Get(name_id), id);
 					}
 				}
 
 				Entity GetEntityByName(const std::string& name) const
 				{
-					Entity id = INVALID_ENTITY_ID;
-					auto it = entity_by_name.find(name);
-					if (it != entity_by_name.end()) {
-						id = it->second;
-					}
-					return id;
+					const Entity* e = entity_by_name.Find(name);
+					return (e != nullptr) ? *e : INVALID_ENTITY_ID;
+				}
+
+				const std::string& GetEntityName(Entity entity) const
+				{
+					assert(Exists(entity) && "Unknown entity.");
+					return names.Get(name_by_entity[entity]);
 				}
 
+				//Name can be a wildcard pattern ("prefix*", "*suffix" or "prefix*suffix")
 				std::list<Entity> GetEntitiesByName(const std::string& name) const
 				{
 					std::list<Entity> ret;
-					if (name.find("*") == std::string::npos) {
-						Entity e = GetEntityByName(name);
-						if (e != INVALID_ENTITY_ID) {
-							ret.push_back(e);
-						}
-					}
-					else {
-						for (auto& e : entity_by_name) {
-							if (Core::Match(e.first, name)) {
-								ret.push_back(e.second);
-							}
-						}
-					}
+					entity_by_name.Match(name, [&ret](Entity e) { ret.push_back(e); });
 					return ret;
 				}
 
-				const std::unordered_map<std::string, Entity>& GetEntities() const {
-					return entity_by_name;
+				const Core::WildcardIndex<Entity>::Map& GetEntities() const {
+					return entity_by_name.GetData();
 				}
 
 				void DestroyEntity(Entity entity)
 				{
-					assert(entity < MAX_ENTITIES && "Entity out of range.");
+					assert(entity >= 0 && entity < next_entity && "Entity out of range.");
 					signatures[entity].reset();
+					//Invalidate all the handles of this entity
+					++versions[entity];
 					available_entities.push(entity);
 					--living_entity_count;
-					auto it = name_by_entity.find(entity);
-					assert(it != name_by_entity.end() && "Unknown entity.");
-					entity_by_name.erase(entity_by_name.find(it->second));
-					name_by_entity.erase(it);
+					uint32_t name_id = name_by_entity[entity];
+					assert(name_id != Core::INVALID_NAME_ID && "Unknown entity.");
+					entity_by_name.Remove(names.Get(name_id));
+					names.Release(name_id);
+					name_by_entity[entity] = Core::INVALID_NAME_ID;
 				}
 
 				void SetSignature(Entity entity, Signature signature)
 				{
-					assert(entity < MAX_ENTITIES && "Entity out of range.");
+					assert(entity >= 0 && entity < next_entity && "Entity out of range.");
 					signatures[entity] = signature;
 				}
 
 				Signature GetSignature(Entity entity)
 				{
-					assert(entity < MAX_ENTITIES && "Entity out of range.");
+					assert(entity >= 0 && entity < next_entity && "Entity out of range.");
 					return signatures[entity];
 				}
 
+				bool Exists(Entity entity) const
+				{
+					return entity >= 0 && entity < next_entity && name_by_entity[entity] != Core::INVALID_NAME_ID;
+				}
+
+				EntityHandle GetHandle(Entity entity) const
+				{
+					EntityHandle h;
+					if (entity >= 0 && entity < next_entity) {
+						h.id = entity;
+						h.version = versions[entity];
+					}
+					return h;
+				}
+
+				//Returns false if the entity of the handle has been destroyed (even if the id has been reused)
+				bool IsAlive(const EntityHandle& handle) const
+				{
+					return handle.id >= 0 && handle.id < next_entity && versions[handle.id] == handle.version;
+				}
+
+				uint32_t GetLivingEntityCount() const
+				{
+					return living_entity_count;
+				}
+
 			private:
-				std::unordered_map<std::string, Entity> entity_by_name;
-				std::unordered_map<Entity, std::string> name_by_entity;
+				//Entity names are interned, entities only keep the name id
+				Core::NameTable names;
+				Core::WildcardIndex<Entity> entity_by_name;
+				std::vector<uint32_t> name_by_entity;
 				std::queue<Entity> available_entities;
-				std::array<Signature, MAX_ENTITIES> signatures;
+				std::vector<Signature> signatures;
+				std::vector<uint32_t> versions;
+				Entity next_entity = 0;
 				uint32_t living_entity_count{};
 			};
 		}
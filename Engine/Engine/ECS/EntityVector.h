@@ -24,102 +24,147 @@ SOFTWARE.
 
 #pragma once
 
+#include "SparseIndex.h"
 #include "Types.h"
-#include <map>
+#include <cassert>
+#include <memory>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 namespace HotBite {
     namespace Engine {
         namespace ECS {
-            template <class T> class EntityVector {
+            /**
+             * Packed vector of per entity data.
+             * 
+             * Entity lookups go through a sparse index and removals swap the last element
+             * into the hole, so Get, Insert and Remove are O(1) and the data is always packed.
+             * RESERVED_ENTITIES entries are reserved up front, so inserting doesn't move the data
+             * until that capacity is exceeded, but a removal moves the last entry into the hole.
+             * With STABLE = true every entry is heap allocated and only the pointers are packed,
+             * so pointers to entries are valid until the entity is removed, use it when other
+             * structures keep pointers to the entries (i.e. physics bodies).
+             */
+            template <class T, bool STABLE = false> class EntityVector {
             private:
-                std::map<Entity, size_t> indexes;
-                std::vector<T> data;
+                using Slot = std::conditional_t<STABLE, std::unique_ptr<T>, T>;
+
+                SparseIndex indexes;
+                std::vector<Entity> entities;
+                std::vector<Slot> data;
+
+                static T& Deref(Slot& s) {
+                    if constexpr (STABLE) { return *s; }
+                    else { return s; }
+                }
+
+                static const T& Deref(const Slot& s) {
+                    if constexpr (STABLE) { return *s; }
+                    else { return s; }
+                }
+
+                template<class E>
+                size_t InsertImpl(Entity entity, E&& entry) {
+                    uint32_t& slot = indexes.Slot(entity);
+                    if (slot != SparseIndex::INVALID_INDEX) {
+                        Deref(data[slot]) = std::forward<E>(entry);
+                        return slot;
+                    }
+                    slot = (uint32_t)data.size();
+                    entities.push_back(entity);
+                    if constexpr (STABLE) {
+                        data.emplace_back(std::make_unique<T>(std::forward<E>(entry)));
+                    }
+                    else {
+                        data.emplace_back(std::forward<E>(entry));
+                    }
+                    return slot;
+                }
 
             public:
                 EntityVector() {
-                    data.reserve(MAX_ENTITIES);
+                    entities.reserve(RESERVED_ENTITIES);
+                    data.reserve(RESERVED_ENTITIES);
                 }
 
-                std::vector<T>& GetData() { return data; }
-                const std::vector<T>& GetConstData() const { return data; }
+                template<class Base, class Ref>
+                class Iterator {
+                private:
+                    Base it;
+                public:
+                    Iterator(Base it) : it(it) {}
+                    Ref operator*() const { return Deref(*it); }
+                    auto operator->() const { return &Deref(*it); }
+                    Iterator& operator++() { ++it; return *this; }
+                    bool operator==(const Iterator& other) const { return it == other.it; }
+                    bool operator!=(const Iterator& other) const { return it != other.it; }
+                };
 
-                T* Get(Entity entity)  {
-                    T* ret = nullptr;
-                    auto it = indexes.find(entity);
-                    if (it != indexes.end()) {
-                        ret = &(data.at(it->second));
-                    }
-                    return ret;
+                using iterator = Iterator<typename std::vector<Slot>::iterator, T&>;
+                using const_iterator = Iterator<typename std::vector<Slot>::const_iterator, const T&>;
+
+                //Packed access, only available for non stable vectors
+                std::vector<T>& GetData() requires (!STABLE) { return data; }
+                const std::vector<T>& GetConstData() const requires (!STABLE) { return data; }
+
+                iterator begin() { return iterator(data.begin()); }
+                iterator end() { return iterator(data.end()); }
+                const_iterator begin() const { return const_iterator(data.begin()); }
+                const_iterator end() const { return const_iterator(data.end()); }
+
+                size_t Size() const { return data.size(); }
+                bool Empty() const { return data.empty(); }
+
+                T& operator[](size_t index) { return Deref(data[index]); }
+                const T& operator[](size_t index) const { return Deref(data[index]); }
+                Entity GetEntity(size_t index) const { return entities[index]; }
+                const std::vector<Entity>& GetEntities() const { return entities; }
+
+                bool Contains(Entity entity) const {
+                    return indexes.Contains(entity);
+                }
+
+                T* Get(Entity entity) {
+                    uint32_t index = indexes.Get(entity);
+                    return (index != SparseIndex::INVALID_INDEX) ? &Deref(data[index]) : nullptr;
                 }
-                
+
                 const T* Get(Entity entity) const {
-                    const T* ret = nullptr;
-                    auto it = indexes.find(entity);
-                    if (it != indexes.end()) {
-                        ret = &(data.at(it->second));
-                    }
-                    return ret;
+                    uint32_t index = indexes.Get(entity);
+                    return (index != SparseIndex::INVALID_INDEX) ? &Deref(data[index]) : nullptr;
                 }
 
                 size_t Insert(Entity entity, const T& entry) {
-                    size_t index;
-                    auto it = indexes.find(entity);
-                    if (it != indexes.end()) {
-                        index = it->second;
-                        data[index] = entry;
-                    }
-                    else {
-                        data.push_back(entry);
-                        index = data.size() - 1;
-                        indexes[entity] = index;
-                    }
-                    return index;
+                    return InsertImpl(entity, entry);
                 }
 
                 size_t Insert(Entity entity, T&& entry) {
-                    size_t index;
-                    auto it = indexes.find(entity);
-                    if (it != indexes.end()) {
-                        index = it->second;
-                        data[index] = entry;
-                    }
-                    else {
-                        data.emplace_back(std::forward<T>(entry));
-                        index = data.size() - 1;
-                        indexes[entity] = index;
-                    }
-                    return index;
+                    return InsertImpl(entity, std::move(entry));
                 }
 
                 bool Remove(Entity entity) {
-                    bool ret = false;
-                    auto it = indexes.find(entity);
-                    if (it != indexes.end()) {
-                        if (indexes.size() == 1) {
-                            indexes.clear();
-                            data.clear();
-                        }
-                        else {
-                            size_t index_to_erase = it->second;
-                            size_t index_to_move = data.size() - 1;
-                            Entity key_to_move;
-                            for (auto& it_to_move : indexes) {
-                                if (it_to_move.second == index_to_move) {
-                                    key_to_move = it_to_move.first;
-                                    break;
-                                }
-                            }
-                            if (index_to_erase != data.size() - 1) {
-                                data[index_to_erase] = data[index_to_move];
-                                indexes[key_to_move] = index_to_erase;
-                            }
-                            data.pop_back();
-                            indexes.erase(it);
-                            ret = true;
-                        }
+                    uint32_t index_to_erase = indexes.Get(entity);
+                    if (index_to_erase == SparseIndex::INVALID_INDEX) {
+                        return false;
                     }
-                    return ret;
+                    uint32_t index_to_move = (uint32_t)data.size() - 1;
+                    if (index_to_erase != index_to_move) {
+                        Entity key_to_move = entities[index_to_move];
+                        data[index_to_erase] = std::move(data[index_to_move]);
+                        entities[index_to_erase] = key_to_move;
+                        indexes.Set(key_to_move, index_to_erase);
+                    }
+                    data.pop_back();
+                    entities.pop_back();
+                    indexes.Set(entity, SparseIndex::INVALID_INDEX);
+                    return true;
+                }
+
+                void Clear() {
+                    indexes.Clear();
+                    entities.clear();
+                    data.clear();
                 }
             };
         }
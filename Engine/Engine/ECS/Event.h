@@ -26,6 +26,11 @@ SOFTWARE.
 
 #include "Types.h"
 #include <any>
+#include <algorithm>
+#include <concepts>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <list>
 
@@ -104,6 +109,46 @@ namespace HotBite {
 				std::unordered_map<ParamId, std::any> data;
 			};
 
+			// Typed events
+
+			//Maximum size of a typed event, they are stored inline in the event queues
+			static constexpr size_t MAX_EVENT_PAYLOAD = 128;
+
+			/**
+			 * Fixed size string to carry text by value in typed events, as they are
+			 * dispatched deferred the event can't point to data owned by the sender.
+			 * Longer strings are truncated to N - 1 characters.
+			 */
+			template<size_t N>
+			struct EventString {
+				char data[N] = {};
+
+				EventString() = default;
+				template<typename S> requires std::convertible_to<const S&, std::string_view>
+				EventString(const S& str) {
+					std::string_view s = str;
+					size_t n = std::min(s.size(), N - 1);
+					memcpy(data, s.data(), n);
+					data[n] = 0;
+				}
+
+				std::string_view view() const { return data; }
+				bool operator==(std::string_view s) const { return view() == s; }
+			};
+
+			/**
+			 * Typed events are plain structs identified by their type, they don't allocate when sent.
+			 * They must be trivially copyable so they can be stored in the event queues, and must
+			 * have an entity member used to route them to the listeners registered by entity
+			 * (INVALID_ENTITY_ID if the event is not related to an entity).
+			 */
+			template<typename E>
+			concept TypedEvent = std::is_trivially_copyable_v<E> &&
+				std::is_default_constructible_v<E> &&
+				sizeof(E) <= MAX_EVENT_PAYLOAD &&
+				alignof(E) <= 16 &&
+				requires(const E & e) { { e.entity } -> std::convertible_to<Entity>; };
+
 			template <class T>
 			EventId GetEventId(int id) {
 				return (EventId)(typeid(T).hash_code() & 0xffff0000 | id & 0x0000ffff);
@@ -25,10 +25,14 @@ SOFTWARE.
 #pragma once
 
 #include "Event.h"
+#include "EventQueue.h"
 #include "Types.h"
+#include <Core/SpinLock.h>
+#include <array>
 #include <functional>
 #include <list>
 #include <unordered_map>
+#include <vector>
 
 namespace std {
 	template <> struct hash<std::pair<HotBite::Engine::ECS::EventId, HotBite::Engine::ECS::Entity>>
@@ -47,6 +51,79 @@ namespace HotBite {
 				uint32_t listener_id;
 				EventId ev_id;
 				Entity e = INVALID_ENTITY_ID;
+				bool typed = false;
+			};
+
+			class ITypedListeners {
+			public:
+				virtual ~ITypedListeners() {}
+				virtual void Remove(uint32_t listener_id, Entity e) = 0;
+				virtual void Dispatch(const void* payload) = 0;
+			};
+
+			/**
+			 * Listeners of a typed event, global listeners are kept in a plain array
+			 * and listeners by entity are grouped by entity.
+			 */
+			template<TypedEvent E>
+			class TypedListeners : public ITypedListeners {
+			private:
+				struct Listener {
+					uint32_t id;
+					std::function<void(const E&)> f;
+				};
+				std::vector<Listener> listeners;
+				std::unordered_map<Entity, std::vector<Listener>> listeners_by_entity;
+
+				static void Remove(std::vector<Listener>& v, uint32_t listener_id) {
+					for (auto it = v.begin(); it != v.end(); ++it) {
+						if (it->id == listener_id) {
+							v.erase(it);
+							break;
+						}
+					}
+				}
+
+			public:
+				void Add(uint32_t listener_id, Entity e, std::function<void(const E&)>&& f) {
+					if (e == INVALID_ENTITY_ID) {
+						listeners.push_back({ listener_id, std::move(f) });
+					}
+					else {
+						listeners_by_entity[e].push_back({ listener_id, std::move(f) });
+					}
+				}
+
+				void Remove(uint32_t listener_id, Entity e) override {
+					if (e == INVALID_ENTITY_ID) {
+						Remove(listeners, listener_id);
+					}
+					else if (auto it = listeners_by_entity.find(e); it != listeners_by_entity.end()) {
+						Remove(it->second, listener_id);
+						if (it->second.empty()) {
+							listeners_by_entity.erase(it);
+						}
+					}
+				}
+
+				void Dispatch(const E& ev) {
+					for (size_t i = 0; i < listeners.size(); ++i) {
+						listeners[i].f(ev);
+					}
+					if (ev.entity != INVALID_ENTITY_ID) {
+						if (auto it = listeners_by_entity.find(ev.entity); it != listeners_by_entity.end()) {
+							for (size_t i = 0; i < it->second.size(); ++i) {
+								it->second[i].f(ev);
+							}
+						}
+					}
+				}
+
+				void Dispatch(const void* payload) override {
+					E ev;
+					memcpy(&ev, payload, sizeof(E));
+					Dispatch(ev);
+				}
 			};
 
 
@@ -86,6 +163,12 @@ namespace HotBite {
 
 				void RemoveListener(const EventListenerId& id)
 				{
+					if (id.typed) {
+						if (id.ev_id < typed_listeners.size() && typed_listeners[id.ev_id] != nullptr) {
+							typed_listeners[id.ev_id]->Remove(id.listener_id, id.e);
+						}
+						return;
+					}
 					bool removed = false;
 					auto it = listener_by_id.find(id.listener_id);
 					if (it != listener_by_id.end()) {
@@ -161,7 +244,108 @@ namespace HotBite {
 					SendEvent(Event{ sender, entity, type });
 				}
 
+				// Typed events
+
+				template<TypedEvent E>
+				EventListenerId AddListener(Entity e, std::function<void(const E&)>&& listener)
+				{
+					uint32_t type = TypeIndex<EventManager>::Get<E>();
+					if (type >= typed_listeners.size()) {
+						typed_listeners.resize(type + 1);
+					}
+					if (typed_listeners[type] == nullptr) {
+						typed_listeners[type] = std::make_unique<TypedListeners<E>>();
+					}
+					EventListenerId id{ next_typed_listener_id++, type, e, true };
+					static_cast<TypedListeners<E>*>(typed_listeners[type].get())->Add(id.listener_id, e, std::move(listener));
+					return id;
+				}
+
+				//Dispatches the event to the listeners in the calling thread
+				template<TypedEvent E>
+				void SendEvent(const E& ev)
+				{
+					uint32_t type = TypeIndex<EventManager>::Get<E>();
+					if (type < typed_listeners.size() && typed_listeners[type] != nullptr) {
+						static_cast<TypedListeners<E>*>(typed_listeners[type].get())->Dispatch(ev);
+					}
+				}
+
+				//Queues the event in the calling thread queue, it will be dispatched by FlushEvents
+				template<TypedEvent E>
+				void PostEvent(const E& ev)
+				{
+					uint32_t type = TypeIndex<EventManager>::Get<E>();
+					EventQueue* queue = GetThreadQueue();
+					if (queue == nullptr || !queue->Push(type, ev)) {
+						Core::AutoLock l(queue_lock);
+						QueuedEvent& q = overflow.emplace_back();
+						q.type = type;
+						memcpy(q.payload, &ev, sizeof(E));
+						has_overflow.store(true, std::memory_order_release);
+					}
+				}
+
+				//Dispatches all the posted events, must be called from the thread owning the listeners.
+				//Events posted from the same thread are dispatched in order, unless its queue got full.
+				void FlushEvents()
+				{
+					uint32_t n = queue_count.load(std::memory_order_acquire);
+					for (uint32_t i = 0; i < n; ++i) {
+						queues[i]->Consume([this](const QueuedEvent& q) { Dispatch(q); });
+					}
+					if (has_overflow.exchange(false, std::memory_order_acquire)) {
+						{
+							Core::AutoLock l(queue_lock);
+							overflow.swap(flushing);
+						}
+						for (const QueuedEvent& q : flushing) {
+							Dispatch(q);
+						}
+						flushing.clear();
+					}
+				}
+
 			private:
+				static constexpr uint32_t MAX_EVENT_THREADS = 64;
+				static inline std::atomic<uint32_t> next_instance_id{ 0 };
+				const uint32_t instance_id = next_instance_id++;
+
+				std::vector<std::unique_ptr<ITypedListeners>> typed_listeners;
+				uint32_t next_typed_listener_id = 0;
+				std::array<std::unique_ptr<EventQueue>, MAX_EVENT_THREADS> queues;
+				std::atomic<uint32_t> queue_count{ 0 };
+				std::atomic<bool> has_overflow{ false };
+				Core::spin_lock queue_lock;
+				std::vector<QueuedEvent> overflow;
+				std::vector<QueuedEvent> flushing;
+
+				void Dispatch(const QueuedEvent& q) {
+					if (q.type < typed_listeners.size() && typed_listeners[q.type] != nullptr) {
+						typed_listeners[q.type]->Dispatch(q.payload);
+					}
+				}
+
+				//Returns the queue of the calling thread, nullptr if no more queues available
+				EventQueue* GetThreadQueue() {
+					thread_local std::vector<std::pair<uint32_t, EventQueue*>> thread_queues;
+					for (const auto& q : thread_queues) {
+						if (q.first == instance_id) {
+							return q.second;
+						}
+					}
+					Core::AutoLock l(queue_lock);
+					uint32_t n = queue_count.load(std::memory_order_relaxed);
+					if (n == MAX_EVENT_THREADS) {
+						return nullptr;
+					}
+					queues[n] = std::make_unique<EventQueue>();
+					queue_count.store(n + 1, std::memory_order_release);
+					thread_queues.emplace_back(instance_id, queues[n].get());
+					return queues[n].get();
+				}
+
+
 				static const int MAX_LISTENERS = 5000;
 				using EventPair = std::pair<EventId, Entity>;
 				std::list<uint32_t> listener_ids;
@@ -0,0 +1,94 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Event.h"
+#include "Types.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			//Typed event stored inline, type is the event type index in the event manager
+			struct QueuedEvent {
+				uint32_t type = 0;
+				alignas(16) unsigned char payload[MAX_EVENT_PAYLOAD];
+			};
+
+			/**
+			 * Single producer/single consumer ring buffer of typed events.
+			 * 
+			 * Each thread posting events owns one queue (producer) and the thread that flushes
+			 * the event manager drains all of them (consumer), so posting an event is a copy
+			 * and two atomic operations, no locks and no allocations.
+			 */
+			class EventQueue {
+			public:
+				static constexpr uint32_t QUEUE_SIZE = 1024;
+				static constexpr uint32_t QUEUE_MASK = QUEUE_SIZE - 1;
+				static_assert((QUEUE_SIZE & QUEUE_MASK) == 0, "Queue size must be a power of two");
+
+			private:
+				std::unique_ptr<QueuedEvent[]> ring;
+				//Read position, written by the consumer
+				alignas(64) std::atomic<uint32_t> head{ 0 };
+				//Write position, written by the producer
+				alignas(64) std::atomic<uint32_t> tail{ 0 };
+
+			public:
+				EventQueue() : ring(std::make_unique<QueuedEvent[]>(QUEUE_SIZE)) {}
+
+				//Returns false if the queue is full
+				template<TypedEvent E>
+				bool Push(uint32_t type, const E& ev) {
+					uint32_t t = tail.load(std::memory_order_relaxed);
+					if (t - head.load(std::memory_order_acquire) == QUEUE_SIZE) {
+						return false;
+					}
+					QueuedEvent& q = ring[t & QUEUE_MASK];
+					q.type = type;
+					memcpy(q.payload, &ev, sizeof(E));
+					tail.store(t + 1, std::memory_order_release);
+					return true;
+				}
+
+				//Calls f for every event queued when the call started
+				template<typename F>
+				void Consume(F&& f) {
+					uint32_t h = head.load(std::memory_order_relaxed);
+					uint32_t t = tail.load(std::memory_order_acquire);
+					while (h != t) {
+						f(ring[h & QUEUE_MASK]);
+						++h;
+						head.store(h, std::memory_order_release);
+					}
+				}
+			};
+		}
+	}
+}
@@ -0,0 +1,160 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			/**
+			 * Vector that stores its elements in fixed size pages.
+			 * 
+			 * Growing never moves the existing elements, so pointers to them
+			 * stay valid until the element is removed. Systems cache pointers to
+			 * components, so component storage must not relocate when new entities are added.
+			 */
+			template <class T, size_t PAGE_BITS = 10>
+			class PagedVector {
+			public:
+				static constexpr size_t PAGE_SIZE = (size_t)1 << PAGE_BITS;
+				static constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+
+				template <bool CONST>
+				class Iterator {
+				private:
+					using Container = std::conditional_t<CONST, const PagedVector, PagedVector>;
+					Container* v = nullptr;
+					size_t i = 0;
+				public:
+					using iterator_category = std::forward_iterator_tag;
+					using value_type = T;
+					using difference_type = std::ptrdiff_t;
+					using pointer = std::conditional_t<CONST, const T*, T*>;
+					using reference = std::conditional_t<CONST, const T&, T&>;
+
+					Iterator() = default;
+					Iterator(Container* c, size_t index) : v(c), i(index) {}
+					reference operator*() const { return (*v)[i]; }
+					pointer operator->() const { return &(*v)[i]; }
+					Iterator& operator++() { ++i; return *this; }
+					Iterator operator++(int) { Iterator ret = *this; ++i; return ret; }
+					bool operator==(const Iterator& other) const { return i == other.i; }
+					bool operator!=(const Iterator& other) const { return i != other.i; }
+				};
+
+				using iterator = Iterator<false>;
+				using const_iterator = Iterator<true>;
+
+			private:
+				std::vector<T*> pages;
+				size_t count = 0;
+
+				static T* AllocPage() {
+					return static_cast<T*>(::operator new(sizeof(T) * PAGE_SIZE, std::align_val_t{ alignof(T) }));
+				}
+
+				static void FreePage(T* page) {
+					::operator delete(page, std::align_val_t{ alignof(T) });
+				}
+
+			public:
+				PagedVector() = default;
+				PagedVector(const PagedVector&) = delete;
+				PagedVector& operator=(const PagedVector&) = delete;
+
+				~PagedVector() {
+					clear();
+					for (T* page : pages) {
+						FreePage(page);
+					}
+				}
+
+				size_t size() const { return count; }
+				bool empty() const { return count == 0; }
+				size_t capacity() const { return pages.size() * PAGE_SIZE; }
+
+				T& operator[](size_t i) {
+					assert(i < count);
+					return pages[i >> PAGE_BITS][i & PAGE_MASK];
+				}
+
+				const T& operator[](size_t i) const {
+					assert(i < count);
+					return pages[i >> PAGE_BITS][i & PAGE_MASK];
+				}
+
+				T& back() { return (*this)[count - 1]; }
+				const T& back() const { return (*this)[count - 1]; }
+
+				//Allocates the pages needed to hold n elements
+				void reserve(size_t n) {
+					while (capacity() < n) {
+						pages.push_back(AllocPage());
+					}
+				}
+
+				template <class... Args>
+				T& emplace_back(Args&&... args) {
+					if ((count >> PAGE_BITS) == pages.size()) {
+						pages.push_back(AllocPage());
+					}
+					T* p = &pages[count >> PAGE_BITS][count & PAGE_MASK];
+					new (p) T(std::forward<Args>(args)...);
+					++count;
+					return *p;
+				}
+
+				void push_back(const T& value) {
+					emplace_back(value);
+				}
+
+				void pop_back() {
+					assert(count > 0);
+					--count;
+					pages[count >> PAGE_BITS][count & PAGE_MASK].~T();
+				}
+
+				//Destroys all the elements, allocated pages are kept for reuse
+				void clear() {
+					while (count > 0) {
+						pop_back();
+					}
+				}
+
+				iterator begin() { return iterator(this, 0); }
+				iterator end() { return iterator(this, count); }
+				const_iterator begin() const { return const_iterator(this, 0); }
+				const_iterator end() const { return const_iterator(this, count); }
+			};
+		}
+	}
+}
@@ -0,0 +1,93 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Types.h"
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			/**
+			 * Maps entities to indexes of a packed array.
+			 * 
+			 * The map is an array indexed by entity split in pages, a page is
+			 * only allocated when an entity of its range is added, so memory
+			 * depends on the entity ids in use and not on the maximum entity id.
+			 */
+			class SparseIndex {
+			public:
+				static constexpr uint32_t PAGE_BITS = 12;
+				static constexpr uint32_t PAGE_SIZE = 1 << PAGE_BITS;
+				static constexpr uint32_t PAGE_MASK = PAGE_SIZE - 1;
+				static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+			private:
+				std::vector<std::vector<uint32_t>> pages;
+
+			public:
+				uint32_t Get(Entity entity) const {
+					uint32_t page = (uint32_t)entity >> PAGE_BITS;
+					if (entity < 0 || page >= pages.size() || pages[page].empty()) {
+						return INVALID_INDEX;
+					}
+					return pages[page][(uint32_t)entity & PAGE_MASK];
+				}
+
+				bool Contains(Entity entity) const {
+					return Get(entity) != INVALID_INDEX;
+				}
+
+				//Returns the index slot of the entity, allocating the page if needed
+				uint32_t& Slot(Entity entity) {
+					uint32_t page = (uint32_t)entity >> PAGE_BITS;
+					if (page >= pages.size()) {
+						pages.resize(page + 1);
+					}
+					if (pages[page].empty()) {
+						pages[page].resize(PAGE_SIZE, INVALID_INDEX);
+					}
+					return pages[page][(uint32_t)entity & PAGE_MASK];
+				}
+
+				//Entity must be already in the index
+				void Set(Entity entity, uint32_t index) {
+					pages[(uint32_t)entity >> PAGE_BITS][(uint32_t)entity & PAGE_MASK] = index;
+				}
+
+				void Reset(Entity entity) {
+					if (Contains(entity)) {
+						Set(entity, INVALID_INDEX);
+					}
+				}
+
+				void Clear() {
+					pages.clear();
+				}
+			};
+		}
+	}
+}
@@ -28,6 +28,7 @@ SOFTWARE.
 #include "Event.h"
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -39,6 +40,9 @@ namespace HotBite {
 				virtual void OnRegister(Coordinator* c) = 0;
 				virtual void OnEntitySignatureChanged(Entity entity, const Signature& entity_signature) = 0;
 				virtual void OnEntityDestroyed(Entity entity) = 0;
+				//Signatures this system works with. Entity notifications are only routed to the systems
+				//where the entity matches (or matched) one of them, systems with no signatures get every notification.
+				virtual std::vector<Signature> GetSignatures() const { return {}; }
 				friend class SystemManager;
 			};
 		}
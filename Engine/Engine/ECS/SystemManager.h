@@ -29,6 +29,7 @@ SOFTWARE.
 #include <cassert>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace HotBite {
 	namespace Engine {
@@ -39,40 +40,122 @@ namespace HotBite {
 				template<typename T>
 				std::shared_ptr<T> RegisterSystem()
 				{
-					const char* typeName = typeid(T).name();
-					assert(systems.find(typeName) == systems.end() && "Registering system more than once.");
+					uint32_t index = TypeIndex<SystemManager>::Get<T>();
+					if (index >= systems.size()) {
+						systems.resize(index + 1);
+					}
+					assert(systems[index] == nullptr && "Registering system more than once.");
 					std::shared_ptr<T> system = std::make_shared<T>();
-					systems.insert({ typeName, system });
+					assert(registered_systems.size() < MAX_SYSTEMS && "Too many systems.");
+					systems[index] = system;
+					registered_systems.push_back(system.get());
+					routes.emplace_back();
+					broadcast_systems |= 1ULL << (registered_systems.size() - 1);
+					matching_systems.clear();
 					return system;
 				}
 
 				template<typename T>
 				std::shared_ptr<T> GetSystem()
 				{
-					const char* typeName = typeid(T).name();
-					auto it = systems.find(typeName);
-					assert(it != systems.end() && "System not found.");
-					return std::dynamic_pointer_cast<T>(it->second);
+					uint32_t index = TypeIndex<SystemManager>::Get<T>();
+					assert(index < systems.size() && systems[index] != nullptr && "System not found.");
+					return (index < systems.size()) ? std::static_pointer_cast<T>(systems[index]) : nullptr;
+				}
+
+				//Direct access to the system, no reference counting involved
+				template<typename T>
+				T* GetSystemPtr()
+				{
+					uint32_t index = TypeIndex<SystemManager>::Get<T>();
+					assert(index < systems.size() && systems[index] != nullptr && "System not found.");
+					return (index < systems.size()) ? static_cast<T*>(systems[index].get()) : nullptr;
+				}
+
+				//Reads the signatures of a registered system to route entity notifications
+				void UpdateSystemRoutes(System* system)
+				{
+					for (size_t i = 0; i < registered_systems.size(); ++i) {
+						if (registered_systems[i] == system) {
+							routes[i] = system->GetSignatures();
+							uint64_t bit = 1ULL << i;
+							broadcast_systems = routes[i].empty() ? (broadcast_systems | bit) : (broadcast_systems & ~bit);
+							matching_systems.clear();
+							break;
+						}
+					}
+				}
+
+				//Mask of the systems that have to be notified about an entity with this signature.
+				//Entities share a few signatures, so the mask is computed once per signature.
+				uint64_t GetMatchingSystems(const Signature& entity_signature)
+				{
+					auto it = matching_systems.find(entity_signature);
+					if (it != matching_systems.end()) {
+						return it->second;
+					}
+					uint64_t mask = broadcast_systems;
+					for (size_t i = 0; i < routes.size(); ++i) {
+						for (const Signature& s : routes[i]) {
+							if ((entity_signature & s) == s) {
+								mask |= 1ULL << i;
+								break;
+							}
+						}
+					}
+					matching_systems.emplace(entity_signature, mask);
+					return mask;
 				}
 
 				void EntityDestroyed(Entity entity)
 				{
-					for (auto const& pair : systems)
+					Signature& last = NotifiedSignature(entity);
+					uint64_t mask = GetMatchingSystems(last);
+					last.reset();
+					for (size_t i = 0; mask != 0; ++i, mask >>= 1)
 					{
-						pair.second->OnEntityDestroyed(entity);
+						if (mask & 1) {
+							registered_systems[i]->OnEntityDestroyed(entity);
+						}
 					}
 				}
 
+				//Only systems where the entity is, or was, a member are notified
 				void EntitySignatureChanged(Entity entity, Signature entitySignature)
 				{
-					for (auto const& pair : systems)
+					Signature& last = NotifiedSignature(entity);
+					uint64_t mask = GetMatchingSystems(last) | GetMatchingSystems(entitySignature);
+					last = entitySignature;
+					for (size_t i = 0; mask != 0; ++i, mask >>= 1)
 					{
-						pair.second->OnEntitySignatureChanged(entity, entitySignature);
+						if (mask & 1) {
+							registered_systems[i]->OnEntitySignatureChanged(entity, entitySignature);
+						}
 					}
 				}
 
 			private:
-				std::unordered_map<const char*, std::shared_ptr<System>> systems;
+				//Indexed by TypeIndex<SystemManager>
+				std::vector<std::shared_ptr<System>> systems;
+				//Registered systems in registration order
+				std::vector<System*> registered_systems;
+				//Signatures of each registered system
+				std::vector<std::vector<Signature>> routes;
+				//Systems with no signatures, they receive all the notifications
+				uint64_t broadcast_systems = 0;
+				//Last signature notified to the systems by entity
+				std::vector<Signature> notified_signatures;
+				//GetMatchingSystems results, cleared when the systems or their signatures change
+				std::unordered_map<Signature, uint64_t> matching_systems;
+
+				Signature& NotifiedSignature(Entity entity)
+				{
+					assert(entity >= 0 && "Invalid entity.");
+					if ((size_t)entity >= notified_signatures.size()) {
+						notified_signatures.resize(((size_t)entity / ENTITY_PAGE_SIZE + 1) * ENTITY_PAGE_SIZE);
+					}
+					return notified_signatures[entity];
+				}
 			};
 		}
 	}
@@ -0,0 +1,268 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "Types.h"
+#include "ComponentLocks.h"
+#include <Core/JobSystem.h>
+#include <Core/Profiler.h>
+#include <Core/SpinLock.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace ECS {
+
+			/**
+			 * Frame task graph.
+			 * 
+			 * Each task declares the components it reads and writes (as signatures). A task depends on
+			 * every task added before it that writes a component it reads or writes, or that reads a
+			 * component it writes, so tasks without conflicts run concurrently in the job system while
+			 * the result is the same as running them in insertion order.
+			 * With component locks set, the job system tasks lock the components they declare while they
+			 * run, so tasks of other graphs sharing the locks only wait for the ones touching the same
+			 * components. Tasks that call user code (events, game listeners) or take engine locks must be
+			 * pinned to the thread running the graph, they don't take component locks. Exclusive tasks
+			 * conflict with every other task.
+			 * After each run a report with the frame time and the critical path is available.
+			 */
+			class TaskGraph {
+			public:
+				using TaskId = uint32_t;
+
+				struct Report {
+					//Wall time of the whole graph
+					int64_t total_nsec = 0;
+					//Sum of the tasks times
+					int64_t work_nsec = 0;
+					//Longest chain of dependent tasks
+					int64_t critical_path_nsec = 0;
+					std::string critical_path;
+				};
+
+			private:
+				struct Task {
+					std::string name;
+					const char* profile_name = nullptr;
+					Signature reads;
+					Signature writes;
+					bool exclusive = false;
+					bool caller_thread = false;
+					std::function<void()> f;
+					std::vector<TaskId> dependencies;
+					std::vector<TaskId> successors;
+					int64_t start = 0;
+					int64_t end = 0;
+				};
+
+				std::vector<Task> tasks;
+				std::unique_ptr<std::atomic<int32_t>[]> remaining;
+				std::atomic<int32_t> completed{ 0 };
+				//Incremented when the thread running the graph may have work, it waits on it
+				std::atomic<uint32_t> signal{ 0 };
+				ComponentLocks* locks = nullptr;
+				Core::spin_lock caller_lock;
+				std::vector<TaskId> caller_ready;
+				bool built = false;
+				Report report;
+
+				static int64_t Now() {
+					return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+				}
+
+				static bool Conflict(const Task& a, const Task& b) {
+					return a.exclusive || b.exclusive ||
+						(a.writes & (b.reads | b.writes)).any() ||
+						(b.writes & a.reads).any();
+				}
+
+				void Build() {
+					for (TaskId j = 0; j < tasks.size(); ++j) {
+						tasks[j].dependencies.clear();
+						tasks[j].successors.clear();
+						for (TaskId i = 0; i < j; ++i) {
+							if (Conflict(tasks[i], tasks[j])) {
+								tasks[j].dependencies.push_back(i);
+								tasks[i].successors.push_back(j);
+							}
+						}
+					}
+					remaining = std::make_unique<std::atomic<int32_t>[]>(tasks.size());
+					built = true;
+				}
+
+				void Execute(TaskId id, Core::JobSystem* js) {
+					Task& t = tasks[id];
+					bool locked = (locks != nullptr && !t.caller_thread);
+					if (locked && !locks->TryLock(t.reads, t.writes)) {
+						//Components in use by another graph or the world mutex, retry later
+						std::this_thread::yield();
+						Schedule(id, js);
+						return;
+					}
+					t.start = Now();
+					{
+						Core::ProfileZone zone(t.profile_name);
+						t.f();
+					}
+					t.end = Now();
+					if (locked) {
+						locks->Unlock(t.reads, t.writes);
+					}
+					for (TaskId s : t.successors) {
+						if (remaining[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+							Schedule(s, js);
+						}
+					}
+					completed.fetch_add(1, std::memory_order_release);
+					Signal();
+				}
+
+				void Schedule(TaskId id, Core::JobSystem* js) {
+					if (tasks[id].caller_thread || js == nullptr) {
+						Core::AutoLock l(caller_lock);
+						caller_ready.push_back(id);
+					}
+					else {
+						js->Submit([this, id, js]() { Execute(id, js); });
+					}
+					Signal();
+				}
+
+				void Signal() {
+					signal.fetch_add(1, std::memory_order_release);
+					signal.notify_one();
+				}
+
+				void UpdateReport(int64_t t0, int64_t t1) {
+					report.total_nsec = t1 - t0;
+					report.work_nsec = 0;
+					std::vector<int64_t> path(tasks.size(), 0);
+					std::vector<int32_t> prev(tasks.size(), -1);
+					int32_t last = -1;
+					for (TaskId j = 0; j < tasks.size(); ++j) {
+						int64_t duration = tasks[j].end - tasks[j].start;
+						report.work_nsec += duration;
+						for (TaskId i : tasks[j].dependencies) {
+							if (path[i] > path[j]) {
+								path[j] = path[i];
+								prev[j] = (int32_t)i;
+							}
+						}
+						path[j] += duration;
+						if (last < 0 || path[j] > path[last]) {
+							last = (int32_t)j;
+						}
+					}
+					report.critical_path_nsec = (last >= 0) ? path[last] : 0;
+					report.critical_path.clear();
+					for (int32_t i = last; i >= 0; i = prev[i]) {
+						report.critical_path = tasks[i].name + (report.critical_path.empty() ? "" : " > ") + report.critical_path;
+					}
+				}
+
+			public:
+				TaskId AddTask(const std::string& name, const Signature& reads, const Signature& writes,
+					std::function<void()>&& f, bool caller_thread = false) {
+					Task t;
+					t.name = name;
+					t.profile_name = Core::Profiler::Intern(name);
+					t.reads = reads;
+					t.writes = writes;
+					t.caller_thread = caller_thread;
+					t.f = std::move(f);
+					tasks.emplace_back(std::move(t));
+					built = false;
+					return (TaskId)tasks.size() - 1;
+				}
+
+				//Task conflicting with all the other tasks, it always runs in the thread running the graph
+				TaskId AddExclusiveTask(const std::string& name, std::function<void()>&& f) {
+					TaskId id = AddTask(name, {}, {}, std::move(f), true);
+					tasks[id].exclusive = true;
+					return id;
+				}
+
+				void Clear() {
+					tasks.clear();
+					built = false;
+				}
+
+				//Locks shared by the graphs running concurrently, the tasks run without locks if not set
+				void SetComponentLocks(ComponentLocks* component_locks) {
+					locks = component_locks;
+				}
+
+				//Runs all the tasks and returns when they are done
+				void Run() {
+					if (!built) {
+						Build();
+					}
+					Core::JobSystem* js = Core::JobSystem::Get();
+					int64_t t0 = Now();
+					completed = 0;
+					for (TaskId i = 0; i < tasks.size(); ++i) {
+						remaining[i] = (int32_t)tasks[i].dependencies.size();
+					}
+					for (TaskId i = 0; i < tasks.size(); ++i) {
+						if (tasks[i].dependencies.empty()) {
+							Schedule(i, js);
+						}
+					}
+					while (completed.load(std::memory_order_acquire) < (int32_t)tasks.size()) {
+						uint32_t seen = signal.load(std::memory_order_acquire);
+						TaskId next = (TaskId)-1;
+						{
+							Core::AutoLock l(caller_lock);
+							if (!caller_ready.empty()) {
+								next = caller_ready.back();
+								caller_ready.pop_back();
+							}
+						}
+						if (next != (TaskId)-1) {
+							Execute(next, js);
+						}
+						else if ((js == nullptr || !js->ExecuteOne()) && completed.load(std::memory_order_acquire) < (int32_t)tasks.size()) {
+							//Nothing to run here, sleep until a task is scheduled or completed
+							signal.wait(seen, std::memory_order_acquire);
+						}
+					}
+					UpdateReport(t0, Now());
+				}
+
+				const Report& GetReport() const {
+					return report;
+				}
+			};
+		}
+	}
+}
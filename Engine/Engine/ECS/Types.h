@@ -24,6 +24,7 @@ SOFTWARE.
 
 #pragma once
 
+#include <atomic>
 #include <bitset>
 #include <cstdint>
 
@@ -33,10 +34,48 @@ namespace HotBite {
 			// ECS
 			using Entity = int32_t;
 			const Entity INVALID_ENTITY_ID = -1;
-			const int32_t MAX_ENTITIES = 5000;
+			//Entity storage grows on demand in pages of this size
+			const int32_t ENTITY_PAGE_SIZE = 4096;
+			//Capacity reserved up front by containers that hand out pointers to their entries
+			const int32_t RESERVED_ENTITIES = 5000;
 			using ComponentType = uint8_t;
 			const int32_t MAX_COMPONENTS = 32;
 			using Signature = std::bitset<MAX_COMPONENTS>;
+			const int32_t MAX_SYSTEMS = 64;
+
+			/**
+			 * Sequential index per type, assigned the first time it's requested.
+			 * Each family has its own counter so indexes can be used directly
+			 * as positions in a flat array (e.g. component arrays or systems).
+			 */
+			template <class Family>
+			class TypeIndex {
+			private:
+				static inline std::atomic<uint32_t> counter{ 0 };
+			public:
+				template <class T>
+				static uint32_t Get() {
+					static const uint32_t index = counter++;
+					return index;
+				}
+			};
+
+			/**
+			 * Generational entity handle, entity ids are reused after the entity is destroyed
+			 * so long lived references must keep a handle to detect stale entities.
+			 */
+			struct EntityHandle {
+				Entity id = INVALID_ENTITY_ID;
+				uint32_t version = 0;
+
+				bool operator==(const EntityHandle& other) const {
+					return id == other.id && version == other.version;
+				}
+
+				bool operator!=(const EntityHandle& other) const {
+					return !(*this == other);
+				}
+			};
 		}
 	}
 }
\ No newline at end of file
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include <Components\Physics.h>
+#include <Core\JobSystem.h>
 #include "AnimationSystem.h"
 
 using namespace HotBite::Engine;
@@ -37,6 +38,10 @@ void AnimationMeshSystem::OnRegister(ECS::Coordinator* c) {
 	signature.set(coordinator->GetComponentType<Base>(), true);
 }
 
+std::vector<Signature> AnimationMeshSystem::GetSignatures() const {
+	return { signature };
+}
+
 
 void AnimationMeshSystem::OnEntityDestroyed(ECS::Entity entity) {
 	meshes.Remove(entity);
@@ -56,11 +61,11 @@ void AnimationMeshSystem::OnEntitySignatureChanged(ECS::Entity entity, const Sig
 }
 
 void AnimationMeshSystem::Update(int64_t elapsed_nsec, int64_t total_nsec) {
-	for (auto it = meshes.GetData().begin(); it != meshes.GetData().end(); ++it)
-	{
-		if (it->base->visible && it->base->scene_visible) {
-			it->mesh->Update(elapsed_nsec, total_nsec);
+	//Meshes are independent, animation events are posted to the calling thread queue
+	Core::JobSystem::ParallelForEach(meshes, [elapsed_nsec, total_nsec](MeshEntity& e) {
+		if (e.base->visible && e.base->scene_visible) {
+			e.mesh->Update(elapsed_nsec, total_nsec);
 		}
-	}
+	});
 }
 
@@ -68,6 +68,10 @@ void AudioSystem::OnRegister(ECS::Coordinator* c) {
 	bound_signature.set(coordinator->GetComponentType<Base>(), true);	
 }
 
+std::vector<Signature> AudioSystem::GetSignatures() const {
+	return { transform_signature, bound_signature };
+}
+
 void AudioSystem::OnEntitySignatureChanged(ECS::Entity entity, const Signature& entity_signature) {
 	AutoLock l(lock);
 	if ((entity_signature & transform_signature) == transform_signature)
@@ -366,7 +370,10 @@ bool AudioSystem::OnTick(const Scheduler::TimerData& td)
 				for (auto it = playlist.begin(); it != playlist.end(); ++it) {
 					if (it->second->updating == false && it->second->entity != INVALID_ENTITY_ID) {
 						it->second->updating = true;
-						playinfo_queue.Push(it->second);
+						if (!playinfo_queue.Push(it->second)) {
+							//Queue full, retry in next update
+							it->second->updating = false;
+						}
 					}
 				}
 			}
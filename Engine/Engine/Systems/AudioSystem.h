@@ -28,7 +28,7 @@ SOFTWARE.
 #include <Core\Scheduler.h>
 #include <Core\Json.h>
 #include <Core\SpinLock.h>
-#include <Core\LockingQueue.h>
+#include <Core\RingQueue.h>
 
 #include <Components\Base.h>
 #include <Components\Camera.h>
@@ -181,7 +181,8 @@ namespace HotBite {
                 std::map<PlayId, PlayInfoPtr> playlist;
                 std::thread physics_worker;
                 bool physics_worker_end = false;
-                Core::LockingQueue<PlayInfoPtr> playinfo_queue;
+                //Filled from the audio tick, it must never block
+                Core::RingQueue<PlayInfoPtr, 256, Core::QueueMode::MPSC> playinfo_queue;
 
                 int16_t* buffer = nullptr;
 
@@ -210,6 +211,7 @@ namespace HotBite {
                 void OnRegister(ECS::Coordinator* c) override;
                 void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
                 void OnEntityDestroyed(ECS::Entity entity) override;
+                std::vector<ECS::Signature> GetSignatures() const override;
                 void SetLocalEntity(ECS::Entity entity, const float3& offset = {});
                 void SetCameraEntity(ECS::Entity entity);
                 bool Config(const std::string& root_folder, const nlohmann::json& config);
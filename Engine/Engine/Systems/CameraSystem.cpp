@@ -40,6 +40,10 @@ void CameraSystem::OnRegister(ECS::Coordinator* c) {
 	signature.set(coordinator->GetComponentType<Camera>(), true);	
 }
 
+std::vector<Signature> CameraSystem::GetSignatures() const {
+	return { signature };
+}
+
 void CameraSystem::OnEntityDestroyed(Entity entity) {
 	cameras.Remove(entity);
 }
@@ -176,6 +180,7 @@ void CameraSystem::Update(CameraData& entity, int64_t elapsed_nsec, int64_t tota
 		}
 		updated = true;
 		entity.transform->dirty = false;
+		coordinator->MarkComponentChanged<Transform>(entity.base->id);
 		Event ev(this, EVENT_ID_CAMERA_MOVED);
 		ev.SetParam<CameraData*>(EVENT_PARAM_CAMERA_DATA, &entity);
 		coordinator->SendEvent(ev);
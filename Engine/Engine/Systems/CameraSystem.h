@@ -70,6 +70,7 @@ namespace HotBite {
 				void OnRegister(ECS::Coordinator* c) override;
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				void OnEntityDestroyed(ECS::Entity entity) override;
+				std::vector<ECS::Signature> GetSignatures() const override;
 
 			public:
 				CameraSystem() = default;
@@ -42,6 +42,10 @@ void DirectionalLightSystem::OnRegister(ECS::Coordinator* c) {
 	camera_signature.set(coordinator->GetComponentType<Camera>(), true);
 }
 
+std::vector<Signature> DirectionalLightSystem::GetSignatures() const {
+	return { dirlight_signature, camera_signature };
+}
+
 
 void DirectionalLightSystem::OnEntityDestroyed(Entity entity) {
 	lights.Remove(entity);
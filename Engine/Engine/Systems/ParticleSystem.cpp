@@ -38,6 +38,10 @@ void ParticleSystem::OnRegister(ECS::Coordinator* c) {
 	particles_signature.set(coordinator->GetComponentType<Particles>(), true);
 }
 
+std::vector<Signature> ParticleSystem::GetSignatures() const {
+	return { particles_signature };
+}
+
 
 void ParticleSystem::OnEntityDestroyed(ECS::Entity entity) {
 	particles.Remove(entity);
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include <Components/Physics.h>
+#include <Core/JobSystem.h>
 #include "PhysicsSystem.h"
 
 using namespace HotBite::Engine;
@@ -39,13 +40,15 @@ void PhysicsSystem::OnRegister(ECS::Coordinator* c) {
 	signature.set(coordinator->GetComponentType<Physics>(), true);
 }
 
+std::vector<Signature> PhysicsSystem::GetSignatures() const {
+	return { signature };
+}
+
 void PhysicsSystem::OnEntityDestroyed(Entity entity) {
 	AutoLock l(lock);
-	for (auto it = entity_by_body.begin(); it != entity_by_body.end(); ++it) {
-		if (it->second != nullptr && it->second->base->id == entity) {
-			entity_by_body.erase(it);
-			break;
-		}
+	PhysicsEntity* pe = physics.Get(entity);
+	if (pe != nullptr) {
+		entity_by_body.erase(pe->physics->body);
 	}
 	physics.Remove(entity);
 }
@@ -58,6 +61,7 @@ void PhysicsSystem::OnEntitySignatureChanged(Entity entity, const Signature& ent
 		physics.Insert(entity, pe);
 		if (pe.physics->body != nullptr) {
 			entity_by_body[pe.physics->body] = physics.Get(entity);
+			pe.physics->prev_body_transform = pe.physics->body->getTransform();
 		}
 	}
 	else
@@ -158,7 +162,11 @@ void PhysicsSystem::onTrigger(const reactphysics3d::OverlapCallback::CallbackDat
 }
 
 PhysicsSystem::PhysicsEntity* PhysicsSystem::GetEntity(const reactphysics3d::CollisionBody* body) {
-	for (PhysicsSystem::PhysicsEntity& p : physics.GetData()) {
+	auto it = entity_by_body.find((reactphysics3d::CollisionBody*)body);
+	if (it != entity_by_body.end()) {
+		return it->second;
+	}
+	for (PhysicsSystem::PhysicsEntity& p : physics) {
 		if (p.physics->body == body) {
 			return &p;
 		}
@@ -222,45 +230,40 @@ void PhysicsSystem::onContact(const reactphysics3d::CollisionCallback::CallbackD
 				PhysicsEntity* pe = GetEntity(b2);
 				if (pe != nullptr) {
 					entity_by_body[b2] = pe;
-					eb1 = entity_by_body.find(b2);
+					eb2 = entity_by_body.find(b2);
 				}
 			}
 			if (eb1 != end && eb2 != end) {
-				Event ev;
-				switch (contactPair.getEventType()) {
-				case ContactPair::EventType::ContactStart:
-				{
-					float force = 0.0f;
+				ECS::Entity e1 = eb1->second->base->id;
+				ECS::Entity e2 = eb2->second->base->id;
+				ContactPair::EventType type = contactPair.getEventType();
+				float force = 0.0f;
+				if (type == ContactPair::EventType::ContactStart) {
 					for (uint32_t i = 0; i < contactPair.getNbContactPoints(); ++i) {
 						force += contactPair.getContactPoint(0).getPenetrationDepth();
 					}
-					ev.SetType(EVENT_ID_COLLISION_START);
-					ev.SetParam<float>(EVENT_PARAM_COLLISION_FORCE, force);
-				} break;
-				case ContactPair::EventType::ContactExit:
-				{
-					ev.SetType(EVENT_ID_COLLISION_END);
-				}break;
 				}
 				int64_t now = Scheduler::GetNanoSeconds();
-				ev.SetParam(EVENT_PARAM_ENTITY_1, eb1->second->base->id);
-				ev.SetParam(EVENT_PARAM_ENTITY_2, eb2->second->base->id);
-				if ((now - last_event_by_entity[eb1->second->base->id][(int)contactPair.getEventType()]) > MSEC_TO_NSEC(10)) {
-					ev.SetEntity(eb1->second->base->id);
-					coordinator->SendEvent(ev);
-					last_event_by_entity[eb1->second->base->id][(int)contactPair.getEventType()] = now;
-				}
-				if ((now - last_event_by_entity[eb2->second->base->id][(int)contactPair.getEventType()]) > MSEC_TO_NSEC(10)) {
-					ev.SetEntity(eb2->second->base->id);
-					coordinator->SendEvent(ev);
-					last_event_by_entity[eb2->second->base->id][(int)contactPair.getEventType()] = now;
-				}				
+				//Events are queued and dispatched at the world sync point, out of the physics callback
+				auto post = [&](ECS::Entity entity, ECS::Entity other) {
+					if ((now - last_event_by_entity[entity][(int)type]) > MSEC_TO_NSEC(10)) {
+						if (type == ContactPair::EventType::ContactStart) {
+							coordinator->PostEvent(CollisionStartEvent{ entity, other, force });
+						}
+						else {
+							coordinator->PostEvent(CollisionEndEvent{ entity, other });
+						}
+						last_event_by_entity[entity][(int)type] = now;
+					}
+				};
+				post(e1, e2);
+				post(e2, e1);
 			}		
 		}
 	}
 }
 
-void PhysicsSystem::Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t total_nsec, bool force) {
+bool PhysicsSystem::Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t total_nsec, bool force) {
 
 	
 	Transform* transform = pe.transform;
@@ -268,9 +271,14 @@ void PhysicsSystem::Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t tota
 	Physics* physics = pe.physics;
 	Base* base = pe.base;
 
+	transform->prev_world_matrix = transform->world_matrix;
+
 	const reactphysics3d::Transform& bt = physics->body->getTransform();
 
-	transform->prev_world_matrix = transform->world_matrix;
+	//Sleeping bodies don't move, skip the transform comparison once they reached their last state
+	if (!force && physics->body->isSleeping() && physics->last_body_transform == bt) {
+		return false;
+	}
 
 	if (physics->type != reactphysics3d::BodyType::STATIC && (force || physics->last_body_transform != bt)) {
 		const reactphysics3d::Vector3& p = bt.getPosition();
@@ -300,8 +308,10 @@ void PhysicsSystem::Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t tota
 		local_oriented.Transform(bounds->bounding_box, transform->world_xmmatrix);
 
 		physics->last_body_transform = bt;
-		coordinator->SendEvent(this, pe.base->id, Transform::EVENT_ID_TRANSFORM_CHANGED);
-	}	
+		coordinator->MarkComponentChanged<Transform>(pe.base->id);
+		return true;
+	}
+	return false;
 }
 
 reactphysics3d::PhysicsWorld*
@@ -309,9 +319,45 @@ PhysicsSystem::GetWorld() {
 	return world;
 }
 
+void PhysicsSystem::SaveState() {
+	AutoLock l(lock);
+	for (PhysicsEntity& pe : physics) {
+		if (pe.physics->body != nullptr) {
+			pe.physics->prev_body_transform = pe.physics->body->getTransform();
+		}
+	}
+}
+
+void PhysicsSystem::GetInterpolation(float alpha, std::unordered_map<ECS::Entity, matrix>& corrections) {
+	//Rigid transforms without scale, the written world matrix is scale * last_body_transform
+	auto to_matrix = [](const reactphysics3d::Transform& t) {
+		const reactphysics3d::Vector3& p = t.getPosition();
+		const reactphysics3d::Quaternion& q = t.getOrientation();
+		return XMMatrixRotationQuaternion({ q.x, q.y, q.z, q.w }) * XMMatrixTranslation(p.x, p.y, p.z);
+	};
+	AutoLock l(lock);
+	corrections.clear();
+	for (PhysicsEntity& pe : physics) {
+		Physics* body_physics = pe.physics;
+		if (body_physics->body == nullptr || body_physics->type == reactphysics3d::BodyType::STATIC) {
+			continue;
+		}
+		const reactphysics3d::Transform bt = reactphysics3d::Transform::interpolateTransforms(
+			body_physics->prev_body_transform, body_physics->body->getTransform(), alpha);
+		if (bt != body_physics->last_body_transform) {
+			corrections[pe.base->id] = XMMatrixInverse(nullptr, to_matrix(body_physics->last_body_transform)) * to_matrix(bt);
+		}
+	}
+}
+
 void PhysicsSystem::Update(int64_t elapsed_nsec, int64_t total_nsec, bool force) {
-	for (auto it = physics.GetData().begin(); it != physics.GetData().end(); ++it)
-	{
-		Update(*it, elapsed_nsec, total_nsec, force);
+	//Bodies are updated in parallel, events are sent afterwards from this thread
+	JobSystem::ParallelForEach(physics, [this, elapsed_nsec, total_nsec, force](PhysicsEntity& pe) {
+		pe.changed = Update(pe, elapsed_nsec, total_nsec, force);
+	});
+	for (PhysicsEntity& pe : physics) {
+		if (pe.changed) {
+			coordinator->SendEvent(this, pe.base->id, Transform::EVENT_ID_TRANSFORM_CHANGED);
+		}
 	}
 }
\ No newline at end of file
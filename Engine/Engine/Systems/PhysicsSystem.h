@@ -37,17 +37,25 @@ namespace HotBite {
 				using CollisionData = std::unordered_map<reactphysics3d::CollisionBody* /*body 1*/,
 					std::unordered_map<reactphysics3d::CollisionBody* /* body 2*/, std::set<reactphysics3d::Vector3> /* collision points */>>;
 				
-				static inline ECS::EventId EVENT_ID_COLLISION_START = ECS::GetEventId<PhysicsSystem>(0x00);
-				static inline ECS::EventId EVENT_ID_COLLISION_END = ECS::GetEventId<PhysicsSystem>(0x01);
-				static inline ECS::ParamId EVENT_PARAM_ENTITY_1 = 0x01;
-				static inline ECS::ParamId EVENT_PARAM_ENTITY_2 = 0x02;
-				static inline ECS::ParamId EVENT_PARAM_COLLISION_FORCE = 0x03;
+				//Sent to both entities of the collision, other is the colliding entity
+				struct CollisionStartEvent {
+					ECS::Entity entity = ECS::INVALID_ENTITY_ID;
+					ECS::Entity other = ECS::INVALID_ENTITY_ID;
+					float force = 0.0f;
+				};
+
+				struct CollisionEndEvent {
+					ECS::Entity entity = ECS::INVALID_ENTITY_ID;
+					ECS::Entity other = ECS::INVALID_ENTITY_ID;
+				};
 			private:
 				struct PhysicsEntity {
 					Components::Transform* transform;
 					Components::Bounds* bounds;
 					Components::Physics* physics;
 					Components::Base* base;
+					//Set by the update when the transform has changed
+					bool changed = false;
 					PhysicsEntity(ECS::Coordinator* c, ECS::Entity entity) {
 						transform = &(c->GetComponent<Components::Transform>(entity));
 						base = &(c->GetComponent<Components::Base>(entity));
@@ -59,7 +67,8 @@ namespace HotBite {
 				reactphysics3d::PhysicsWorld* world = nullptr;
 				ECS::Coordinator* coordinator = nullptr;
 				ECS::Signature signature;
-				ECS::EntityVector<PhysicsEntity> physics;
+				//Stable storage, entity_by_body keeps pointers to the entries
+				ECS::EntityVector<PhysicsEntity, true> physics;
 				Core::spin_lock lock;
 				CollisionData contacts_by_body;
 				std::unordered_map<reactphysics3d::CollisionBody*, PhysicsEntity*> entity_by_body;
@@ -70,7 +79,9 @@ namespace HotBite {
 				void OnRegister(ECS::Coordinator* c) override;
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				void OnEntityDestroyed(ECS::Entity entity) override;
-				void Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t total_nsec, bool force);
+				std::vector<ECS::Signature> GetSignatures() const override;
+				//Returns true if the transform has changed, thread safe for different entities
+				bool Update(PhysicsEntity& pe, int64_t elapsed_nsec, int64_t total_nsec, bool force);
 				//reactphysics3d::CollisionCallback implementation
 				void onContact(const reactphysics3d::CollisionCallback::CallbackData& callbackData) override;
 				void onTrigger(const reactphysics3d::OverlapCallback::CallbackData& callbackData) override;
@@ -84,6 +95,11 @@ namespace HotBite {
 				//System methods
 				void Init(reactphysics3d::PhysicsWorld* w);
 				void Update(int64_t elapsed_nsec, int64_t total_nsec, bool force);
+				//Stores the body transforms as previous state, called before each fixed step
+				void SaveState();
+				//Rigid corrections from the transforms written by Update to the body transforms interpolated
+				//between the previous and the current fixed steps, only for the bodies that differ
+				void GetInterpolation(float alpha, std::unordered_map<ECS::Entity, matrix>& corrections);
 				reactphysics3d::PhysicsWorld* GetWorld();
 				std::unordered_set<ECS::Entity> GetContacts(ECS::Entity entity) const;
 				bool IsContact(ECS::Entity entity1, ECS::Entity entity2) const;
@@ -39,6 +39,10 @@ void PointLightSystem::OnRegister(ECS::Coordinator* c) {
 	signature.set(coordinator->GetComponentType<PointLight>(), true);
 }
 
+std::vector<Signature> PointLightSystem::GetSignatures() const {
+	return { signature };
+}
+
 void PointLightSystem::OnEntityDestroyed(ECS::Entity entity) {
 	lights.Remove(entity);
 }
@@ -57,13 +61,13 @@ void PointLightSystem::OnEntitySignatureChanged(ECS::Entity entity, const Signat
 
 void PointLightSystem::Update(PointLightEntity& entity, int64_t elapsed_nsec, int64_t total_nsec) {
 
-	//We only update view if invalid
-	float3 parent_position = {};
+	//We only update view if invalid or the parent has moved since the last update, a dirty parent
+	//was moved and has not been processed yet, or has no system processing it
+	bool parent_moved = false;
 	if (entity.base->parent != ECS::INVALID_ENTITY_ID) {
-		Components::Transform& t = coordinator->GetComponent<Components::Transform>(entity.base->parent);
-		parent_position = t.position;
+		parent_moved = moved.count(entity.base->parent) > 0 || coordinator->GetComponent<Transform>(entity.base->parent).dirty;
 	}
-	if ((entity.transform->dirty || entity.light->dirty || entity.transform->last_parent_position != parent_position)) {
+	if (entity.transform->dirty || entity.light->dirty || parent_moved) {
 		matrix lightProjection, positionMatrix, spotView, toShadow;
 		lightProjection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0, 0.1f, entity.light->data.range);
 		float3 worldPosition = entity.transform->position;
@@ -78,7 +82,6 @@ void PointLightSystem::Update(PointLightEntity& entity, int64_t elapsed_nsec, in
 			matrix pmatrix = r * t;
 			wpos = XMVector3Transform(wpos, pmatrix);
 			XMStoreFloat3(&worldPosition, wpos);			
-			entity.transform->last_parent_position = parent_position;
 		}
 		entity.light->data.position = worldPosition;
 		positionMatrix = XMMatrixTranslation(-worldPosition.x, -worldPosition.y, -worldPosition.z);
@@ -117,10 +120,16 @@ void PointLightSystem::Update(PointLightEntity& entity, int64_t elapsed_nsec, in
 			entity.transform->dirty = false;
 			entity.light->dirty = false;
 		}
+		coordinator->MarkComponentChanged<Transform>(entity.base->id);
 	}
 }
 
 void PointLightSystem::Update(int64_t elapsed_nsec, int64_t total_nsec) {
+	//Parents moved since the last update, the array version makes it free when nothing moved
+	uint64_t since = transforms_version;
+	transforms_version = coordinator->GetComponentsVersion<Transform>();
+	moved.clear();
+	coordinator->ForEachChanged<Transform>(since, [this](ECS::Entity e, Transform&) { moved.insert(e); });
 	for (auto it = lights.GetData().begin(); it != lights.GetData().end(); ++it)
 	{
 		Update(*it, elapsed_nsec, total_nsec);
@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <ECS\Coordinator.h>
 #include <ECS\EntityVector.h>
+#include <unordered_set>
 #include <Components\Base.h>
 #include <Components\Lights.h>
 #include <Components\Camera.h>
@@ -50,11 +51,15 @@ namespace HotBite {
 				ECS::Coordinator* coordinator = nullptr;
 				ECS::Signature signature;
 				ECS::EntityVector<PointLightEntity> lights;
+				//Transform version of the last update and the entities moved since then, children follow them
+				uint64_t transforms_version = 0;
+				std::unordered_set<ECS::Entity> moved;
 
 			public:
 				void OnRegister(ECS::Coordinator* c) override;
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				void OnEntityDestroyed(ECS::Entity entity) override;
+				std::vector<ECS::Signature> GetSignatures() const override;
 
 			public:
 				PointLightSystem() = default;
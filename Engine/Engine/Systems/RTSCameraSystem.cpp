@@ -58,6 +58,10 @@ void RTSCameraSystem::OnRegister(ECS::Coordinator* c) {
         std::bind(&RTSCameraSystem::OnZoomCheck, this, std::placeholders::_1));
 }
 
+std::vector<Signature> RTSCameraSystem::GetSignatures() const {
+	return { signature };
+}
+
 void RTSCameraSystem::RotateX(CameraSystem::CameraData& entity, float x)
 {
     entity.camera->rotation.x += x;
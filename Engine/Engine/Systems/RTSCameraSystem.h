@@ -123,6 +123,7 @@ namespace HotBite {
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				//Callback from coordinatir when an entity is destroyed
 				void OnEntityDestroyed(ECS::Entity entity) override;
+				std::vector<ECS::Signature> GetSignatures() const override;
 
 			public:
 				RTSCameraSystem() = default;
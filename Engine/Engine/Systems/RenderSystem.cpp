@@ -27,6 +27,7 @@ SOFTWARE.
 #include <Core/Vertex.h>
 #include <Core/SimpleShader.h>
 #include <Core/Utils.h>
+#include <Core/JobSystem.h>
 #include "RenderSystem.h"
 
 using namespace HotBite::Engine;
@@ -90,7 +91,7 @@ const std::string RenderSystem::LIGHT_TEXTURE = "lightTexture";
 const std::string RenderSystem::TESS_FACTOR = "tessFactor";
 const std::string RenderSystem::TESS_TYPE = "tessType";
 const std::string RenderSystem::DISPLACEMENT_SCALE = "displacementScale";
-std::recursive_mutex RenderSystem::mutex;
+ECS::WorldMutex RenderSystem::mutex;
 
 void RenderSystem::OnRegister(ECS::Coordinator* c) {
 	this->coordinator = c;
@@ -127,16 +128,20 @@ void RenderSystem::OnRegister(ECS::Coordinator* c) {
 	particles_signature.set(coordinator->GetComponentType<Particles>(), true);
 }
 
+const Core::SceneIndex& RenderSystem::GetSceneIndex() const {
+	return scene_index;
+}
+
+std::vector<Signature> RenderSystem::GetSignatures() const {
+	return { sky_signature, amblight_signature, dirlight_signature, plight_signature, camera_signature, particles_signature, drawable_signature };
+}
+
 void RenderSystem::OnEntityDestroyed(ECS::Entity entity) {
 	ambient_lights.Remove(entity);
 	point_lights.Remove(entity);
 	directional_lights.Remove(entity);
 	cameras.Remove(entity);
-
-	RemoveDrawable(entity, render_pass2_tree);
-	RemoveDrawable(entity, render_tree);
-	RemoveDrawable(entity, depth_tree);
-	RemoveDrawable(entity, shadow_tree);
+	drawables.Remove(entity);
 	RemoveParticle(entity, particle_tree);
 }
 
@@ -194,49 +199,26 @@ void RenderSystem::OnEntitySignatureChanged(ECS::Entity entity, const Signature&
 		RemoveParticle(entity, particle_tree);
 	}
 
-	bool is_pass1 = false;
-	bool is_pass2 = false;
-
-	//Entities including Sky component are rendered in a specific call, avoid adding to this map
+	//Entities including Sky component are rendered in a specific call, avoid adding them to the drawables
+	bool is_drawable = false;
 	if ((entity_signature & drawable_signature) == drawable_signature &&
 		(entity_signature & sky_signature) != sky_signature)
 	{
+		uint32_t pass = coordinator->GetComponent<Base>(entity).pass;
+		assert((pass == 1 || pass == 2) && "Invalid render pass");
+		is_drawable = (pass == 1 || pass == 2);
+	}
+	if (is_drawable) {
 		DrawableEntity drawable{ coordinator, entity };
 		MaterialData* mat = drawable.mat->data;
-		ShaderKey key{ mat->shaders.vs, mat->shaders.hs, mat->shaders.ds, mat->shaders.gs, mat->shaders.ps };
-		if (drawable.base->pass == 1) {
-			AddDrawable(entity, key, drawable.mat, render_tree, drawable);
-			ShaderKey depth_key{ mat->depth_shaders.vs, mat->depth_shaders.hs, mat->depth_shaders.ds, mat->depth_shaders.gs, mat->depth_shaders.ps };
-			AddDrawable(entity, depth_key, drawable.mat, depth_tree, drawable);
-			is_pass1 = true;
-		}
-		else if (drawable.base->pass == 2) {
-			AddDrawable(entity, key, drawable.mat, render_pass2_tree, drawable);
-			is_pass2 = true;
-		}
-		else {
-			assert("Invalid render pass");
-		}
-		if (is_pass1 || is_pass2) {
-			ShaderKey shadow_key{ mat->shadow_shaders.vs, mat->shadow_shaders.hs, mat->shadow_shaders.ds, mat->shadow_shaders.gs, mat->shadow_shaders.ps };
-			AddDrawable(entity, shadow_key, drawable.mat, shadow_tree, drawable);
-		}
-		if (!is_pass2) {
-			RemoveDrawable(entity, render_pass2_tree);
-		}
-		if (!is_pass1) {
-			RemoveDrawable(entity, render_tree);
-			RemoveDrawable(entity, depth_tree);
-		}
-		if (!is_pass1 && !is_pass2) {
-			RemoveDrawable(entity, shadow_tree);
-		}
+		drawable.shader_id = GetShaderId(ShaderKey{ mat->shaders.vs, mat->shaders.hs, mat->shaders.ds, mat->shaders.gs, mat->shaders.ps });
+		drawable.depth_shader_id = GetShaderId(ShaderKey{ mat->depth_shaders.vs, mat->depth_shaders.hs, mat->depth_shaders.ds, mat->depth_shaders.gs, mat->depth_shaders.ps });
+		drawable.shadow_shader_id = GetShaderId(ShaderKey{ mat->shadow_shaders.vs, mat->shadow_shaders.hs, mat->shadow_shaders.ds, mat->shadow_shaders.gs, mat->shadow_shaders.ps });
+		drawable.material_id = GetMaterialId(mat);
+		drawables.Insert(entity, drawable);
 	}
 	else {
-		RemoveDrawable(entity, render_pass2_tree);
-		RemoveDrawable(entity, render_tree);
-		RemoveDrawable(entity, depth_tree);
-		RemoveDrawable(entity, shadow_tree);
+		drawables.Remove(entity);
 	}
 }
 
@@ -560,16 +542,71 @@ void RenderSystem::LoadRTResources() {
 	ResetRTBBuffers();
 }
 
-void RenderSystem::AddDrawable(ECS::Entity entity, const Core::ShaderKey& key, Components::Material* mat, RenderTree& tree, const RenderSystem::DrawableEntity& drawable) {
-	tree[key][mat->data].second.Insert(entity, drawable);
-	tree[key][mat->data].first = mat;
-	for (auto shader_it = tree.begin(); shader_it != tree.end(); ++shader_it) {
-		for (auto mat_it = shader_it->second.begin(); mat_it != shader_it->second.end(); ++mat_it) {
-			if (mat_it->first != mat->data) {
-				mat_it->second.second.Remove(entity);
+uint16_t RenderSystem::GetShaderId(const Core::ShaderKey& key) {
+	auto it = shader_ids.find(key);
+	if (it != shader_ids.end()) {
+		return it->second;
+	}
+	assert(shader_keys.size() < DrawList::MAX_SHADERS && "Too many shader combinations");
+	uint16_t id = (uint16_t)shader_keys.size();
+	shader_keys.push_back(key);
+	shader_ids[key] = id;
+	return id;
+}
+
+uint16_t RenderSystem::GetMaterialId(Core::MaterialData* material) {
+	auto it = material_ids.find(material);
+	if (it != material_ids.end()) {
+		return it->second;
+	}
+	assert(material_ids.size() < DrawList::MAX_MATERIALS && "Too many materials");
+	uint16_t id = (uint16_t)material_ids.size();
+	material_ids[material] = id;
+	return id;
+}
+
+Core::TBVH::Stats RenderSystem::GetRTStats() {
+	std::lock_guard<std::mutex> lock(rt_mutex);
+	return tbvh.GetStats();
+}
+
+bool RenderSystem::HasSecondPass() const {
+	return std::any_of(drawables.begin(), drawables.end(), [](const DrawableEntity& de) { return de.base->pass == 2; });
+}
+
+void RenderSystem::BuildDrawList(const float3& camera_position) {
+	//Every drawable has one slot per pass it can be drawn in (shadow, depth and scene),
+	//the slots are filled in parallel and the unused ones are dropped by the sort
+	static constexpr size_t SLOTS = 3;
+	const std::vector<DrawableState>& states = snapshot.Read().drawables;
+	draw_list.Reset(states.size() * SLOTS);
+	JobSystem::ParallelFor(0, states.size(), [this, &states, &camera_position](size_t i) {
+		const DrawableState& state = states[i];
+		if (!state.visible) {
+			return;
+		}
+		uint32_t index = (uint32_t)i;
+		uint32_t flags = state.material->props.flags;
+		if (state.cast_shadow) {
+			draw_list[i * SLOTS] = { DrawList::MakeKey(DRAW_PASS_SHADOW, state.shadow_shader_id, state.material_id, 0.0f), index };
+		}
+		if (state.scene_visible) {
+			float3 d = SUB_F3_F3(state.final_box.Center, camera_position);
+			float depth = d.x * d.x + d.y * d.y + d.z * d.z;
+			bool blend = (flags & (ALPHA_ENABLED_FLAG | BLEND_ENABLED_FLAG)) != 0;
+			if (state.pass == 1) {
+				if (!blend && state.draw_depth) {
+					draw_list[i * SLOTS + 1] = { DrawList::MakeKey(DRAW_PASS_DEPTH, state.depth_shader_id, state.material_id, depth), index };
+				}
+				//Opaque drawables front to back, blended ones after them and back to front
+				draw_list[i * SLOTS + 2] = { DrawList::MakeKey(DRAW_PASS_SCENE, state.shader_id, state.material_id, depth, blend), index };
+			}
+			else {
+				draw_list[i * SLOTS + 2] = { DrawList::MakeKey(DRAW_PASS_SCENE2, state.shader_id, state.material_id, depth, blend), index };
 			}
 		}
-	}
+		});
+	draw_list.Sort();
 }
 
 void RenderSystem::AddParticle(ECS::Entity entity, const Core::ShaderKey& key, Core::MaterialData* mat, RenderParticleTree& tree, const RenderSystem::ParticleEntity& particle) {
@@ -595,29 +632,12 @@ void RenderSystem::RemoveParticle(ECS::Entity entity, RenderParticleTree& tree)
 	}
 }
 
-void RenderSystem::RemoveDrawable(ECS::Entity entity, RenderTree& tree) {
-	std::unordered_map < Core::ShaderKey, std::list<std::unordered_map<Core::MaterialData*,
-		std::pair<Components::Material*, ECS::EntityVector<DrawableEntity > > >::iterator>> to_remove;
-	for (auto shader_it = tree.begin(); shader_it != tree.end(); ++shader_it) {
-		for (auto mat_it = shader_it->second.begin(); mat_it != shader_it->second.end(); ++mat_it) {
-			mat_it->second.second.Remove(entity);
-			if (mat_it->second.second.GetData().empty()) {
-				to_remove[shader_it->first].push_back(mat_it);
-			}
-		}
-	}
-	for (auto const& shader : to_remove) {
-		for (auto const& mat_it : shader.second) {
-			tree[shader.first].erase(mat_it);
-		}
-	}
-}
-
 void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection) {
 
 	ID3D11DeviceContext* context = dxcore->context;
-	assert(!cameras.GetData().empty() && "No cameras found");
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	const RenderSnapshot& s = snapshot.Read();
+	assert(s.has_camera && "No cameras found");
+	const Components::Camera& camera = s.camera.camera;
 	
 	SimpleVertexShader* vs = nullptr;
 	SimpleHullShader* hs = nullptr;
@@ -631,28 +651,26 @@ void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const
 	context->RSSetViewports(1, &dxcore->viewport);
 	context->RSSetState(dxcore->drawing_rasterizer);
 
-	SkyEntity* sky = nullptr;
-	if (!skies.GetData().empty()) {
-		sky = &(skies.GetData()[0]);
-	}
-
 	float time = (float)Scheduler::Get()->GetElapsedNanoSeconds() / 1000000000.0f;
-	for (auto &shaders: depth_tree) {
+	std::span<const DrawList::Command> commands = draw_list.GetCommands(DRAW_PASS_DEPTH);
+	for (size_t i = 0; i < commands.size();) {
+		uint32_t shader_id = DrawList::GetShader(commands[i].key);
+		const ShaderKey& shader_key = s.shader_keys[shader_id];
 
-		SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shaders.first);
+		SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shader_key);
 		if (vs != new_vs) {
 			vs = new_vs;
 			if (vs) {
-				vs->SetMatrix4x4(VIEW, cam_entity.camera->view);
+				vs->SetMatrix4x4(VIEW, camera.view);
 				vs->SetFloat(TIME, time);
-				vs->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
+				vs->SetMatrix4x4(PROJECTION, camera.projection);
 				vs->SetShader();
 			}
 			else {
 				context->VSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shaders.first);
+		SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shader_key);
 		if (hs != new_hs) {
 			hs = new_hs;
 			if (hs) {
@@ -663,7 +681,7 @@ void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const
 				context->HSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shaders.first);
+		SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shader_key);
 		if (ds != new_ds) {
 			ds = new_ds;
 			if (ds) {
@@ -674,7 +692,7 @@ void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const
 				context->DSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shaders.first);
+		SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shader_key);
 		if (gs != new_gs) {
 			if (gs) {
 				gs->SetShaderResourceView(DEPTH_TEXTURE, nullptr);
@@ -688,11 +706,11 @@ void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const
 				context->GSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shaders.first);
+		SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shader_key);
 		if (ps != new_ps) {
 			ps = new_ps;
 			if (ps) {
-				ps->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+				ps->SetFloat3(CAMERA_POSITION, camera.world_position);
 				ps->SetFloat(TIME, time);
 				ps->SetShader();
 			}
@@ -704,17 +722,12 @@ void RenderSystem::DrawDepth(int w, int h, const float3& camera_position, const
 		Event e(this, EVENT_ID_DEPTH_PREPARE_SHADER);
 		e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, sk);
 		coordinator->SendEvent(e);
-		for (auto &mat: shaders.second) {
-			if (!(mat.first->props.flags & (ALPHA_ENABLED_FLAG | BLEND_ENABLED_FLAG))) {
-				for (auto &de : mat.second.second.GetData()) {
-					if (de.base->visible && de.base->draw_depth) {
-						PrepareEntity(de, vs, hs, ds, gs, ps);
-						Mesh* mesh = de.mesh;						
-						DXCore::Get()->context->DrawIndexed((UINT)mesh->index_count, (UINT)mesh->index_offset, (INT)mesh->vertex_offset);						
-						UnprepareEntity(de, vs, hs, ds, gs, ps);
-					}
-				}
-			}
+		//Blended and culled drawables are not in the depth pass
+		for (; i < commands.size() && DrawList::GetShader(commands[i].key) == shader_id; ++i) {
+			const DrawableState& de = s.drawables[commands[i].index];
+			PrepareEntity(de, vs, hs, ds, gs, ps);
+			DXCore::Get()->context->DrawIndexed((UINT)de.index_count, (UINT)de.index_offset, (INT)de.vertex_offset);
+			UnprepareEntity(de, vs, hs, ds, gs, ps);
 		}
 		e.SetType(EVENT_ID_DEPTH_UNPREPARE_SHADER);
 		coordinator->SendEvent(e);
@@ -725,7 +738,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 
 	ID3D11DeviceContext* context = dxcore->context;
 	context->PSSetShader(nullptr, 0, 0);
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	const RenderSnapshot& s = snapshot.Read();
 
 	SimpleVertexShader* vs = nullptr;
 	SimpleHullShader* hs = nullptr;
@@ -735,22 +748,42 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 	float time = (float)Scheduler::Get()->GetElapsedNanoSeconds() / 1000000000.0f;
 
 	if (!static_shadows) {
-		for (PointLightEntity& l : point_lights.GetData()) {
-			if (l.light->CastShadow()) {
+		for (const PointLightState& l : s.point_lights) {
+			if (l.cast_shadow) {
 				//Render to depth texture					
 				ID3D11RenderTargetView* rtv[1] = { nullptr };
-				context->OMSetRenderTargets(1, rtv, l.light->DepthView());
+				context->OMSetRenderTargets(1, rtv, l.depth_view.Get());
 				context->ClearDepthStencilView(
-					l.light->DepthView(),
+					l.depth_view.Get(),
 					D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
 					1.0f, 0);
-				context->RSSetViewports(1, &l.light->GetShadowViewPort());
+				context->RSSetViewports(1, &l.shadow_vp);
 				context->RSSetState(dxcore->shadow_rasterizer);
-				float range_p2 = l.light->GetData().range * l.light->GetData().range;
-
-
-				for (auto& shaders : shadow_tree) {
-					SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shaders.first);
+				//Only the shadow casters in the light range are drawn, the scene index gives them
+				//without walking the whole shadow pass, sorted by shader and material as the draw list
+				light_commands.clear();
+				scene_index.QuerySphere(l.data.position, l.data.range, [this, &s](SceneIndex::Key key) {
+					if (key >= snapshot_index.size() || snapshot_index[key] < 0) {
+						return;
+					}
+					uint32_t index = (uint32_t)snapshot_index[key];
+					const DrawableState& de = s.drawables[index];
+					if (de.visible && de.cast_shadow) {
+						light_commands.push_back({ DrawList::MakeKey(DRAW_PASS_SHADOW, de.shadow_shader_id, de.material_id, 0.0f), index });
+					}
+					});
+				if (light_commands.empty()) {
+					continue;
+				}
+				std::sort(light_commands.begin(), light_commands.end(), [](const DrawList::Command& a, const DrawList::Command& b) {
+					return a.key < b.key;
+					});
+
+				std::span<const DrawList::Command> commands = light_commands;
+				for (size_t i = 0; i < commands.size();) {
+					uint32_t shader_id = DrawList::GetShader(commands[i].key);
+					const ShaderKey& shader_key = s.shader_keys[shader_id];
+					SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shader_key);
 					if (vs != new_vs) {
 						vs = new_vs;
 						if (vs) {
@@ -761,7 +794,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 							context->VSSetShader(nullptr, nullptr, 0);
 						}
 					}
-					SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shaders.first);
+					SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shader_key);
 					if (hs != new_hs) {
 						hs = new_hs;
 						if (hs) {
@@ -772,7 +805,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 							context->HSSetShader(nullptr, nullptr, 0);
 						}
 					}
-					SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shaders.first);
+					SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shader_key);
 					if (ds != new_ds) {
 						ds = new_ds;
 						if (ds) {
@@ -783,7 +816,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 							context->DSSetShader(nullptr, nullptr, 0);
 						}
 					}
-					SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shaders.first);
+					SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shader_key);
 					if (gs != new_gs) {
 						gs = new_gs;
 						if (gs) {
@@ -795,7 +828,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 					}
 
 					if (gs) {
-						const float4x4* viewProj = l.light->GetViewMatrix();
+						const float4x4* viewProj = l.view;
 						gs->SetInt(ACTIVE_VIEWS, 0x3F);
 						gs->SetFloat(TIME, time);
 						gs->SetMatrix4x4(CUBE_VIEW_0, viewProj[0]);
@@ -807,7 +840,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 						gs->CopyAllBufferData();
 					}
 
-					SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shaders.first);
+					SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shader_key);
 					if (ps != new_ps) {
 						ps = new_ps;
 						if (ps) {
@@ -821,15 +854,11 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 					Event e(this, EVENT_ID_SHADOW_POINT_LIGHT_PREPARE_SHADER);
 					e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, sk);
 					coordinator->SendEvent(e);
-					for (auto& mat : shaders.second) {
-						for (DrawableEntity& de : mat.second.second.GetData()) {
-							if (de.base->visible && de.base->cast_shadow && DIST2((l.light->GetData().position - de.transform->position)) < range_p2) {
-								PrepareEntity(de, vs, hs, ds, gs, ps);
-								Mesh* mesh = de.mesh;
-								DXCore::Get()->context->DrawIndexed((UINT)mesh->index_count, (UINT)mesh->index_offset, (INT)mesh->vertex_offset);
-								UnprepareEntity(de, vs, hs, ds, gs, ps);
-							}
-						}
+					for (; i < commands.size() && DrawList::GetShader(commands[i].key) == shader_id; ++i) {
+						const DrawableState& de = s.drawables[commands[i].index];
+						PrepareEntity(de, vs, hs, ds, gs, ps);
+						DXCore::Get()->context->DrawIndexed((UINT)de.index_count, (UINT)de.index_offset, (INT)de.vertex_offset);
+						UnprepareEntity(de, vs, hs, ds, gs, ps);
 					}
 					e.SetType(EVENT_ID_SHADOW_POINT_LIGHT_UNPREPARE_SHADER);
 					coordinator->SendEvent(e);
@@ -838,28 +867,30 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 		}
 	}
 	
-	for (DirectionalLightEntity& l : directional_lights.GetData()) {
-		if (l.light->CastShadow()) {
-			//Render to depth texture
+	for (const DirectionalLightState& l : s.dir_lights) {
+		if (l.cast_shadow) {
+			//Render to depth texture, static shadows are refreshed from the current light view
 			ID3D11RenderTargetView* rtv[1] = { nullptr };
 			ID3D11DepthStencilView* dv = nullptr;
 			if (static_shadows) {
-				l.light->RefreshStaticViewMatrix();
-				dv = l.light->StaticDepthView();
+				dv = l.static_depth_view.Get();
 			}
 			else {
-				dv = l.light->DepthView();
+				dv = l.depth_view.Get();
 			}
 			context->ClearDepthStencilView(
 				dv,
 				D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
 				1.0f, 0);
 			context->OMSetRenderTargets(1, rtv, dv);
-			context->RSSetViewports(1, &l.light->GetShadowViewPort());
+			context->RSSetViewports(1, &l.shadow_vp);
 			context->RSSetState(dxcore->dir_shadow_rasterizer);
 			
-			for (auto &shaders: shadow_tree) {
-				SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shaders.first);
+			std::span<const DrawList::Command> commands = draw_list.GetCommands(DRAW_PASS_SHADOW);
+			for (size_t i = 0; i < commands.size();) {
+				uint32_t shader_id = DrawList::GetShader(commands[i].key);
+				const ShaderKey& shader_key = s.shader_keys[shader_id];
+				SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shader_key);
 				if (vs != new_vs) {
 					vs = new_vs;
 					if (vs) {
@@ -870,7 +901,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 						context->VSSetShader(nullptr, nullptr, 0);
 					}
 				}
-				SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shaders.first);
+				SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shader_key);
 				if (hs != new_hs) {
 					hs = new_hs;
 					if (hs) {
@@ -881,7 +912,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 						context->HSSetShader(nullptr, nullptr, 0);
 					}
 				}
-				SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shaders.first);
+				SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shader_key);
 				if (ds != new_ds) {
 					ds = new_ds;
 					if (ds) {
@@ -892,7 +923,7 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 						context->DSSetShader(nullptr, nullptr, 0);
 					}
 				}
-				SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shaders.first);
+				SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shader_key);
 				if (gs != new_gs) {
 					gs = new_gs;
 					if (gs) {
@@ -906,11 +937,11 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 				if (gs) {
 					gs->SetFloat(TIME, time);
 					gs->SetInt(ACTIVE_VIEWS, 0x01);
-					gs->SetMatrix4x4(CUBE_VIEW_0, *l.light->GetViewMatrix());
+					gs->SetMatrix4x4(CUBE_VIEW_0, l.view);
 					gs->CopyAllBufferData();
 				}
 
-				SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shaders.first);
+				SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shader_key);
 				if (ps != new_ps) {
 					ps = new_ps;
 					if (ps) {
@@ -926,16 +957,14 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 				e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, sk);
 				coordinator->SendEvent(e);
 
-				for (auto &mat: shaders.second) {
-					for (auto& de: mat.second.second.GetData()) {
-						if (de.base->visible && de.base->cast_shadow && !l.light->IsSkipEntity(de.base->id) &&
-							//we paint static objects if static_shadows = true || dynamic objects if static_shadows = false
-							((!static_shadows && !de.base->is_static) || (static_shadows && de.base->is_static))) {
-							PrepareEntity(de, vs, hs, ds, gs, ps);
-							Mesh* mesh = de.mesh;
-							DXCore::Get()->context->DrawIndexed((UINT)mesh->index_count, (UINT)mesh->index_offset, (INT)mesh->vertex_offset);						
-							UnprepareEntity(de, vs, hs, ds, gs, ps);
-						}
+				for (; i < commands.size() && DrawList::GetShader(commands[i].key) == shader_id; ++i) {
+					const DrawableState& de = s.drawables[commands[i].index];
+					if (!std::binary_search(l.skip.begin(), l.skip.end(), de.handle.id) &&
+						//we paint static objects if static_shadows = true || dynamic objects if static_shadows = false
+						((!static_shadows && !de.is_static) || (static_shadows && de.is_static))) {
+						PrepareEntity(de, vs, hs, ds, gs, ps);
+						DXCore::Get()->context->DrawIndexed((UINT)de.index_count, (UINT)de.index_offset, (INT)de.vertex_offset);
+						UnprepareEntity(de, vs, hs, ds, gs, ps);
 					}
 				}
 				e.SetType(EVENT_ID_SHADOW_DIR_LIGHT_UNPREPARE_SHADER);
@@ -948,17 +977,17 @@ void RenderSystem::CastShadows(int w, int h, const float3& camera_position, cons
 
 void RenderSystem::DrawSky(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection) {
 	
-	if (skies.GetData().empty()) {
+	const RenderSnapshot& s = snapshot.Read();
+	if (!s.has_sky) {
 		return;
 	}
 
-	assert(skies.GetData().size() == 1 && "More than one sky registered.");
-	SkyEntity& sky = skies.GetData()[0];
-	assert(!cameras.GetData().empty() && "No cameras found");
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	const SkyState& sky = s.sky;
+	assert(s.has_camera && "No cameras found");
+	const Components::Camera& camera = s.camera.camera;
 	ID3D11DeviceContext* context = dxcore->context;
 
-	float time = ((float)Scheduler::Get()->GetElapsedNanoSeconds() * sky.sky->second_speed) / 1000000000.0f;
+	float time = ((float)Scheduler::Get()->GetElapsedNanoSeconds() * sky.second_speed) / 1000000000.0f;
 	//Render sky background
 	{
 		ID3D11RenderTargetView* rv[2] = { first_pass_target->RenderTarget(), current_light_map->RenderTarget() };
@@ -967,8 +996,8 @@ void RenderSystem::DrawSky(int w, int h, const float3& camera_position, const ma
 		context->RSSetViewports(1, &dxcore->viewport);
 		context->RSSetState(dxcore->sky_rasterizer);
 
-		SimpleVertexShader* vs = sky.mat->data->shaders.vs;
-		SimplePixelShader* ps = sky.mat->data->shaders.ps;
+		SimpleVertexShader* vs = sky.drawable.material->shaders.vs;
+		SimplePixelShader* ps = sky.drawable.material->shaders.ps;
 		assert(vs != nullptr && "Sky with no vertex shader.");
 		assert(ps != nullptr && "Sky with no pixel shader.");
 		vs->SetShader();
@@ -977,70 +1006,53 @@ void RenderSystem::DrawSky(int w, int h, const float3& camera_position, const ma
 		context->HSSetShader(nullptr, nullptr, 0);
 		context->DSSetShader(nullptr, nullptr, 0);
 
-		vs->SetMatrix4x4(VIEW, cam_entity.camera->view);
-		vs->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-		vs->SetMatrix4x4(WORLD, sky.transform->world_matrix);
+		vs->SetMatrix4x4(VIEW, camera.view);
+		vs->SetMatrix4x4(PROJECTION, camera.projection);
+		vs->SetMatrix4x4(WORLD, sky.drawable.world_matrix);
 
 		ps->SetInt(SCREEN_W, w);
 		ps->SetInt(SCREEN_H, h);
-		ps->SetMatrix4x4(VIEW, cam_entity.camera->view);
-		ps->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-		ps->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		ps->SetMatrix4x4(VIEW, camera.view);
+		ps->SetMatrix4x4(PROJECTION, camera.projection);
+		ps->SetFloat3(CAMERA_POSITION, camera.world_position);
 		ps->SetSamplerState(PCF_SAMPLER, dxcore->shadow_sampler);
 		ps->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
 		ps->SetShaderResourceView(DEPTH_TEXTURE, depth_map.SRV());
 		ps->SetFloat(TIME, time);
-		ps->SetFloat3("back_color", sky.sky->current_backcolor);
-		float space_intensity = 1.0f - directional_lights.GetData()[0].light->GetData().intensity;
+		ps->SetFloat3("back_color", sky.current_backcolor);
+		float space_intensity = s.dir_lights.empty() ? 0.0f : 1.0f - s.dir_lights[0].data.intensity;
 		ps->SetFloat("space_intensity", space_intensity);
-		if (sky.sky->space_mesh != nullptr && sky.sky->space_material != nullptr && space_intensity > 0.0f) {
-			PrepareMaterial(sky.sky->space_material, vs, nullptr, nullptr, nullptr, ps);
+		if (sky.space_mesh != nullptr && sky.space_material != nullptr && space_intensity > 0.0f) {
+			PrepareMaterial(sky.space_material, vs, nullptr, nullptr, nullptr, ps);
 			ps->SetInt(SimpleShaderKeys::IS_SPACE, 1);
 			vs->SetInt(SimpleShaderKeys::IS_SPACE, 1);
 			
 			vs->CopyAllBufferData();
 			ps->CopyAllBufferData();
-			DXCore::Get()->context->DrawIndexed((UINT)sky.sky->space_mesh->indexCount, (UINT)sky.sky->space_mesh->indexOffset, (INT)sky.sky->space_mesh->vertexOffset);
+			DXCore::Get()->context->DrawIndexed((UINT)sky.space_mesh->indexCount, (UINT)sky.space_mesh->indexOffset, (INT)sky.space_mesh->vertexOffset);
 			
-			UnprepareMaterial(sky.sky->space_material, vs, nullptr, nullptr, nullptr, ps);
+			UnprepareMaterial(sky.space_material, vs, nullptr, nullptr, nullptr, ps);
 		}
 		vs->SetInt(SimpleShaderKeys::IS_SPACE, 0);
 		ps->SetInt(SimpleShaderKeys::IS_SPACE, 0);
 		ps->SetInt(SimpleShaderKeys::CLOUD_TEST, cloud_test);
-		ps->SetFloat("cloud_density", sky.sky->cloud_density);
-		ps->SetMatrix4x4("spot_view", sky.sky->dir_light->GetSpotMatrix());
-		SetEntityLights(&scene_lighting, directional_lights, point_lights);
+		ps->SetFloat("cloud_density", sky.cloud_density);
+		ps->SetMatrix4x4("spot_view", sky.spot_view);
 		PrepareLights(vs, nullptr, nullptr, nullptr, ps);
-		PrepareMaterial(sky.mat->data, vs, nullptr, nullptr, nullptr, ps);
-		PrepareEntity(sky, vs, nullptr, nullptr, nullptr, ps);
+		PrepareMaterial(sky.drawable.material, vs, nullptr, nullptr, nullptr, ps);
+		PrepareEntity(sky.drawable, vs, nullptr, nullptr, nullptr, ps);
 		
 		vs->CopyAllBufferData();
 		ps->CopyAllBufferData();
-		Mesh* mesh = sky.mesh;
-		DXCore::Get()->context->DrawIndexed((UINT)mesh->index_count, (UINT)mesh->index_offset, (INT)mesh->vertex_offset);		
-		UnprepareEntity(sky, vs, nullptr, nullptr, nullptr, ps);
-		UnprepareMaterial(sky.mat->data, vs, nullptr, nullptr, nullptr, ps);
+		DXCore::Get()->context->DrawIndexed((UINT)sky.drawable.index_count, (UINT)sky.drawable.index_offset, (INT)sky.drawable.vertex_offset);		
+		UnprepareEntity(sky.drawable, vs, nullptr, nullptr, nullptr, ps);
+		UnprepareMaterial(sky.drawable.material, vs, nullptr, nullptr, nullptr, ps);
 		UnprepareLights(vs, nullptr, nullptr, nullptr, ps);
 		ps->SetShaderResourceView(DEPTH_TEXTURE, nullptr);
 		context->OMSetBlendState(dxcore->no_blend, NULL, ~0U);
 	}
 }
 
-void RenderSystem::CheckSceneVisibility(RenderTree& tree) {
-	CameraEntity& cam_entity = cameras.GetData()[0];
-	DXCore* dxcore = DXCore::Get();
-	int w = dxcore->GetWidth();
-	int h = dxcore->GetHeight();
-
-	for (auto& shaders : tree) {
-		for (auto& mat : shaders.second) {
-			for (auto& de : mat.second.second.GetData()) {
-				de.base->scene_visible = IsVisible(cam_entity.camera->world_position, de, cam_entity.camera->xm_view_projection, w, h);
-			}
-		}
-	}
-}
-
 void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection, RenderParticleTree& tree) {
 
 	ID3D11DeviceContext* context = dxcore->context;
@@ -1057,8 +1069,8 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 	SimplePixelShader* ps = nullptr;
 	SimpleGeometryShader* gs = nullptr;
 
-	assert(!cameras.GetData().empty() && "No cameras found");
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	assert(snapshot.Read().has_camera && "No cameras found");
+	const Components::Camera& camera = snapshot.Read().camera.camera;
 
 	context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
 	float time = (float)Scheduler::Get()->GetElapsedNanoSeconds() / 1000000000.0f;
@@ -1071,8 +1083,8 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 		if (vs != new_vs) {
 			vs = new_vs;
 			if (vs) {
-				vs->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-				vs->SetFloat3(CAMERA_DIRECTION, cam_entity.camera->direction);
+				vs->SetFloat3(CAMERA_POSITION, camera.world_position);
+				vs->SetFloat3(CAMERA_DIRECTION, camera.direction);
 				vs->SetInt(TESS_ENABLED, this->tess_enabled);
 				vs->SetFloat(TIME, time);
 				vs->SetShader();
@@ -1098,8 +1110,8 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 			if (ds) {
 				ds->SetFloat(TIME, time);
 				ds->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
-				ds->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				ds->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
+				ds->SetMatrix4x4(VIEW, camera.view);
+				ds->SetMatrix4x4(PROJECTION, camera.projection);
 				ds->SetShader();
 			}
 			else {
@@ -1119,9 +1131,9 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 				gs->SetShaderResourceView(DEPTH_TEXTURE, depth_map.SRV());
 				gs->SetInt(SCREEN_W, w);
 				gs->SetInt(SCREEN_H, h);
-				gs->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-				gs->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				gs->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
+				gs->SetFloat3(CAMERA_POSITION, camera.world_position);
+				gs->SetMatrix4x4(VIEW, camera.view);
+				gs->SetMatrix4x4(PROJECTION, camera.projection);
 				gs->SetFloat(TIME, time);
 				gs->SetShader();
 				gs->CopyAllBufferData();
@@ -1141,9 +1153,9 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 				ps->SetFloat(TIME, time);
 				ps->SetInt(SCREEN_W, w);
 				ps->SetInt(SCREEN_H, h);
-				ps->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				ps->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-				ps->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+				ps->SetMatrix4x4(VIEW, camera.view);
+				ps->SetMatrix4x4(PROJECTION, camera.projection);
+				ps->SetFloat3(CAMERA_POSITION, camera.world_position);
 				ps->SetSamplerState(PCF_SAMPLER, dxcore->shadow_sampler);
 				ps->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
 				ps->SetShaderResourceView(DEPTH_TEXTURE, depth_map.SRV());				
@@ -1157,7 +1169,6 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 		Event e(this, EVENT_ID_PREPARE_SHADER);
 		e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, sk);
 		coordinator->SendEvent(e);
-		SetEntityLights(&scene_lighting, directional_lights, point_lights);
 		PrepareLights(vs, hs, ds, gs, ps);
 		for (auto& mat : shaders.second) {
 			if (!mat.second.second.GetData().empty()) {
@@ -1201,9 +1212,8 @@ void RenderSystem::DrawParticles(int w, int h, const float3& camera_position, co
 
 
 void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection,
-	                         ID3D11ShaderResourceView* prev_pass_texture, Core::IRenderTarget* target, RenderTree& tree) {
+	                         ID3D11ShaderResourceView* prev_pass_texture, Core::IRenderTarget* target, uint32_t pass) {
 	int draw_count = 0;
-	int total_count = 0;
 	ID3D11DeviceContext* context = dxcore->context;
 	//Render scene to target texture, can be the final backbuffer render
 	//or a post process texture pipeline
@@ -1256,11 +1266,12 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 		context->RSSetState(dxcore->drawing_rasterizer);
 	}
 
+	const RenderSnapshot& s = snapshot.Read();
 	float speed = 1.0f;
-	SkyEntity* sky = nullptr;
-	if (!skies.GetData().empty()) {
-		sky = &(skies.GetData()[0]);
-		speed = sky->sky->second_speed;
+	const SkyState* sky = nullptr;
+	if (s.has_sky) {
+		sky = &s.sky;
+		speed = sky->second_speed;
 	}
 
 	SimpleVertexShader* vs = nullptr; 
@@ -1269,19 +1280,22 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 	SimplePixelShader* ps = nullptr; 
 	SimpleGeometryShader* gs = nullptr; 
 
-	assert(!cameras.GetData().empty() && "No cameras found");
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	assert(s.has_camera && "No cameras found");
+	const Components::Camera& camera = s.camera.camera;
 	time = ((float)Scheduler::Get()->GetElapsedNanoSeconds() * speed) / 1000000000.0f;
 
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	for (auto &shaders : tree) {
+	std::span<const DrawList::Command> commands = draw_list.GetCommands(pass);
+	for (size_t i = 0; i < commands.size();) {
+		uint32_t shader_id = DrawList::GetShader(commands[i].key);
+		const ShaderKey& shader_key = s.shader_keys[shader_id];
 
-		SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shaders.first);
+		SimpleVertexShader* new_vs = std::get<SHADER_KEY_VS>(shader_key);
 		if (vs != new_vs) {
 			vs = new_vs;
 			if (vs) {
-				vs->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-				vs->SetFloat3(CAMERA_DIRECTION, cam_entity.camera->direction);
+				vs->SetFloat3(CAMERA_POSITION, camera.world_position);
+				vs->SetFloat3(CAMERA_DIRECTION, camera.direction);
 				vs->SetInt(TESS_ENABLED, this->tess_enabled);
 				vs->SetFloat(TIME, time);
 				vs->SetShader();
@@ -1290,7 +1304,7 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 				context->VSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shaders.first);
+		SimpleHullShader* new_hs = std::get<SHADER_KEY_HS>(shader_key);
 		if (hs != new_hs) {
 			hs = new_hs;
 			if (hs) {
@@ -1301,22 +1315,22 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 				context->HSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shaders.first);
+		SimpleDomainShader* new_ds = std::get<SHADER_KEY_DS>(shader_key);
 		if (ds != new_ds) {
 			ds = new_ds;
 			if (ds) {
 				ds->SetFloat(TIME, time);
 				ds->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
-				ds->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				ds->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				ds->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
+				ds->SetMatrix4x4(VIEW, camera.view);
+				ds->SetMatrix4x4(VIEW, camera.view);
+				ds->SetMatrix4x4(PROJECTION, camera.projection);
 				ds->SetShader();
 			}
 			else {
 				context->DSSetShader(nullptr, nullptr, 0);
 			}
 		}
-		SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shaders.first);
+		SimpleGeometryShader* new_gs = std::get<SHADER_KEY_GS>(shader_key);
 		if (gs != new_gs) {
 			if (gs) {
 				gs->SetShaderResourceView(DEPTH_TEXTURE, nullptr);
@@ -1329,8 +1343,8 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 				gs->SetShaderResourceView(DEPTH_TEXTURE, depth_map.SRV());
 				gs->SetInt(SCREEN_W, w);
 				gs->SetInt(SCREEN_H, h);
-				gs->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-				gs->SetMatrix4x4("view_projection", cam_entity.camera->view_projection);
+				gs->SetFloat3(CAMERA_POSITION, camera.world_position);
+				gs->SetMatrix4x4("view_projection", camera.view_projection);
 				gs->SetFloat(TIME, time);
 				gs->SetShader();
 			}
@@ -1339,7 +1353,7 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 			}
 		}
 
-		SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shaders.first);
+		SimplePixelShader* new_ps = std::get<SHADER_KEY_PS>(shader_key);
 		if (ps != new_ps) {
 			if (ps) {
 				ps->SetShaderResourceView(DEPTH_TEXTURE, nullptr);
@@ -1350,13 +1364,13 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 			ps = new_ps;
 			if (ps) {
 				float3 dir;
-				XMStoreFloat3(&dir, cam_entity.camera->xm_direction);
+				XMStoreFloat3(&dir, camera.xm_direction);
 				ps->SetFloat(TIME, time);
 				ps->SetInt(SCREEN_W, w);
 				ps->SetInt(SCREEN_H, h);
-				ps->SetMatrix4x4(VIEW, cam_entity.camera->view);
-				ps->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-				ps->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+				ps->SetMatrix4x4(VIEW, camera.view);
+				ps->SetMatrix4x4(PROJECTION, camera.projection);
+				ps->SetFloat3(CAMERA_POSITION, camera.world_position);
 				ps->SetFloat3("cameraDirection", dir);
 				ps->SetSamplerState(PCF_SAMPLER, dxcore->shadow_sampler);
 				ps->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
@@ -1368,8 +1382,8 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 					ps->SetShaderResourceView("renderTexture", prev_pass_texture);					
 				}
 				if (sky != nullptr) {
-					ps->SetFloat("cloud_density", sky->sky->cloud_density);
-					ps->SetMatrix4x4("spot_view", sky->sky->dir_light->GetSpotMatrix());
+					ps->SetFloat("cloud_density", sky->cloud_density);
+					ps->SetMatrix4x4("spot_view", sky->spot_view);
 				}
 				ps->SetShader();
 			}
@@ -1381,31 +1395,31 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 		Event e(this, EVENT_ID_PREPARE_SHADER);
 		e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, sk);
 		coordinator->SendEvent(e);
-		SetEntityLights(&scene_lighting, directional_lights, point_lights);
 		PrepareLights(vs, hs, ds, gs, ps);
-
-		for (auto &mat: shaders.second) {
-			if (!mat.second.second.GetData().empty()) {
-				PrepareMaterial(mat.first, vs, hs, ds, gs, ps);
-				if (mat.second.first->multi_material.multi_texture_count > 0) {
-					PrepareMultiMaterial(mat.second.first, vs, hs, ds, gs, ps);
-					ds->CopyAllBufferData();
-				}
-				for (auto& de : mat.second.second.GetData()) {
-					PrepareEntity(de, vs, hs, ds, gs, ps);
-					if (de.base->visible && de.base->scene_visible) {	
- 						Mesh* mesh = de.mesh;
-						DXCore::Get()->context->DrawIndexed((UINT)mesh->index_count, (UINT)mesh->index_offset, (INT)mesh->vertex_offset);
-						draw_count++;
-					}
-					UnprepareEntity(de, vs, hs, ds, gs, ps);
-					total_count++;
-				}
-				if (mat.second.first->multi_material.multi_texture_count > 0) {
-					UnprepareMultiMaterial(mat.second.first, vs, hs, ds, gs, ps);
-				}
-				UnprepareMaterial(mat.first, vs, hs, ds, gs, ps);
+		prepared_lights_valid = false;
+
+		while (i < commands.size() && DrawList::GetShader(commands[i].key) == shader_id) {
+			//All the drawables of the group share the material data, the first one sets it
+			uint32_t material_id = DrawList::GetMaterial(commands[i].key);
+			const DrawableState& first = s.drawables[commands[i].index];
+			PrepareMaterial(first.material, vs, hs, ds, gs, ps);
+			if (first.multi_material.multi_texture_count > 0) {
+				PrepareMultiMaterial(first.multi_material, vs, hs, ds, gs, ps);
+				ds->CopyAllBufferData();
+			}
+			for (; i < commands.size() && DrawList::GetShader(commands[i].key) == shader_id &&
+				DrawList::GetMaterial(commands[i].key) == material_id; ++i) {
+				const DrawableState& de = s.drawables[commands[i].index];
+				PrepareEntityLights(commands[i].index, ps);
+				PrepareEntity(de, vs, hs, ds, gs, ps);
+				DXCore::Get()->context->DrawIndexed((UINT)de.index_count, (UINT)de.index_offset, (INT)de.vertex_offset);
+				UnprepareEntity(de, vs, hs, ds, gs, ps);
+				draw_count++;
+			}
+			if (first.multi_material.multi_texture_count > 0) {
+				UnprepareMultiMaterial(first.multi_material, vs, hs, ds, gs, ps);
 			}
+			UnprepareMaterial(first.material, vs, hs, ds, gs, ps);
 		}
 		UnprepareLights(vs, hs, ds, gs, ps);
 
@@ -1440,7 +1454,7 @@ void RenderSystem::DrawScene(int w, int h, const float3& camera_position, const
 	//Print stats
 	static int n = 0;
 	if (n++ % 500 == 0) {
-		printf("Rendered %d / %d objects\n", draw_count, total_count);
+		printf("Rendered %d / %d objects\n", draw_count, (int)s.drawables.size());
 	}
 }
 
@@ -1530,15 +1544,15 @@ void RenderSystem::ProcessMotionBlur() {
 	if (post_process_pipeline == nullptr) {
 		return;
 	}
-	if (cameras.GetData().empty()) {
+	if (!snapshot.Read().has_camera) {
 		return;
 	}
 	
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	const Components::Camera& camera = snapshot.Read().camera.camera;
 	int32_t  groupsX = (int32_t)(ceil((float)post_process_pipeline->GetW() / 32.0f));
 	int32_t  groupsY = (int32_t)(ceil((float)post_process_pipeline->GetH() / 32.0f));
-	motion_blur->SetMatrix4x4("view_proj", cam_entity.camera->view_projection);
-	motion_blur->SetMatrix4x4("prev_view_proj", cam_entity.camera->prev_view_projection);
+	motion_blur->SetMatrix4x4("view_proj", camera.view_projection);
+	motion_blur->SetMatrix4x4("prev_view_proj", camera.prev_view_projection);
 	motion_blur->SetShaderResourceView("input", motion_blur_map.SRV());
 	motion_blur->SetInt("enabled", motion_blur_enabled);
 	motion_blur->SetUnorderedAccessView("output", post_process_pipeline->RenderUAV());
@@ -1556,11 +1570,11 @@ void RenderSystem::ProcessDust() {
 	if (dust_enabled && dust_map.UAV() != nullptr) {
 		int w = dxcore->GetWidth();
 		int h = dxcore->GetHeight();
-		assert(!cameras.GetData().empty() && "No cameras found");
-		CameraEntity& cam_entity = cameras.GetData()[0];
+		assert(snapshot.Read().has_camera && "No cameras found");
+		const Components::Camera& camera = snapshot.Read().camera.camera;
 		time = ((float)Scheduler::Get()->GetElapsedNanoSeconds()) / 1000000000.0f;
 		float3 dir;
-		XMStoreFloat3(&dir, cam_entity.camera->xm_direction);
+		XMStoreFloat3(&dir, camera.xm_direction);
 
 		int32_t  groupsX = (int32_t)(ceil((float)dust_map.Width() / (32.0f)));
 		int32_t  groupsY = (int32_t)(ceil((float)dust_map.Height() / (32.0f)));
@@ -1596,10 +1610,10 @@ void RenderSystem::ProcessDust() {
 		dust_render->SetFloat(TIME, time);
 		dust_render->SetInt(SCREEN_W, w);
 		dust_render->SetInt(SCREEN_H, h);
-		dust_render->SetMatrix4x4(VIEW, cam_entity.camera->view);
-		dust_render->SetMatrix4x4("inverse_view", cam_entity.camera->inverse_view);
-		dust_render->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-		dust_render->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		dust_render->SetMatrix4x4(VIEW, camera.view);
+		dust_render->SetMatrix4x4("inverse_view", camera.inverse_view);
+		dust_render->SetMatrix4x4(PROJECTION, camera.projection);
+		dust_render->SetFloat3(CAMERA_POSITION, camera.world_position);
 		dust_render->SetFloat3("cameraDirection", dir);
 		dust_render->SetFloat("focusZ", dof_effect ? dof_effect->GetFocus() : -1.0f);
 		dust_render->SetFloat("amplitude", dof_effect ? dof_effect->GetAmplitude() : 0.0f);
@@ -1632,22 +1646,22 @@ void RenderSystem::ProcessLensFlare() {
 		
 		int w = dxcore->GetWidth();
 		int h = dxcore->GetHeight();
-		assert(!cameras.GetData().empty() && "No cameras found");
-		CameraEntity& cam_entity = cameras.GetData()[0];
+		assert(snapshot.Read().has_camera && "No cameras found");
+		const Components::Camera& camera = snapshot.Read().camera.camera;
 		time = ((float)Scheduler::Get()->GetElapsedNanoSeconds()) / 1000000000.0f;
 		float3 dir;
-		XMStoreFloat3(&dir, cam_entity.camera->xm_direction);
+		XMStoreFloat3(&dir, camera.xm_direction);
 
 		//Render lens flare effect
 		lens_flare->SetFloat(TIME, time);
 		lens_flare->SetInt(SCREEN_W, w);
 		lens_flare->SetInt(SCREEN_H, h);
-		lens_flare->SetMatrix4x4(VIEW, cam_entity.camera->view);
+		lens_flare->SetMatrix4x4(VIEW, camera.view);
 		lens_flare->SetFloat("focusZ", dof_effect ? dof_effect->GetFocus() : -1.0f);
 		lens_flare->SetFloat("amplitude", dof_effect ? dof_effect->GetAmplitude() : -1.0f);
-		lens_flare->SetMatrix4x4("inverse_view", cam_entity.camera->inverse_view);
-		lens_flare->SetMatrix4x4(PROJECTION, cam_entity.camera->projection);
-		lens_flare->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		lens_flare->SetMatrix4x4("inverse_view", camera.inverse_view);
+		lens_flare->SetMatrix4x4(PROJECTION, camera.projection);
+		lens_flare->SetFloat3(CAMERA_POSITION, camera.world_position);
 		lens_flare->SetFloat3("cameraDirection", dir);
 		lens_flare->SetSamplerState(PCF_SAMPLER, dxcore->shadow_sampler);
 		lens_flare->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
@@ -1682,12 +1696,12 @@ void RenderSystem::CopyTexture(const Core::RenderTexture2D& input, Core::RenderT
 }
 
 void RenderSystem::ProcessMotion() {
-	if (!cameras.GetData().empty()) {
-		CameraEntity& cam_entity = cameras.GetData()[0];
+	if (snapshot.Read().has_camera) {
+		const Components::Camera& camera = snapshot.Read().camera.camera;
 		int32_t  groupsX = (int32_t)(ceil((float)motion_texture.Width() / 32.0f));
 		int32_t  groupsY = (int32_t)(ceil((float)motion_texture.Height() / 32.0f));
-		motion_shader->SetMatrix4x4("view_proj", cam_entity.camera->view_projection);
-		motion_shader->SetMatrix4x4("prev_view_proj", cam_entity.camera->prev_view_projection);
+		motion_shader->SetMatrix4x4("view_proj", camera.view_projection);
+		motion_shader->SetMatrix4x4("prev_view_proj", camera.prev_view_projection);
 		motion_shader->SetUnorderedAccessView("output", motion_texture.UAV());
 		motion_shader->SetShaderResourceView("positionTexture", position_map.SRV());
 		motion_shader->SetShaderResourceView("prevPositionTexture", prev_position_map.SRV());
@@ -1744,99 +1758,82 @@ void RenderSystem::ProcessHighZ() {
 
 void RenderSystem::PrepareRT() {
 	if (rt_quality != eRtQuality::OFF && rt_enabled && bvh_buffer != nullptr) {
-		auto& device = dxcore->device;
-
-		CameraEntity& cam_entity = cameras.GetData()[0];
-
-		struct Node {
-			ObjectInfo obj;
-			MaterialProps mat;
-			ID3D11ShaderResourceView* diff;
-		};
-		std::map<float, Node> distance_map;
-
-		bool enabled_layer[RT_NTEXTURES]{ false };
-		enabled_layer[2] = rt_enabled & RT_INDIRECT_ENABLE;
-
-		auto fill = [op = &enabled_layer[0], tr = &enabled_layer[1], ca = &cam_entity](const RenderTree& tree, std::map<float, Node>& distance_map) {
-			for (const auto& shaders : tree) {
-				for (const auto& mat : shaders.second) {
-					for (const auto& de : mat.second.second.GetConstData()) {
-						if (de.base->visible &&  de.mesh->GetData()->skeletons.empty()) {
-
-							// Get the center and extents of the oriented box
-							const float3& orientedBoxCenter = de.bounds->final_box.Center;
-							const float3& orientedBoxExtents = de.bounds->final_box.Extents;
-
-							//float distance = LENGHT_F3(de.transform->position - (ADD_F3_F3(ca->camera->world_position, ca->camera->direction)));
-							float distance = LENGHT_F3(MAX_F3_F3(SUB_F3_F3(orientedBoxCenter - ca->transform->position, orientedBoxExtents), { 0.0f, 0.0f, 0.0f }));
-
+		const RenderSnapshot& s = snapshot.Read();
+		if (!s.has_camera) {
+			return;
+		}
+
+		//Candidates are the visible drawables without skeleton, the MAX_OBJECTS closest to the camera are ray traced
+		rt_candidates.clear();
+		const std::vector<DrawableState>& data = s.drawables;
+		for (uint32_t i = 0; i < (uint32_t)data.size(); ++i) {
+			const DrawableState& state = data[i];
+			if (state.visible && state.mesh->skeletons.empty()) {
+				const float3& center = state.final_box.Center;
+				float distance = LENGHT_F3(MAX_F3_F3(SUB_F3_F3(center - s.camera.position, state.final_box.Extents), { 0.0f, 0.0f, 0.0f }));
+				rt_candidates.push_back({ distance, i, state.handle });
+			}
+		}
+		auto by_distance = [](const RTCandidate& a, const RTCandidate& b) { return a.distance < b.distance; };
+		auto by_entity = [](const RTCandidate& a, const RTCandidate& b) { return a.handle.id < b.handle.id; };
+		if (rt_candidates.size() > MAX_OBJECTS) {
+			std::nth_element(rt_candidates.begin(), rt_candidates.begin() + (MAX_OBJECTS - 1), rt_candidates.end(), by_distance);
+			rt_candidates.resize(MAX_OBJECTS);
+		}
+
+		//The tree is refitted if the selected objects are the same as in the last build, every object keeps its slot.
+		//rt_selection has the objects of the last build sorted by entity with their slot
+		std::sort(rt_candidates.begin(), rt_candidates.end(), by_entity);
+		bool refit = !rt_candidates.empty() && rt_candidates.size() == rt_selection.size() && tbvh.ObjectCount() == rt_selection.size();
+		for (size_t n = 0; refit && n < rt_candidates.size(); ++n) {
+			refit = (rt_candidates[n].handle == rt_selection[n].first);
+		}
+		if (!refit) {
+			//New slots, closest objects first
+			std::sort(rt_candidates.begin(), rt_candidates.end(), by_distance);
+			rt_selection.clear();
+			for (uint32_t n = 0; n < (uint32_t)rt_candidates.size(); ++n) {
+				rt_selection.push_back({ rt_candidates[n].handle, n });
+			}
+			std::sort(rt_selection.begin(), rt_selection.end(), [](const auto& a, const auto& b) { return a.first.id < b.first.id; });
+		}
 
-							MaterialProps mo = de.mat->data->props;
-							ID3D11ShaderResourceView* diffuse_text = de.mat->data->diffuse;
+		nobjects = (int)rt_candidates.size();
+		for (size_t n = 0; n < rt_candidates.size(); ++n) {
+			uint32_t slot = refit ? rt_selection[n].second : (uint32_t)n;
+			const DrawableState& state = data[rt_candidates[n].index];
+			const float3& center = state.final_box.Center;
+			const float3& extents = state.final_box.Extents;
 
-							ObjectInfo o;
+			ObjectInfo& o = objects[slot];
+			// Calculate the minimum and maximum points of the AABB
+			o.aabb_min = { center.x - extents.x, center.y - extents.y, center.z - extents.z };
+			o.aabb_max = { center.x + extents.x, center.y + extents.y, center.z + extents.z };
 
-							// Calculate the minimum and maximum points of the AABB
-							o.aabb_min = { orientedBoxCenter.x - orientedBoxExtents.x,
-											orientedBoxCenter.y - orientedBoxExtents.y,
-											orientedBoxCenter.z - orientedBoxExtents.z };
+			o.vertex_offset = (uint32_t)state.mesh->vertexOffset;
+			o.index_offset = (uint32_t)state.mesh->indexOffset;
+			o.object_offset = (uint32_t)state.mesh->bvhOffset;
 
-							o.aabb_max = { orientedBoxCenter.x + orientedBoxExtents.x,
-											orientedBoxCenter.y + orientedBoxExtents.y,
-											orientedBoxCenter.z + orientedBoxExtents.z };
+			o.position = center;
+			o.world = state.world_matrix;
+			o.inv_world = state.world_inv_matrix;
 
-							o.vertex_offset = (uint32_t)de.mesh->GetData()->vertexOffset;
-							o.index_offset = (uint32_t)de.mesh->GetData()->indexOffset;
-							o.object_offset = (uint32_t)de.mesh->GetData()->bvhOffset;
+			o.density = state.material->props.density;
+			o.opacity = state.material->props.opacity;
 
-							o.position = orientedBoxCenter;
-							o.world = de.transform->world_matrix;
-							o.inv_world = de.transform->world_inv_matrix;
+			objectMaterials[slot] = state.material->props;
+			diffuseTextures[slot] = state.material->diffuse;
+		}
 
-							o.density = de.mat->data->props.density;
-							o.opacity = de.mat->data->props.opacity;
-							
-							if (o.opacity > 0.0f) {
-								*op = true;
-							}
-							if (o.opacity < 1.0f) {
-								*tr = true;
-							}
-							while (true) {
-								if (!distance_map.contains(distance)) {
-									distance_map[distance] = { o, mo, diffuse_text };
-									break;
-								}
-								else {
-									distance += 1.0f;
-								}
-							}
-						}
-					}
-				}
+		if (refit) {
+			tbvh.Refit(objects);
+			if (tbvh.NeedsRebuild()) {
+				tbvh.Load(objects, nobjects);
 			}
-		};
-
-		auto sort = [=](const std::map<float, Node>& distance_map, ObjectInfo objects[MAX_OBJECTS],
-			MaterialProps objectMaterials[MAX_OBJECTS],
-			ID3D11ShaderResourceView* diffuseTextures[MAX_OBJECTS],
-			int& len) {
-				len = 0;
-				for (auto& o : distance_map) {
-					objects[len] = o.second.obj;
-					objectMaterials[len] = o.second.mat;
-					diffuseTextures[len++] = o.second.diff;
-					if (len >= MAX_OBJECTS) {
-						break;
-					}
-				}
-		};
-
-		fill(render_tree, distance_map);
-		fill(render_pass2_tree, distance_map);
-		sort(distance_map, objects, objectMaterials, diffuseTextures, nobjects);	
-		tbvh.Load(objects, nobjects);
+		}
+		else {
+			tbvh.Load(objects, nobjects);
+		}
 	}	
 }
 
@@ -1856,7 +1853,7 @@ void RenderSystem::ProcessGI() {
 		rt_textures_gi_tiles.Clear(zero);
 
 		std::lock_guard<std::mutex> lock(rt_mutex);
-		CameraEntity& cam_entity = cameras.GetData()[0];
+		const Components::Camera& camera = snapshot.Read().camera.camera;
 
 		input_rays.Clear((float*)max_uint);
 		restir_pdf_mask.Clear(zero);
@@ -1864,9 +1861,9 @@ void RenderSystem::ProcessGI() {
 		gi_shader->SetInt("kernel_size", RESTIR_KERNEL);
 		gi_shader->SetInt("ray_count", RESTIR_PIXEL_RAYS);
 		gi_shader->SetFloat(TIME, time);
-		gi_shader->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		gi_shader->SetFloat3(CAMERA_POSITION, camera.world_position);
 
-		gi_shader->SetMatrix4x4("view_proj", cam_entity.camera->view_projection);
+		gi_shader->SetMatrix4x4("view_proj", camera.view_projection);
 		gi_shader->SetInt("frame_count", frame_count);
 		gi_shader->SetInt("divider", GI_TEXTURE_RESOLUTION_DIVIDER);
 
@@ -1905,11 +1902,11 @@ void RenderSystem::ProcessGI() {
 		ray_gi_screen_solver->SetInt("type", 2);
 		ray_gi_screen_solver->SetInt("divider", GI_TEXTURE_RESOLUTION_DIVIDER);
 		ray_gi_screen_solver->SetFloat("hiz_ratio", HIZ_RATIO);
-		ray_gi_screen_solver->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-		ray_gi_screen_solver->SetMatrix4x4("view", cam_entity.camera->view);
-		ray_gi_screen_solver->SetMatrix4x4("projection", cam_entity.camera->projection);
-		ray_gi_screen_solver->SetMatrix4x4("inv_projection", cam_entity.camera->inverse_projection);
-		ray_gi_screen_solver->SetMatrix4x4("prev_view_proj", cam_entity.camera->prev_view_projection);
+		ray_gi_screen_solver->SetFloat3(CAMERA_POSITION, camera.world_position);
+		ray_gi_screen_solver->SetMatrix4x4("view", camera.view);
+		ray_gi_screen_solver->SetMatrix4x4("projection", camera.projection);
+		ray_gi_screen_solver->SetMatrix4x4("inv_projection", camera.inverse_projection);
+		ray_gi_screen_solver->SetMatrix4x4("prev_view_proj", camera.prev_view_projection);
 
 		ray_gi_screen_solver->SetShaderResourceView("ray0", rt_ray_sources0.SRV());
 		ray_gi_screen_solver->SetShaderResourceView("ray1", rt_ray_sources1.SRV());
@@ -1964,7 +1961,7 @@ void RenderSystem::ProcessGI() {
 		ray_gi_world_solver->SetInt("nobjects", nobjects);
 		ray_gi_world_solver->SetData("objectMaterials", objectMaterials, nobjects * sizeof(MaterialProps));
 		ray_gi_world_solver->SetData("objectInfos", objects, nobjects * sizeof(ObjectInfo));
-		ray_gi_world_solver->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		ray_gi_world_solver->SetFloat3(CAMERA_POSITION, camera.world_position);
 
 		ray_gi_world_solver->SetUnorderedAccessView("output", rt_texture_gi_trace->UAV());
 		ray_gi_world_solver->SetUnorderedAccessView("tiles_output", rt_textures_gi_tiles.UAV());
@@ -2036,8 +2033,8 @@ void RenderSystem::ProcessGI() {
 		gi_weights->CopyAllBufferData();
 
 		gi_average->SetInt("debug", rt_debug);
-		gi_average->SetMatrix4x4("prev_view_proj", cam_entity.camera->prev_view_projection);
-		gi_average->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+		gi_average->SetMatrix4x4("prev_view_proj", camera.prev_view_projection);
+		gi_average->SetFloat3(CAMERA_POSITION, camera.world_position);
 		gi_average->SetShaderResourceView("positions", rt_ray_sources0.SRV());
 		gi_average->SetShaderResourceView("normals", rt_ray_sources1.SRV());
 		gi_average->SetShaderResourceView("prev_output", rt_texture_gi_prev->SRV());
@@ -2139,12 +2136,12 @@ void RenderSystem::ProcessRT() {
 			rt_di_shader->SetShaderResourceView("rgbaNoise", rgba_noise_texture.SRV());
 			rt_di_shader->SetUnorderedAccessView("ray_inputs", input_rays.UAV());
 
-			CameraEntity& cam_entity = cameras.GetData()[0];
+			const Components::Camera& camera = snapshot.Read().camera.camera;
 			rt_di_shader->SetFloat(TIME, time);
 			rt_di_shader->SetInt("enabled", rt_enabled & (rt_quality != eRtQuality::OFF ? 0xFF : 0x00));
 			rt_di_shader->SetInt("frame_count", frame_count);
 			rt_di_shader->SetInt("divider", RT_TEXTURE_RESOLUTION_DIVIDER);
-			rt_di_shader->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+			rt_di_shader->SetFloat3(CAMERA_POSITION, camera.world_position);
 
 			rt_di_shader->SetSamplerState(PCF_SAMPLER, dxcore->shadow_sampler);
 			rt_di_shader->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
@@ -2171,10 +2168,10 @@ void RenderSystem::ProcessRT() {
 			ray_reflex_screen_solver->SetInt("type", 1);
 			ray_reflex_screen_solver->SetFloat("hiz_ratio", HIZ_RATIO);
 			ray_reflex_screen_solver->SetInt("divider", RT_TEXTURE_RESOLUTION_DIVIDER);
-			ray_reflex_screen_solver->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
-			ray_reflex_screen_solver->SetMatrix4x4("view", cam_entity.camera->view);
-			ray_reflex_screen_solver->SetMatrix4x4("projection", cam_entity.camera->projection);
-			ray_reflex_screen_solver->SetMatrix4x4("inv_projection", cam_entity.camera->inverse_projection);
+			ray_reflex_screen_solver->SetFloat3(CAMERA_POSITION, camera.world_position);
+			ray_reflex_screen_solver->SetMatrix4x4("view", camera.view);
+			ray_reflex_screen_solver->SetMatrix4x4("projection", camera.projection);
+			ray_reflex_screen_solver->SetMatrix4x4("inv_projection", camera.inverse_projection);
 
 			ray_reflex_screen_solver->SetShaderResourceView("ray0", rt_ray_sources0.SRV());
 			ray_reflex_screen_solver->SetShaderResourceView("ray1", rt_ray_sources1.SRV());
@@ -2225,7 +2222,7 @@ void RenderSystem::ProcessRT() {
 			ray_reflex_world_solver->SetInt("nobjects", nobjects);
 			ray_reflex_world_solver->SetData("objectMaterials", objectMaterials, nobjects * sizeof(MaterialProps));
 			ray_reflex_world_solver->SetData("objectInfos", objects, nobjects * sizeof(ObjectInfo));
-			ray_reflex_world_solver->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+			ray_reflex_world_solver->SetFloat3(CAMERA_POSITION, camera.world_position);
 
 			ray_reflex_world_solver->SetUnorderedAccessView("output0", rt_texture_di_curr[RT_TEXTURE_REFLEX].UAV());
 			ray_reflex_world_solver->SetUnorderedAccessView("output1", rt_texture_di_curr[RT_TEXTURE_REFRACT].UAV());
@@ -2277,8 +2274,8 @@ void RenderSystem::ProcessRT() {
 			rt_di_denoiser->SetShaderResourceView("normals", rt_ray_sources1.SRV());
 			rt_di_denoiser->SetShaderResourceView("motion_texture", motion_texture.SRV());
 			rt_di_denoiser->SetShaderResourceView("prev_position_map", prev_position_map.SRV());
-			rt_di_denoiser->SetMatrix4x4("view_projection", cam_entity.camera->view_projection);
-			rt_di_denoiser->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+			rt_di_denoiser->SetMatrix4x4("view_projection", camera.view_projection);
+			rt_di_denoiser->SetFloat3(CAMERA_POSITION, camera.world_position);
 			rt_di_denoiser->SetShaderResourceView("tiles_output", rt_textures_gi_tiles.SRV());
 
 			static constexpr int textures[] = { RT_TEXTURE_REFLEX, RT_TEXTURE_REFRACT };
@@ -2357,55 +2354,6 @@ void RenderSystem::ProcessRT() {
 	}
 }
 
-bool RenderSystem::IsVisible(const float3& camera_pos, const DrawableEntity& drawable, const matrix& view_projection, int w, int h) const {
-	bool ret = false;
-	if (drawable.base->draw_method == DRAW_ALWAYS) {
-		return true;
-	}
-
-	// Get the center and extents of the oriented box
-	const float3& orientedBoxCenter = drawable.bounds->final_box.Center;
-	const float3& orientedBoxExtents = drawable.bounds->final_box.Extents;
-
-	// Calculate the minimum and maximum points of the AABB
-	float3 aabb_min = { orientedBoxCenter.x - orientedBoxExtents.x,
-					orientedBoxCenter.y - orientedBoxExtents.y,
-					orientedBoxCenter.z - orientedBoxExtents.z };
-
-	float3 aabb_max = { orientedBoxCenter.x + orientedBoxExtents.x,
-					orientedBoxCenter.y + orientedBoxExtents.y,
-					orientedBoxCenter.z + orientedBoxExtents.z };
-
-	float3 points[8];
-	float3& worldpos = drawable.bounds->final_box.Center;
-	float3 dir = { worldpos.x - camera_pos.x, worldpos.y - camera_pos.y, worldpos.z - camera_pos.z };
-	float dist2 = abs(DIST2(dir));
-	if (dist2 < DIST2(drawable.bounds->final_box.Extents) * 2) {
-		return true;
-	}
-
-	float box_dist2 = DIST2(drawable.bounds->final_box.Extents);
-	drawable.bounds->final_box.GetCorners(points);
-	float2 screen_min{ FLT_MAX, FLT_MAX };
-	float2 screen_max{ -FLT_MAX, -FLT_MAX };
-	bool in_x, in_y;
-	for (int i = 0; i < 8; ++i) {
-		float2 pscreen = WorldToScreen(points[i], view_projection, (float)w, (float)h);
-		screen_min.x = min(screen_min.x, pscreen.x);
-		screen_min.y = min(screen_min.y, pscreen.y);
-		screen_max.x = max(screen_max.x, pscreen.x);
-		screen_max.y = max(screen_max.y, pscreen.y);
-		in_x = (screen_min.x >= 0 && screen_min.x <= w) || (screen_max.x >= 0 && screen_max.x <= w) || (screen_min.x <= 0 && screen_max.x >= w);
-		in_y = (screen_min.y >= 0 && screen_min.y <= h) || (screen_max.y >= 0 && screen_max.y <= h) || (screen_min.y <= 0 && screen_max.y >= h);
-		if (in_x && in_y) {
-			return true;
-		}
-	}
-	in_x = (screen_min.x >= 0 && screen_min.x <= w) || (screen_max.x >= 0 && screen_max.x <= w) || (screen_min.x <= 0 && screen_max.x >= w);
-	in_y = (screen_min.y >= 0 && screen_min.y <= h) || (screen_max.y >= 0 && screen_max.y <= h) || (screen_min.y <= 0 && screen_max.y >= h);
-	return (in_x && in_y);
-}
-
 void RenderSystem::PrepareMaterial(Core::MaterialData* material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps) {
 	Event e(this, EVENT_ID_PREPARE_MATERIAL);
 	e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, ShaderKey{ vs, hs, ds, gs, ps });
@@ -2465,99 +2413,110 @@ void RenderSystem::UnprepareMaterial(Core::MaterialData* material, Core::SimpleV
 	}
 }
 
-void RenderSystem::PrepareMultiMaterial(Components::Material* material, Core::SimpleVertexShader* vs,
+void RenderSystem::PrepareMultiMaterial(const Components::MultiMaterial& material, Core::SimpleVertexShader* vs,
 	                                    Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds,
 	                                    Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps) {
-	if (material->multi_material.multi_texture_count > 0) {
-		for (uint32_t i = 0; i < material->multi_material.multi_texture_count; ++i) {
-			if (material->multi_material.multi_texture_data[i] != nullptr) {
-				multitext_diff[i] = material->multi_material.multi_texture_data[i]->diffuse;
-				multitext_norm[i] = material->multi_material.multi_texture_data[i]->normal;
-				multitext_spec[i] = material->multi_material.multi_texture_data[i]->spec;
-				multitext_ao[i] = material->multi_material.multi_texture_data[i]->ao;
-				multitext_arm[i] = material->multi_material.multi_texture_data[i]->arm;
-				multitext_disp[i] = material->multi_material.multi_texture_data[i]->high;
-				multitext_mask[i] = material->multi_material.multi_texture_mask[i];
+	if (material.multi_texture_count > 0) {
+		for (uint32_t i = 0; i < material.multi_texture_count; ++i) {
+			if (material.multi_texture_data[i] != nullptr) {
+				multitext_diff[i] = material.multi_texture_data[i]->diffuse;
+				multitext_norm[i] = material.multi_texture_data[i]->normal;
+				multitext_spec[i] = material.multi_texture_data[i]->spec;
+				multitext_ao[i] = material.multi_texture_data[i]->ao;
+				multitext_arm[i] = material.multi_texture_data[i]->arm;
+				multitext_disp[i] = material.multi_texture_data[i]->high;
+				multitext_mask[i] = material.multi_texture_mask[i];
 			}
 		}
 	}
 	if (vs != nullptr) {
-		vs->SetInt(TESS_TYPE, material->multi_material.tessellation_type);
-		vs->SetFloat(TESS_FACTOR, material->multi_material.tessellation_factor);
+		vs->SetInt(TESS_TYPE, material.tessellation_type);
+		vs->SetFloat(TESS_FACTOR, material.tessellation_factor);
 	}
 
 	if (ds != nullptr) {
-		ds->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, material->multi_material.multi_texture_count);
-		if (material->multi_material.multi_texture_count > 0) {
-			ds->SetData("packed_multi_texture_values", material->multi_material.multi_texture_value.data(), material->multi_material.multi_texture_count * sizeof(float));
-			ds->SetData("packed_multi_texture_uv_scales", material->multi_material.multi_texture_uv_scales.data(), material->multi_material.multi_texture_count * sizeof(float));
-			ds->SetData("packed_multi_texture_operations", material->multi_material.multi_texture_operation.data(), material->multi_material.multi_texture_count * sizeof(uint32_t));
-			ds->SetShaderResourceViewArray("multi_highTexture[0]", multitext_disp.data(), material->multi_material.multi_texture_count);
-			ds->SetFloat(DISPLACEMENT_SCALE, material->multi_material.displacement_scale);
+		ds->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, material.multi_texture_count);
+		if (material.multi_texture_count > 0) {
+			ds->SetData("packed_multi_texture_values", material.multi_texture_value.data(), material.multi_texture_count * sizeof(float));
+			ds->SetData("packed_multi_texture_uv_scales", material.multi_texture_uv_scales.data(), material.multi_texture_count * sizeof(float));
+			ds->SetData("packed_multi_texture_operations", material.multi_texture_operation.data(), material.multi_texture_count * sizeof(uint32_t));
+			ds->SetShaderResourceViewArray("multi_highTexture[0]", multitext_disp.data(), material.multi_texture_count);
+			ds->SetFloat(DISPLACEMENT_SCALE, material.displacement_scale);
 		}
 	}
 	
 	if (ps != nullptr) {
-		ps->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, material->multi_material.multi_texture_count);
-		if (material->multi_material.multi_texture_count > 0) {		
-			ps->SetFloat("multi_parallax_scale", material->multi_material.multi_parallax_scale);
-			ps->SetData("packed_multi_texture_values", material->multi_material.multi_texture_value.data(), material->multi_material.multi_texture_count * sizeof(float));
-			ps->SetData("packed_multi_texture_uv_scales", material->multi_material.multi_texture_uv_scales.data(), material->multi_material.multi_texture_count * sizeof(float));
-			ps->SetData("packed_multi_texture_operations", material->multi_material.multi_texture_operation.data(), material->multi_material.multi_texture_count * sizeof(uint32_t));
-			ps->SetShaderResourceViewArray("multi_diffuseTexture[0]", multitext_diff.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_normalTexture[0]", multitext_norm.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_specularTexture[0]", multitext_spec.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_aoTexture[0]", multitext_ao.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_armTexture[0]", multitext_arm.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_highTexture[0]", multitext_disp.data(), material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_maskTexture[0]", multitext_mask.data(), material->multi_material.multi_texture_count);
+		ps->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, material.multi_texture_count);
+		if (material.multi_texture_count > 0) {		
+			ps->SetFloat("multi_parallax_scale", material.multi_parallax_scale);
+			ps->SetData("packed_multi_texture_values", material.multi_texture_value.data(), material.multi_texture_count * sizeof(float));
+			ps->SetData("packed_multi_texture_uv_scales", material.multi_texture_uv_scales.data(), material.multi_texture_count * sizeof(float));
+			ps->SetData("packed_multi_texture_operations", material.multi_texture_operation.data(), material.multi_texture_count * sizeof(uint32_t));
+			ps->SetShaderResourceViewArray("multi_diffuseTexture[0]", multitext_diff.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_normalTexture[0]", multitext_norm.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_specularTexture[0]", multitext_spec.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_aoTexture[0]", multitext_ao.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_armTexture[0]", multitext_arm.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_highTexture[0]", multitext_disp.data(), material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_maskTexture[0]", multitext_mask.data(), material.multi_texture_count);
 		}
 	}
 }
 
-void RenderSystem::UnprepareMultiMaterial(Components::Material* material, Core::SimpleVertexShader* vs,
+void RenderSystem::UnprepareMultiMaterial(const Components::MultiMaterial& material, Core::SimpleVertexShader* vs,
 	                                      Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds,
 	                                      Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps) {
-	if (material->multi_material.multi_texture_count > 0) {
+	if (material.multi_texture_count > 0) {
 		static ID3D11ShaderResourceView* zero_text[MAX_MULTI_TEXTURE] = {};
 
 		if (ps) {
 			ps->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, 0);
 		
-			ps->SetShaderResourceViewArray("multi_diffuseTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_normalTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_specularTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_aoTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_armTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_highTexture[0]", zero_text, material->multi_material.multi_texture_count);
-			ps->SetShaderResourceViewArray("multi_maskTexture[0]", zero_text, material->multi_material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_diffuseTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_normalTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_specularTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_aoTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_armTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_highTexture[0]", zero_text, material.multi_texture_count);
+			ps->SetShaderResourceViewArray("multi_maskTexture[0]", zero_text, material.multi_texture_count);
 		}
 		if (ds) {
 			ds->SetInt(SimpleShaderKeys::MULTI_TEXTURE_COUNT, 0);
-			ds->SetShaderResourceViewArray("multi_highTexture[0]", zero_text, material->multi_material.multi_texture_count);
+			ds->SetShaderResourceViewArray("multi_highTexture[0]", zero_text, material.multi_texture_count);
 		}
 	}
 }
 
 void RenderSystem::PrepareLights(Core::ISimpleShader* s) {
-	if (!ambient_lights.GetData().empty()) {
-		s->SetData(AMBIENT_LIGHT, &ambient_lights.GetData()[0].light->GetData(), sizeof(AmbientLight::Data));
-	}
-	s->SetInt(DIRLIGHT_COUNT, (int)scene_lighting.dir_lights.size());
-	if (!scene_lighting.dir_lights.empty()) {
-		s->SetData(DIR_LIGHTS, scene_lighting.dir_lights.data(), (int)(sizeof(DirectionalLight::Data) * scene_lighting.dir_lights.size()));
-	}
-	s->SetInt(POINT_LIGHT_COUNT, (int)scene_lighting.point_lights.size());
-	if (!scene_lighting.point_lights.empty()) {
-		s->SetData(POINT_LIGHTS, scene_lighting.point_lights.data(), (int)(sizeof(PointLight::Data) * scene_lighting.point_lights.size()));
-	}
-	if (!scene_lighting.shadows_perspectives.empty()) {
-		s->SetData(LIGHT_PERSPECTIVE_VALUES, scene_lighting.shadows_perspectives.data(), (int)(sizeof(float2) * scene_lighting.shadows_perspectives.size()));
-		s->SetShaderResourceViewArray(POINT_SHADOW_MAP_TEXTURE, scene_lighting.shadows.data(), (int)(scene_lighting.shadows.size()));
+	const RenderSnapshot& snap = snapshot.Read();
+	if (snap.has_ambient) {
+		s->SetData(AMBIENT_LIGHT, &snap.ambient, sizeof(AmbientLight::Data));
+	}
+	int dir_count = min((int)scene_lighting.dir_lights.size(), MAX_LIGHTS);
+	s->SetInt(DIRLIGHT_COUNT, dir_count);
+	if (dir_count > 0) {
+		s->SetData(DIR_LIGHTS, scene_lighting.dir_lights.data(), (int)(sizeof(DirectionalLight::Data) * dir_count));
+	}
+	//The shaders have room for MAX_LIGHTS point lights, the ones closest to the camera are used
+	PointLight::Data data[MAX_LIGHTS];
+	float2 perspectives[MAX_LIGHTS];
+	ID3D11ShaderResourceView* shadows[MAX_LIGHTS] = {};
+	for (uint16_t i = 0; i < scene_lights.count; ++i) {
+		uint16_t l = scene_lights.lights[i];
+		data[i] = scene_lighting.point_lights[l];
+		perspectives[i] = scene_lighting.shadows_perspectives[l];
+		shadows[i] = scene_lighting.shadows[l];
+	}
+	s->SetInt(POINT_LIGHT_COUNT, (int)scene_lights.count);
+	if (scene_lights.count > 0) {
+		s->SetData(POINT_LIGHTS, data, (int)(sizeof(PointLight::Data) * scene_lights.count));
+		s->SetData(LIGHT_PERSPECTIVE_VALUES, perspectives, (int)(sizeof(float2) * scene_lights.count));
+		s->SetShaderResourceViewArray(POINT_SHADOW_MAP_TEXTURE, shadows, (int)scene_lights.count);
 	}
 	if (!scene_lighting.dir_shadows.empty()) {
-		s->SetData(DIR_PERSPECTIVE_VALUES, scene_lighting.dir_shadows_perspectives.data(), (int)(sizeof(float4x4) * scene_lighting.dir_shadows_perspectives.size()));
-		s->SetShaderResourceViewArray(DIR_SHADOW_MAP_TEXTURE, scene_lighting.dir_shadows.data(), (int)(scene_lighting.dir_shadows.size()));
+		int count = min((int)scene_lighting.dir_shadows.size(), MAX_LIGHTS);
+		s->SetData(DIR_PERSPECTIVE_VALUES, scene_lighting.dir_shadows_perspectives.data(), (int)(sizeof(float4x4) * count));
+		s->SetShaderResourceViewArray(DIR_SHADOW_MAP_TEXTURE, scene_lighting.dir_shadows.data(), count);
 	}
 }
 
@@ -2584,30 +2543,31 @@ void RenderSystem::UnprepareLights(Core::SimpleVertexShader* vs, Core::SimpleHul
 }
 
 void RenderSystem::PrepareVolumetricShader(Core::ISimpleShader* s) {
-	SkyEntity* sky = nullptr;
+	const RenderSnapshot& snap = snapshot.Read();
+	const SkyState* sky = nullptr;
 	int w = dxcore->GetWidth();
 	int h = dxcore->GetHeight();
 	float speed = 1.0f;
-	if (!skies.GetData().empty()) {
-		sky = &(skies.GetData()[0]);
-		speed = sky->sky->second_speed;
+	if (snap.has_sky) {
+		sky = &snap.sky;
+		speed = sky->second_speed;
 	}
 
-	assert(!cameras.GetData().empty() && "No cameras found");
-	CameraEntity& cam_entity = cameras.GetData()[0];
+	assert(snap.has_camera && "No cameras found");
+	const Components::Camera& camera = snap.camera.camera;
 	time = ((float)Scheduler::Get()->GetElapsedNanoSeconds() * speed) / 1000000000.0f;
 	float3 dir;
-	XMStoreFloat3(&dir, cam_entity.camera->xm_direction);
+	XMStoreFloat3(&dir, camera.xm_direction);
 
 	s->SetFloat(TIME, time);
 	s->SetInt(SCREEN_W, w);
 	s->SetInt(SCREEN_H, h);
-	s->SetFloat3(CAMERA_POSITION, cam_entity.camera->world_position);
+	s->SetFloat3(CAMERA_POSITION, camera.world_position);
 	s->SetFloat3("cameraDirection", dir);
 	s->SetSamplerState(BASIC_SAMPLER, dxcore->basic_sampler);
 	
 	if (sky != nullptr) {
-		s->SetFloat("cloud_density", sky->sky->cloud_density);
+		s->SetFloat("cloud_density", sky->cloud_density);
 	}
 	s->SetShaderResourceView("worldTexture", position_map.SRV());
 	PrepareLights(s);
@@ -2618,24 +2578,31 @@ void RenderSystem::UnprepareVolumetricShader(Core::ISimpleShader* s) {
 	UnprepareLights(s);
 }
 
-void RenderSystem::PrepareEntity(DrawableEntity& entity, SimpleVertexShader* vs, SimpleHullShader* hs, SimpleDomainShader* ds, SimpleGeometryShader* gs, SimplePixelShader* ps) {
-	Event e(this, entity.base->id, EVENT_ID_PREPARE_ENTITY);
+void RenderSystem::PrepareEntity(const DrawableState& entity, SimpleVertexShader* vs, SimpleHullShader* hs, SimpleDomainShader* ds, SimpleGeometryShader* gs, SimplePixelShader* ps) {
+	Event e(this, entity.handle.id, EVENT_ID_PREPARE_ENTITY);
 	e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, ShaderKey{ vs, hs, ds, gs, ps });
 	coordinator->SendEvent(e);
-	const float4x4& world = entity.transform->world_matrix;
-	const float4x4& prev_world = entity.transform->prev_world_matrix;
+	const float4x4& world = entity.world_matrix;
+	const float4x4& prev_world = entity.prev_world_matrix;
 	if (ds != nullptr) {
-		if (entity.mesh->GetData()->displacement_scale > 0.0f) {
-			ds->SetFloat(DISPLACEMENT_SCALE, entity.mesh->GetData()->displacement_scale);
+		if (entity.mesh->displacement_scale > 0.0f) {
+			ds->SetFloat(DISPLACEMENT_SCALE, entity.mesh->displacement_scale);
 			ds->CopyAllBufferData();
 		}
 	}
 	if (vs != nullptr) {
-		entity.mesh->Prepare(vs);
+		//Joints copied from the mesh component in the extraction
+		if (!entity.joints.empty()) {
+			vs->SetData("joints", entity.joints.data(), sizeof(float4x4) * (int)entity.joints.size());
+			vs->SetInt(SimpleShaderKeys::NJOINTS, (int)entity.joints.size());
+		}
+		else {
+			vs->SetInt(SimpleShaderKeys::NJOINTS, 0);
+		}
 		vs->SetMatrix4x4(WORLD, world);
-		if (entity.mesh->GetData()->tessellation_type > 0) {
-			vs->SetInt(TESS_TYPE, entity.mesh->GetData()->tessellation_type);
-			vs->SetFloat(TESS_FACTOR, entity.mesh->GetData()->tessellation_factor);
+		if (entity.mesh->tessellation_type > 0) {
+			vs->SetInt(TESS_TYPE, entity.mesh->tessellation_type);
+			vs->SetFloat(TESS_FACTOR, entity.mesh->tessellation_factor);
 		}		
 		vs->CopyAllBufferData();
 	}
@@ -2650,26 +2617,26 @@ void RenderSystem::PrepareEntity(DrawableEntity& entity, SimpleVertexShader* vs,
 	if (ps != nullptr) {
 		ps->SetMatrix4x4(WORLD, world);
 		ps->SetMatrix4x4(PREV_WORLD, prev_world);
-		ID3D11ShaderResourceView* mesh_normal_map = entity.mesh->GetData()->normal_map;
+		ID3D11ShaderResourceView* mesh_normal_map = entity.mesh->normal_map;
 		ps->SetShaderResourceView(MESH_NORMAL_MAP, mesh_normal_map);
 		ps->SetInt(MESH_NORMAL_MAP_ENABLE, mesh_normal_map != nullptr);
 		ps->CopyAllBufferData();
 	}
 }
 
-void RenderSystem::UnprepareEntity(DrawableEntity& entity, SimpleVertexShader* vs, SimpleHullShader* hs, SimpleDomainShader* ds, SimpleGeometryShader* gs, SimplePixelShader* ps) {
-	Event e(this, entity.base->id, EVENT_ID_UNPREPARE_ENTITY);
+void RenderSystem::UnprepareEntity(const DrawableState& entity, SimpleVertexShader* vs, SimpleHullShader* hs, SimpleDomainShader* ds, SimpleGeometryShader* gs, SimplePixelShader* ps) {
+	Event e(this, entity.handle.id, EVENT_ID_UNPREPARE_ENTITY);
 	e.SetParam<ShaderKey>(EVENT_PARAM_SHADER, ShaderKey{ vs, hs, ds, gs, ps });
 	coordinator->SendEvent(e);
 	if (vs != nullptr) {
-		entity.mesh->Unprepare(vs);
+		vs->SetInt(SimpleShaderKeys::NJOINTS, 0);
 	}
 	if (ps != nullptr) {
 		ps->SetShaderResourceView(MESH_NORMAL_MAP, nullptr);
 	}	
 }
 
-void RenderSystem::SetEntityLights(Lighted* lighted, ECS::EntityVector<DirectionalLightEntity>& dir_lights, ECS::EntityVector<PointLightEntity>& point_lights) {
+void RenderSystem::SetEntityLights(Lighted* lighted, const RenderSnapshot& s) {
 	lighted->dir_lights.clear();
 	lighted->point_lights.clear();
 	lighted->shadows.clear();
@@ -2688,20 +2655,112 @@ void RenderSystem::SetEntityLights(Lighted* lighted, ECS::EntityVector<Direction
 	lighted->dir_shadows_perspectives.reserve(MAX_LIGHTS);
 	lighted->dir_static_shadows_perspectives.reserve(MAX_LIGHTS);
 
-	for (auto const& l: dir_lights.GetData()) {
-		lighted->dir_lights.push_back(l.light->GetData());
-		lighted->dir_shadows.push_back(l.light->DepthResource());
-		lighted->dir_static_shadows.push_back(l.light->StaticDepthResource());
-		lighted->dir_shadows_perspectives.push_back(*l.light->GetViewMatrix());
-		lighted->dir_static_shadows_perspectives.push_back(*l.light->GetStaticViewMatrix());
+	for (auto const& l: s.dir_lights) {
+		lighted->dir_lights.push_back(l.data);
+		lighted->dir_shadows.push_back(l.depth_resource.Get());
+		lighted->dir_static_shadows.push_back(l.static_depth_resource.Get());
+		lighted->dir_shadows_perspectives.push_back(l.view);
+		lighted->dir_static_shadows_perspectives.push_back(l.static_view);
+	}
+	for (auto const& l : s.point_lights) {
+		lighted->point_lights.push_back(l.data);
+		lighted->shadows.push_back(l.depth_resource.Get());
+		lighted->shadows_perspectives.push_back(l.perspective);
+	}
+}
+
+void RenderSystem::LightList::Insert(uint16_t light, float score) {
+	int pos = count;
+	if (pos == MAX_LIGHTS) {
+		if (score <= scores[MAX_LIGHTS - 1]) {
+			return;
+		}
+		pos = MAX_LIGHTS - 1;
 	}
-	for (auto const& l : point_lights.GetData()) {
-		lighted->point_lights.push_back(l.light->GetData());
-		lighted->shadows.push_back(l.light->DepthResource());
-		lighted->shadows_perspectives.push_back({ l.light->GetLightPerspectiveValues().m[2][2] , l.light->GetLightPerspectiveValues().m[3][2] });
+	else {
+		++count;
+	}
+	while (pos > 0 && scores[pos - 1] < score) {
+		scores[pos] = scores[pos - 1];
+		lights[pos] = lights[pos - 1];
+		--pos;
+	}
+	scores[pos] = score;
+	lights[pos] = light;
+}
+
+void RenderSystem::AssignLights() {
+	const RenderSnapshot& s = snapshot.Read();
+	light_lists.assign(s.drawables.size(), LightList{});
+	const std::vector<PointLightState>& lights = s.point_lights;
+	//Every light only visits the drawables the scene index finds in its range
+	for (size_t i = 0; i < lights.size(); ++i) {
+		const PointLight::Data& l = lights[i].data;
+		float r2 = l.range * l.range;
+		scene_index.QuerySphere(l.position, l.range, [this, &s, &l, r2, i](SceneIndex::Key key) {
+			if (key >= snapshot_index.size() || snapshot_index[key] < 0) {
+				return;
+			}
+			int32_t index = snapshot_index[key];
+			const DrawableState& de = s.drawables[index];
+			if (!de.visible || !de.scene_visible) {
+				return;
+			}
+			//Squared distance from the light to the box, the index nodes are enlarged by a margin
+			const box& b = de.final_box;
+			float3 d = { max(abs(l.position.x - b.Center.x) - b.Extents.x, 0.0f),
+						 max(abs(l.position.y - b.Center.y) - b.Extents.y, 0.0f),
+						 max(abs(l.position.z - b.Center.z) - b.Extents.z, 0.0f) };
+			float d2 = DIST2(d);
+			if (d2 >= r2) {
+				return;
+			}
+			//Closer to the light relative to its range is more relevant
+			light_lists[index].Insert((uint16_t)i, 1.0f - d2 / r2);
+			});
 	}
 }
 
+void RenderSystem::SelectSceneLights(const float3& camera_position) {
+	const std::vector<PointLightState>& lights = snapshot.Read().point_lights;
+	scene_lights = LightList{};
+	for (size_t i = 0; i < lights.size(); ++i) {
+		const PointLight::Data& l = lights[i].data;
+		//Distance from the camera to the light range, lights containing the camera go first
+		float3 d = SUB_F3_F3(l.position, camera_position);
+		float distance = max(LENGHT_F3(d) - l.range, 0.0f);
+		scene_lights.Insert((uint16_t)i, -distance);
+	}
+}
+
+void RenderSystem::PrepareEntityLights(uint32_t index, SimplePixelShader* ps) {
+	if (ps == nullptr) {
+		return;
+	}
+	static const LightList no_lights;
+	const LightList& list = (index < light_lists.size()) ? light_lists[index] : no_lights;
+	if (prepared_lights_valid && prepared_lights == list) {
+		return;
+	}
+	PointLight::Data data[MAX_LIGHTS];
+	float2 perspectives[MAX_LIGHTS];
+	ID3D11ShaderResourceView* shadows[MAX_LIGHTS] = {};
+	for (uint16_t i = 0; i < list.count; ++i) {
+		uint16_t l = list.lights[i];
+		data[i] = scene_lighting.point_lights[l];
+		perspectives[i] = scene_lighting.shadows_perspectives[l];
+		shadows[i] = scene_lighting.shadows[l];
+	}
+	ps->SetInt(POINT_LIGHT_COUNT, (int)list.count);
+	if (list.count > 0) {
+		ps->SetData(POINT_LIGHTS, data, (int)(sizeof(PointLight::Data) * list.count));
+		ps->SetData(LIGHT_PERSPECTIVE_VALUES, perspectives, (int)(sizeof(float2) * list.count));
+		ps->SetShaderResourceViewArray(POINT_SHADOW_MAP_TEXTURE, shadows, (int)list.count);
+	}
+	prepared_lights = list;
+	prepared_lights_valid = true;
+}
+
 void RenderSystem::Clear(const float color[4]) {
 	dxcore->ClearScreen(color);
 	static const float max_depth[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
@@ -2728,7 +2787,7 @@ void RenderSystem::Clear(const float color[4]) {
 
 void RenderSystem::SetPostProcessPipeline(Core::PostProcess* pipeline) {
 	if (pipeline != nullptr) {
-		if (render_pass2_tree.empty()) {
+		if (!HasSecondPass()) {
 			first_pass_target = pipeline;
 			second_pass_target = nullptr;			
 		}
@@ -2773,22 +2832,207 @@ void RenderSystem::Update() {
 	static const float back_color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
 	vertex_buffer->SetBuffers();
 	Clear(back_color);
-	mutex.lock();
+	bool new_snapshot = false;
+	{
+		//The ray tracing thread reads the snapshot in PrepareRT with rt_mutex locked
+		std::lock_guard<std::mutex> l(rt_mutex);
+		//Keeps drawing the previous snapshot if the simulation didn't publish a new one
+		new_snapshot = snapshot.Acquire();
+	}
+	if (new_snapshot) {
+		SyncSceneIndex();
+	}
 	Draw();
-	mutex.unlock();
 	dxcore->Present();
 }
 
+void RenderSystem::SyncSceneIndex() {
+	const RenderSnapshot& s = snapshot.Read();
+	std::fill(snapshot_index.begin(), snapshot_index.end(), -1);
+	for (int32_t i = 0; i < (int32_t)s.drawables.size(); ++i) {
+		ECS::Entity id = s.drawables[i].handle.id;
+		if (id >= (ECS::Entity)snapshot_index.size()) {
+			snapshot_index.resize((size_t)id + 1, -1);
+		}
+		snapshot_index[id] = i;
+	}
+	//Entities gone or recreated since the last snapshot
+	for (ECS::Entity id = 0; id < (ECS::Entity)indexed_handles.size(); ++id) {
+		if (indexed_handles[id].id == INVALID_ENTITY_ID) {
+			continue;
+		}
+		if (snapshot_index[id] < 0 || s.drawables[snapshot_index[id]].handle != indexed_handles[id]) {
+			scene_index.Remove(id);
+			indexed_handles[id] = {};
+		}
+	}
+	indexed_handles.resize(snapshot_index.size());
+	for (const DrawableState& state : s.drawables) {
+		scene_index.Update(state.handle.id, state.final_box);
+		indexed_handles[state.handle.id] = state.handle;
+	}
+}
+
+void RenderSystem::Extract(const std::unordered_map<ECS::Entity, matrix>* corrections) {
+	RenderSnapshot& s = snapshot.Write();
+	s.tick = ++snapshot_tick;
+	s.has_camera = !cameras.GetData().empty();
+	if (s.has_camera) {
+		const CameraEntity& cam_entity = cameras.GetData()[0];
+		s.camera.camera = *cam_entity.camera;
+		s.camera.position = cam_entity.transform->position;
+	}
+
+	auto copy_drawable = [](const DrawableEntity& de, DrawableState& state) {
+		state.handle = de.handle;
+		state.world_matrix = de.transform->world_matrix;
+		state.prev_world_matrix = de.transform->prev_world_matrix;
+		state.world_inv_matrix = de.transform->world_inv_matrix;
+		state.position = de.transform->position;
+		state.shader_id = de.shader_id;
+		state.depth_shader_id = de.depth_shader_id;
+		state.shadow_shader_id = de.shadow_shader_id;
+		state.material_id = de.material_id;
+		state.material = de.mat->data;
+		state.mesh = de.mesh->GetData();
+		state.index_count = de.mesh->index_count;
+		state.index_offset = de.mesh->index_offset;
+		state.vertex_offset = de.mesh->vertex_offset;
+		//Same condition as Mesh::Prepare, the joints are written by the animation system
+		const Mesh::Animation& anim = de.mesh->current_animation;
+		if (anim.skeleton != nullptr && anim.id >= 0 && !de.mesh->joint_gpu_data.empty()) {
+			std::lock_guard<std::recursive_mutex> l(*de.mesh->skeleton_mutex);
+			state.joints.assign(de.mesh->joint_gpu_data.begin(), de.mesh->joint_gpu_data.end());
+		}
+		else {
+			state.joints.clear();
+		}
+		if (de.mat->multi_material.multi_texture_count > 0) {
+			state.multi_material = de.mat->multi_material;
+		}
+		else {
+			state.multi_material.multi_texture_count = 0;
+		}
+	};
+
+	const std::vector<DrawableEntity>& data = drawables.GetConstData();
+	s.drawables.resize(data.size());
+	extract_bounds.Reset(data.size());
+	s.has_second_pass = false;
+	for (size_t i = 0; i < data.size(); ++i) {
+		const DrawableEntity& de = data[i];
+		DrawableState& state = s.drawables[i];
+		copy_drawable(de, state);
+		state.final_box = de.bounds->final_box;
+		if (corrections != nullptr && !corrections->empty()) {
+			//The correction of a body also moves the children following its position and rotation
+			ECS::Entity e = de.base->id;
+			auto it = corrections->find(e);
+			while (it == corrections->end()) {
+				const Base& b = coordinator->GetComponent<Base>(e);
+				if (b.parent == ECS::INVALID_ENTITY_ID || !b.parent_position || !b.parent_rotation) {
+					break;
+				}
+				e = b.parent;
+				it = corrections->find(e);
+			}
+			if (it != corrections->end()) {
+				matrix world = de.transform->world_xmmatrix * it->second;
+				XMStoreFloat4x4(&state.world_matrix, XMMatrixTranspose(world));
+				XMStoreFloat4x4(&state.world_inv_matrix, XMMatrixTranspose(XMMatrixInverse(nullptr, world)));
+				if (e == de.base->id) {
+					XMStoreFloat3(&state.position, world.r[3]);
+				}
+				de.bounds->local_box.Transform(state.final_box, world);
+			}
+		}
+		extract_bounds.Set(i, state.final_box);
+		state.visible = de.base->visible;
+		state.cast_shadow = de.base->cast_shadow;
+		state.draw_depth = de.base->draw_depth;
+		state.is_static = de.base->is_static;
+		state.pass = de.base->pass;
+		s.has_second_pass |= (state.pass == 2);
+	}
+	//Frustum culling with the extracted camera, systems out of the renderer (animations, particles)
+	//read the result from the base component
+	if (s.has_camera) {
+		extract_bounds.Cull(Frustum::FromViewProjection(s.camera.camera.xm_view_projection), extract_visibility);
+	}
+	for (size_t i = 0; i < data.size(); ++i) {
+		DrawableState& state = s.drawables[i];
+		state.scene_visible = data[i].base->draw_method == DRAW_ALWAYS || (s.has_camera && CullingSet::Test(extract_visibility, i));
+		data[i].base->scene_visible = state.scene_visible;
+	}
+
+	//Skies don't have base nor bounds components
+	s.has_sky = !skies.GetData().empty();
+	if (s.has_sky) {
+		assert(skies.GetData().size() == 1 && "More than one sky registered.");
+		const SkyEntity& sky = skies.GetData()[0];
+		copy_drawable(sky, s.sky.drawable);
+		s.sky.drawable.visible = true;
+		s.sky.second_speed = sky.sky->second_speed;
+		s.sky.cloud_density = sky.sky->cloud_density;
+		s.sky.current_backcolor = sky.sky->current_backcolor;
+		s.sky.space_mesh = sky.sky->space_mesh;
+		s.sky.space_material = sky.sky->space_material;
+		if (sky.sky->dir_light != nullptr) {
+			s.sky.spot_view = sky.sky->dir_light->GetSpotMatrix();
+		}
+	}
+
+	s.has_ambient = !ambient_lights.GetData().empty();
+	if (s.has_ambient) {
+		s.ambient = ambient_lights.GetData()[0].light->GetData();
+	}
+
+	s.point_lights.resize(point_lights.Size());
+	for (size_t i = 0; i < point_lights.Size(); ++i) {
+		PointLight* light = point_lights[i].light;
+		PointLightState& l = s.point_lights[i];
+		l.data = light->GetData();
+		l.cast_shadow = light->CastShadow();
+		l.shadow_vp = light->GetShadowViewPort();
+		std::copy(light->GetViewMatrix(), light->GetViewMatrix() + 6, l.view);
+		l.perspective = { light->GetLightPerspectiveValues().m[2][2], light->GetLightPerspectiveValues().m[3][2] };
+		l.depth_resource.Reset(light->DepthResource());
+		l.depth_view.Reset(light->DepthView());
+	}
+
+	s.dir_lights.resize(directional_lights.Size());
+	for (size_t i = 0; i < directional_lights.Size(); ++i) {
+		DirectionalLight* light = directional_lights[i].light;
+		DirectionalLightState& l = s.dir_lights[i];
+		l.data = light->GetData();
+		l.cast_shadow = light->CastShadow();
+		l.shadow_vp = light->GetShadowViewPort();
+		l.view = *light->GetViewMatrix();
+		l.static_view = *light->GetStaticViewMatrix();
+		l.depth_resource.Reset(light->DepthResource());
+		l.depth_view.Reset(light->DepthView());
+		l.static_depth_resource.Reset(light->StaticDepthResource());
+		l.static_depth_view.Reset(light->StaticDepthView());
+		l.skip.assign(light->GetSkipEntities().begin(), light->GetSkipEntities().end());
+		std::sort(l.skip.begin(), l.skip.end());
+	}
+
+	if (s.shader_keys.size() != shader_keys.size()) {
+		s.shader_keys = shader_keys;
+	}
+	snapshot.Publish();
+}
+
 void RenderSystem::PostProcessLight() {
 
-	if (!cameras.GetData().empty()) {
+	if (snapshot.Read().has_camera) {
 
 		vol_data.Clear(zero);
-		CameraEntity& cam_entity = cameras.GetData()[0];
+		const Components::Camera& camera = snapshot.Read().camera.camera;
 		PrepareVolumetricShader(vol_shader);
 		vol_shader->SetShaderResourceView("rgbaNoise", rgba_noise_texture.SRV());
-		vol_shader->SetMatrix4x4("view_inverse", cam_entity.camera->inverse_view);
-		vol_shader->SetMatrix4x4("projection_inverse", cam_entity.camera->inverse_projection);
+		vol_shader->SetMatrix4x4("view_inverse", camera.inverse_view);
+		vol_shader->SetMatrix4x4("projection_inverse", camera.inverse_projection);
 		vol_shader->SetUnorderedAccessView("output", vol_light_map.UAV());
 		vol_shader->SetUnorderedAccessView("vol_data", vol_data.UAV());
 		vol_shader->CopyAllBufferData();
@@ -2864,20 +3108,25 @@ void RenderSystem::Draw() {
 	int w = dxcore->GetWidth();
 	int h = dxcore->GetHeight();
 	
-	if (!cameras.GetData().empty() && scene_enabled) {
+	const RenderSnapshot& s = snapshot.Read();
+	if (s.has_camera && scene_enabled) {
 		
 		rt_mutex.lock();
 		rt_prepare = true;
 		rt_signal.notify_all();
 		rt_mutex.unlock();
 
-		CameraEntity& cam_entity = cameras.GetData()[0];
+		const Components::Camera& camera = s.camera.camera;
 
-		matrix view = XMMatrixTranspose(XMLoadFloat4x4(&cam_entity.camera->view));
-		matrix projection = XMMatrixTranspose(XMLoadFloat4x4(&cam_entity.camera->projection));
-		float3 camera_position = cam_entity.camera->world_position;
+		matrix view = XMMatrixTranspose(XMLoadFloat4x4(&camera.view));
+		matrix projection = XMMatrixTranspose(XMLoadFloat4x4(&camera.projection));
+		float3 camera_position = camera.world_position;
 
-		CheckSceneVisibility(render_tree);
+		//Lights are the same for all the passes of the frame
+		SetEntityLights(&scene_lighting, s);
+		AssignLights();
+		SelectSceneLights(camera_position);
+		BuildDrawList(camera_position);
 		static int count = 0;
 		//Only one every 100 frames we refresh static shadows (directional light can change location due to sky component)
 		//but this is fine to just make the overhead of casting shadow of static objects almost zero (cost reduced by /STATIC_SHADOW_REFRESH_PERIOD)
@@ -2892,13 +3141,12 @@ void RenderSystem::Draw() {
 		CastShadows(w, h, camera_position, view, projection, false);
 		DrawDepth(w, h, camera_position, view, projection);
 		DrawSky(w, h, camera_position, view, projection);
-		DrawScene(w, h, camera_position, view, projection, nullptr, first_pass_target, render_tree);
-		if (second_pass_target != nullptr && !render_pass2_tree.empty()) {
-			CheckSceneVisibility(render_pass2_tree);
+		DrawScene(w, h, camera_position, view, projection, nullptr, first_pass_target, DRAW_PASS_SCENE);
+		if (second_pass_target != nullptr && s.has_second_pass) {
 			current_light_map = &light_map[1];
 			prev_light_map = &light_map[0];
 			CopyTexture(*prev_light_map, *current_light_map);
-			DrawScene(w, h, camera_position, view, projection, first_pass_texture.SRV(), second_pass_target, render_pass2_tree);
+			DrawScene(w, h, camera_position, view, projection, first_pass_texture.SRV(), second_pass_target, DRAW_PASS_SCENE2);
 		}
 		ProcessMotion();
 		ProcessHighZ();
@@ -2911,7 +3159,7 @@ void RenderSystem::Draw() {
 
 		if (post_process_pipeline != nullptr) {
 			post_process_pipeline->SetShaderResourceView(DEPTH_TEXTURE, depth_map.SRV());
-			post_process_pipeline->SetView(*(cam_entity.camera));
+			post_process_pipeline->SetView(camera);
 		}
 		
 	}
@@ -27,6 +27,7 @@ SOFTWARE.
 #include <tuple>
 
 #include <ECS\Coordinator.h>
+#include <ECS\ComponentLocks.h>
 #include <ECS\EntityVector.h>
 #include <Components\Base.h>
 #include <Components\Lights.h>
@@ -38,12 +39,18 @@ SOFTWARE.
 #include <Core\Mesh.h>
 #include <Core\PostProcess.h>
 #include <Core\BVH.h>
+#include <Core\TripleBuffer.h>
+#include <Core\Culling.h>
+#include <Core\SceneIndex.h>
+#include <Core\DrawList.h>
 
 namespace HotBite {
 	namespace Engine {
 		namespace Systems {
 			class RenderSystem : public ECS::System {
 			public:
+				//Draw events are sent from the render thread without the render mutex locked,
+				//listeners can only use render resources and data not written by the simulation
 				static inline ECS::EventId EVENT_ID_PREPARE_ENTITY = ECS::GetEventId<RenderSystem>(0x00);
 				static inline ECS::EventId EVENT_ID_UNPREPARE_ENTITY = ECS::GetEventId<RenderSystem>(0x01);
 				static inline ECS::EventId EVENT_ID_PREPARE_MATERIAL = ECS::GetEventId<RenderSystem>(0x02);
@@ -65,8 +72,15 @@ namespace HotBite {
 				static inline ECS::EventId EVENT_ID_UNPREPARE_POST = ECS::GetEventId<RenderSystem>(0x12);
 
 				static constexpr uint32_t STATIC_SHADOW_REFRESH_PERIOD = 1000;
+				//Passes of the draw list
+				static constexpr uint32_t DRAW_PASS_SHADOW = 0;
+				static constexpr uint32_t DRAW_PASS_DEPTH = 1;
+				static constexpr uint32_t DRAW_PASS_SCENE = 2;
+				static constexpr uint32_t DRAW_PASS_SCENE2 = 3;
 				static inline ECS::ParamId EVENT_PARAM_SHADER = 0x00;
-				static std::recursive_mutex mutex;
+				//Guards the components read by the render system, Draw reads the snapshot and doesn't take it.
+				//It also takes all the component locks used by the world task graphs
+				static ECS::WorldMutex mutex;
 
 				static const std::string WORLD;
 				static const std::string PREV_WORLD;
@@ -132,7 +146,14 @@ namespace HotBite {
 					Components::Lighted* lighted = nullptr;
 					Components::Base* base = nullptr;
 					Components::Bounds* bounds = nullptr;
+					ECS::EntityHandle handle;
+					//Draw list ids of the material shaders and data
+					uint16_t shader_id = 0;
+					uint16_t depth_shader_id = 0;
+					uint16_t shadow_shader_id = 0;
+					uint16_t material_id = 0;
 					DrawableEntity(ECS::Coordinator* c, ECS::Entity entity) {
+						handle = c->GetEntityHandle(entity);
 						transform = &(c->GetComponent<Components::Transform>(entity));
 						mesh = &(c->GetComponent<Components::Mesh>(entity));
 						base = &(c->GetComponent<Components::Base>(entity));
@@ -202,15 +223,155 @@ namespace HotBite {
 				};
 				ECS::Signature camera_signature;
 
-				using RenderTree = std::unordered_map <Core::ShaderKey, std::unordered_map<Core::MaterialData*, std::pair<Components::Material*, ECS::EntityVector<DrawableEntity> > > >;
-				using RenderParticleTree = std::map <Core::ShaderKey, std::map<Core::MaterialData*, std::pair<Core::MaterialData*, ECS::EntityVector<ParticleEntity> > > >;
+				//Reference to a d3d resource held by the render snapshot, it keeps the resource
+				//alive while it's drawn even if the component owning it has been destroyed
+				template<typename T>
+				class ResourceRef {
+				private:
+					T* ptr = nullptr;
+				public:
+					ResourceRef() = default;
+					ResourceRef(const ResourceRef& other) { Reset(other.ptr); }
+					~ResourceRef() { Reset(nullptr); }
+					ResourceRef& operator=(const ResourceRef& other) { Reset(other.ptr); return *this; }
+					void Reset(T* p) {
+						if (p != nullptr) p->AddRef();
+						if (ptr != nullptr) ptr->Release();
+						ptr = p;
+					}
+					T* Get() const { return ptr; }
+				};
+
+				//Drawable data copied from the simulation at the end of each tick, the draw
+				//calls read it instead of the live components
+				struct DrawableState {
+					ECS::EntityHandle handle;
+					float4x4 world_matrix = {};
+					float4x4 prev_world_matrix = {};
+					float4x4 world_inv_matrix = {};
+					float3 position = {};
+					box final_box = {};
+					bool visible = false;
+					//Inside the camera frustum or always drawn
+					bool scene_visible = false;
+					bool cast_shadow = false;
+					bool draw_depth = false;
+					bool is_static = false;
+					uint32_t pass = 1;
+					uint16_t shader_id = 0;
+					uint16_t depth_shader_id = 0;
+					uint16_t shadow_shader_id = 0;
+					uint16_t material_id = 0;
+					Core::MaterialData* material = nullptr;
+					Core::MeshData* mesh = nullptr;
+					uint32_t index_count = 0;
+					size_t index_offset = 0;
+					size_t vertex_offset = 0;
+					//Skeleton joints of the current pose, empty when not animated
+					std::vector<Core::JointGpuData> joints;
+					//Only copied when multi_texture_count > 0
+					Components::MultiMaterial multi_material;
+				};
+
+				struct CameraState {
+					Components::Camera camera;
+					//Position of the camera entity transform
+					float3 position = {};
+				};
+
+				struct SkyState {
+					DrawableState drawable;
+					float second_speed = 1.0f;
+					float cloud_density = 0.5f;
+					float3 current_backcolor = {};
+					Core::MeshData* space_mesh = nullptr;
+					Core::MaterialData* space_material = nullptr;
+					float4x4 spot_view = {};
+				};
+
+				struct PointLightState {
+					Components::PointLight::Data data = {};
+					bool cast_shadow = false;
+					D3D11_VIEWPORT shadow_vp = {};
+					float4x4 view[6] = {};
+					float2 perspective = {};
+					ResourceRef<ID3D11ShaderResourceView> depth_resource;
+					ResourceRef<ID3D11DepthStencilView> depth_view;
+				};
 
-				RenderTree render_tree;
-				RenderTree render_pass2_tree;
-				RenderTree shadow_tree;
-				RenderTree depth_tree;
+				struct DirectionalLightState {
+					Components::DirectionalLight::Data data = {};
+					bool cast_shadow = false;
+					D3D11_VIEWPORT shadow_vp = {};
+					float4x4 view = {};
+					float4x4 static_view = {};
+					ResourceRef<ID3D11ShaderResourceView> depth_resource;
+					ResourceRef<ID3D11DepthStencilView> depth_view;
+					ResourceRef<ID3D11ShaderResourceView> static_depth_resource;
+					ResourceRef<ID3D11DepthStencilView> static_depth_view;
+					//Entities that don't cast shadows with this light, sorted
+					std::vector<ECS::Entity> skip;
+				};
+
+				//Everything Draw reads from the simulation, Draw runs without the render mutex
+				struct RenderSnapshot {
+					uint64_t tick = 0;
+					//Drawables of the render passes, the draw list commands index this vector
+					std::vector<DrawableState> drawables;
+					bool has_second_pass = false;
+					bool has_camera = false;
+					CameraState camera;
+					bool has_sky = false;
+					SkyState sky;
+					bool has_ambient = false;
+					Components::AmbientLight::Data ambient = {};
+					std::vector<PointLightState> point_lights;
+					std::vector<DirectionalLightState> dir_lights;
+					//Shader combinations by draw list id, ids are only appended
+					std::vector<Core::ShaderKey> shader_keys;
+				};
+				Core::TripleBuffer<RenderSnapshot> snapshot;
+				uint64_t snapshot_tick = 0;
+				//Extraction scratch data, world bounds of the drawables and the frustum culling result
+				Core::CullingSet extract_bounds;
+				Core::CullingSet::Bitset extract_visibility;
+				//Spatial index of the snapshot drawables by entity, owned by the render thread
+				Core::SceneIndex scene_index;
+				//Entities in scene_index and their position in the snapshot drawables, both indexed by entity
+				std::vector<ECS::EntityHandle> indexed_handles;
+				std::vector<int32_t> snapshot_index;
+				//Shadow casters in range of the point light being rendered
+				std::vector<Core::DrawList::Command> light_commands;
+
+				//Point lights affecting a drawable (indexes in the snapshot point lights), most relevant first
+				struct LightList {
+					uint16_t count = 0;
+					uint16_t lights[MAX_LIGHTS] = {};
+					float scores[MAX_LIGHTS] = {};
+					bool operator==(const LightList& other) const {
+						return count == other.count && std::equal(lights, lights + count, other.lights);
+					}
+					//Keeps the light if it is more relevant than the least relevant one when the list is full
+					void Insert(uint16_t light, float score);
+				};
+				//Indexed by snapshot drawable
+				std::vector<LightList> light_lists;
+				//Point lights closest to the camera, used by the passes not drawn per drawable (sky, particles, volumetrics...)
+				LightList scene_lights;
+				//Lights set in the current pixel shader, to skip the upload when the next drawable has the same
+				LightList prepared_lights;
+				bool prepared_lights_valid = false;
+
+				using RenderParticleTree = std::map <Core::ShaderKey, std::map<Core::MaterialData*, std::pair<Core::MaterialData*, ECS::EntityVector<ParticleEntity> > > >;
 				RenderParticleTree particle_tree;
 
+				//Draw commands of the frame for all the passes, the command index is the drawable index in the snapshot
+				Core::DrawList draw_list;
+				//Ids of the shader combinations and materials used in the draw keys
+				std::unordered_map<Core::ShaderKey, uint16_t> shader_ids;
+				std::vector<Core::ShaderKey> shader_keys;
+				std::unordered_map<Core::MaterialData*, uint16_t> material_ids;
+
 				Components::Lighted scene_lighting;
 
 				ECS::EntityVector<AmbientLightEntity> ambient_lights;
@@ -218,6 +379,8 @@ namespace HotBite {
 				ECS::EntityVector<DirectionalLightEntity> directional_lights;
 				ECS::EntityVector<CameraEntity> cameras;
 				ECS::EntityVector<SkyEntity> skies;
+				//All the drawables of the render passes, only one entry per entity
+				ECS::EntityVector<DrawableEntity> drawables;
 				Core::VertexBuffer<Vertex>* vertex_buffer = nullptr;
 				ECS::Coordinator* coordinator = nullptr;
 
@@ -236,6 +399,7 @@ namespace HotBite {
 				void OnRegister(ECS::Coordinator* c) override;
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				void OnEntityDestroyed(ECS::Entity entity) override;
+				std::vector<ECS::Signature> GetSignatures() const override;
 
 				void PrepareLights(Core::ISimpleShader* s);
 				void UnprepareLights(Core::ISimpleShader* s);
@@ -338,6 +502,15 @@ namespace HotBite {
 				MaterialProps objectMaterials[MAX_OBJECTS]{};
 				int nobjects = 0;
 				ID3D11ShaderResourceView* diffuseTextures[MAX_OBJECTS]{};
+				//Drawables that can be ray traced in the current frame
+				struct RTCandidate {
+					float distance;
+					uint32_t index;
+					ECS::EntityHandle handle;
+				};
+				std::vector<RTCandidate> rt_candidates;
+				//Objects of the last tbvh build sorted by entity, with their slot in objects
+				std::vector<std::pair<ECS::EntityHandle, uint32_t>> rt_selection;
 				std::mutex rt_mutex;
 				std::condition_variable rt_signal;
 				bool rt_end = false;
@@ -422,7 +595,7 @@ namespace HotBite {
 				void DrawDepth(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection);
 				void DrawScene(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection,
 					ID3D11ShaderResourceView* prev_pass_texture,
-					Core::IRenderTarget* target, RenderTree& tree);
+					Core::IRenderTarget* target, uint32_t pass);
 
 				void LoadRTResources();
 				void ResetRTBBuffers();
@@ -439,24 +612,33 @@ namespace HotBite {
 				void ProcessAntiAlias();
 
 				void DrawParticles(int w, int h, const float3& camera_position, const matrix& view, const matrix& projection, RenderParticleTree& tree);
-				bool IsVisible(const float3& camera_pos, const DrawableEntity& drawable, const matrix& view_projection, int w, int h) const;
-				void CheckSceneVisibility(RenderTree& tree);
+				//Moves the scene index to the drawables of the acquired snapshot
+				void SyncSceneIndex();
 				void PostProcessLight();
 				
 				void PrepareMaterial(Core::MaterialData* material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
 				void UnprepareMaterial(Core::MaterialData* material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
 
-				void PrepareMultiMaterial(Components::Material* material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
-				void UnprepareMultiMaterial(Components::Material* material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
-
-				void PrepareEntity(DrawableEntity& entity, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
-				void UnprepareEntity(DrawableEntity& entity, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
-				void SetEntityLights(Components::Lighted* lighted, ECS::EntityVector<DirectionalLightEntity>& dir_lights, ECS::EntityVector<PointLightEntity>& point_lights);
+				void PrepareMultiMaterial(const Components::MultiMaterial& material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
+				void UnprepareMultiMaterial(const Components::MultiMaterial& material, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
+
+				void PrepareEntity(const DrawableState& entity, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
+				void UnprepareEntity(const DrawableState& entity, Core::SimpleVertexShader* vs, Core::SimpleHullShader* hs, Core::SimpleDomainShader* ds, Core::SimpleGeometryShader* gs, Core::SimplePixelShader* ps);
+				void SetEntityLights(Components::Lighted* lighted, const RenderSnapshot& s);
+				//Selects the MAX_LIGHTS most relevant point lights of every visible drawable
+				void AssignLights();
+				//Selects the MAX_LIGHTS point lights closest to the camera
+				void SelectSceneLights(const float3& camera_position);
+				void PrepareEntityLights(uint32_t index, Core::SimplePixelShader* ps);
+
+				uint16_t GetShaderId(const Core::ShaderKey& key);
+				uint16_t GetMaterialId(Core::MaterialData* material);
+				bool HasSecondPass() const;
+				//Builds and sorts the draw commands of the visible drawables for the current frame
+				void BuildDrawList(const float3& camera_position);
 				
-				void AddDrawable(ECS::Entity entity, const Core::ShaderKey& key, Components::Material* mat, RenderTree& tree, const RenderSystem::DrawableEntity& drawable);
 				void AddParticle(ECS::Entity entity, const Core::ShaderKey& key, Core::MaterialData* mat, RenderParticleTree& tree, const RenderSystem::ParticleEntity& particle);
 				void RemoveParticle(ECS::Entity entity, RenderParticleTree& tree);
-				void RemoveDrawable(ECS::Entity entity, RenderTree& tree);
 
 				void PrepareVolumetricShader(Core::ISimpleShader* ps);
 				void UnprepareVolumetricShader(Core::ISimpleShader* ps);
@@ -472,6 +654,14 @@ namespace HotBite {
 				void SetPostProcessPipeline(Core::PostProcess* pipeline);
 				void Draw();
 				void Update();
+				//Copies the data Draw needs to the render snapshot, called at the end of each simulation tick
+				//with the render mutex locked. corrections are applied to the world matrices of the entities
+				//and their children, see PhysicsSystem::GetInterpolation
+				void Extract(const std::unordered_map<ECS::Entity, matrix>* corrections = nullptr);
+				//Spatial queries over the drawables of the last drawn snapshot, only valid in the render thread
+				const Core::SceneIndex& GetSceneIndex() const;
+				//Build and refit statistics of the ray tracing top level BVH
+				Core::TBVH::Stats GetRTStats();
 				
 				//Render parameters
 				void EnableTessellation(bool enabled);
@@ -43,6 +43,10 @@ void SkySystem::OnRegister(ECS::Coordinator* c) {
 	sky_signature.set(coordinator->GetComponentType<Mesh>(), true);
 }
 
+std::vector<Signature> SkySystem::GetSignatures() const {
+	return { sky_signature };
+}
+
 
 void SkySystem::OnEntityDestroyed(Entity entity) {
 	skies.Remove(entity);
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include <Components\Physics.h>
+#include <Core\JobSystem.h>
 #include "StaticMeshSystem.h"
 
 using namespace HotBite::Engine;
@@ -39,6 +40,10 @@ void StaticMeshSystem::OnRegister(ECS::Coordinator* c) {
 	signature.set(coordinator->GetComponentType<Base>(), true);
 }
 
+std::vector<Signature> StaticMeshSystem::GetSignatures() const {
+	return { signature };
+}
+
 
 void StaticMeshSystem::OnEntityDestroyed(ECS::Entity entity) {
 	static_meshes.Remove(entity);
@@ -68,28 +73,24 @@ void StaticMeshSystem::Init(StaticMeshEntity& entity) {
 
 	//Init default values
 	entity.transform->dirty = true;
-	Update(entity, 0, 0);
+	if (Update(entity, false, 0, 0)) {
+		coordinator->SendEvent(this, entity.base->id, Transform::EVENT_ID_TRANSFORM_CHANGED);
+	}
 }
 
-void StaticMeshSystem::Update(StaticMeshEntity& entity, int64_t elapsed_nsec, int64_t total_nsec) {
+bool StaticMeshSystem::ParentMoved(ECS::Entity parent) {
+	//A dirty parent was moved and has not been processed yet, or has no system processing it
+	return parent != ECS::INVALID_ENTITY_ID && (moved.count(parent) > 0 || coordinator->GetComponent<Transform>(parent).dirty);
+}
+
+bool StaticMeshSystem::Update(StaticMeshEntity& entity, bool parent_moved, int64_t elapsed_nsec, int64_t total_nsec) {
 	Transform* transform = entity.transform;
 	Bounds* bounds = entity.bounds;
 	Base* base = entity.base;
 	Mesh* mesh = entity.mesh;
 
-	//We only update view if invalid
-	float3 parent_position = {};
-	float4 parent_rotation = {};
-	if (entity.base->parent != ECS::INVALID_ENTITY_ID) {
-		Components::Transform& t = coordinator->GetComponent<Components::Transform>(entity.base->parent);
-		parent_position = t.position;
-		parent_rotation = t.rotation;
-
-	}
-
-	if ((entity.transform->dirty ||
-		(entity.base->parent != ECS::INVALID_ENTITY_ID && 
-		(entity.transform->last_parent_position != parent_position || entity.transform->last_parent_rotation != parent_rotation)))) {
+	//We only update view if invalid or the parent has moved
+	if (entity.transform->dirty || parent_moved) {
 		auto minV = mesh->GetData()->minDimensions;
 		auto maxV = mesh->GetData()->maxDimensions;
 		
@@ -129,24 +130,40 @@ void StaticMeshSystem::Update(StaticMeshEntity& entity, int64_t elapsed_nsec, in
 		local_oriented.Extents = bounds->local_box.Extents;
 		local_oriented.Transform(bounds->bounding_box, transform->world_xmmatrix);
 
-		coordinator->SendEvent(this, base->id, Transform::EVENT_ID_TRANSFORM_CHANGED);
-		entity.transform->last_parent_position = parent_position;
-		entity.transform->last_parent_rotation = parent_rotation;
+		coordinator->MarkComponentChanged<Transform>(base->id);
 		transform->dirty = false;
+		return true;
 	}
+	return false;
 }
 
 void StaticMeshSystem::Update(ECS::Entity entity, int64_t elapsed_nsec, int64_t total_nsec) {
 	StaticMeshEntity* se = static_meshes.Get(entity);
-	if (se) {
-		Update(*se, elapsed_nsec, total_nsec);
+	if (se && Update(*se, ParentMoved(se->base->parent), elapsed_nsec, total_nsec)) {
+		coordinator->SendEvent(this, entity, Transform::EVENT_ID_TRANSFORM_CHANGED);
 	}
 }
 
 void StaticMeshSystem::Update(int64_t elapsed_nsec, int64_t total_nsec) {
-	for (auto it = static_meshes.GetData().begin(); it != static_meshes.GetData().end(); ++it)
-	{
-		Update(*it, elapsed_nsec, total_nsec);
+	//Root entities only move when their transform is dirty, they are independent and updated in parallel
+	Core::JobSystem::ParallelForEach(static_meshes, [this, elapsed_nsec, total_nsec](StaticMeshEntity& e) {
+		e.changed = (e.base->parent == ECS::INVALID_ENTITY_ID) && Update(e, false, elapsed_nsec, total_nsec);
+	});
+	//Children follow the transforms changed since the last update, roots included. They read the
+	//parent transform so they are updated afterwards in this thread, a moved child moves its own children
+	uint64_t since = transforms_version;
+	transforms_version = coordinator->GetComponentsVersion<Transform>();
+	moved.clear();
+	coordinator->ForEachChanged<Transform>(since, [this](ECS::Entity e, Transform&) { moved.insert(e); });
+	for (StaticMeshEntity& e : static_meshes) {
+		if (e.base->parent != ECS::INVALID_ENTITY_ID) {
+			e.changed = Update(e, ParentMoved(e.base->parent), elapsed_nsec, total_nsec);
+			if (e.changed) {
+				moved.insert(e.base->id);
+			}
+		}
+		if (e.changed) {
+			coordinator->SendEvent(this, e.base->id, Transform::EVENT_ID_TRANSFORM_CHANGED);
+		}
 	}
 }
-
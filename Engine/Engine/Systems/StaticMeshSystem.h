@@ -28,6 +28,7 @@ SOFTWARE.
 
 #include <ECS\Coordinator.h>
 #include <ECS\EntityVector.h>
+#include <unordered_set>
 
 namespace HotBite {
 	namespace Engine {
@@ -39,6 +40,8 @@ namespace HotBite {
 					Components::Bounds *bounds;
 					Components::Mesh* mesh;
 					Components::Base* base;
+					//Set by the update when the transform has changed
+					bool changed = false;
 
 					StaticMeshEntity(ECS::Coordinator* c, ECS::Entity entity) {
 						transform = &(c->GetComponent<Components::Transform>(entity));
@@ -51,14 +54,21 @@ namespace HotBite {
 				ECS::Coordinator* coordinator = nullptr;
 				ECS::Signature signature;
 				ECS::EntityVector<StaticMeshEntity> static_meshes;
+				//Transform version of the last update and the entities moved since then, children follow them
+				uint64_t transforms_version = 0;
+				std::unordered_set<ECS::Entity> moved;
+
+				bool ParentMoved(ECS::Entity parent);
 				
 			public:
 				void OnRegister(ECS::Coordinator* c) override;
 				void OnEntitySignatureChanged(ECS::Entity entity, const ECS::Signature& entity_signature) override;
 				void OnEntityDestroyed(ECS::Entity entity) override;
+				std::vector<ECS::Signature> GetSignatures() const override;
 				//Mesh entity methods
 				void Init(StaticMeshEntity& entity);
-				void Update(StaticMeshEntity& entity, int64_t elapsed_nsec, int64_t total_nsec);
+				//Returns true if the transform has changed, thread safe for entities without parent
+				bool Update(StaticMeshEntity& entity, bool parent_moved, int64_t elapsed_nsec, int64_t total_nsec);
 
 			public:
 				StaticMeshSystem() = default;
@@ -22,10 +22,12 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <filesystem>
 #include "World.h"
 #include <Network/LockStepClient.h>
 #include <Core/PhysicsCommon.h>
+#include <Core/Profiler.h>
 #include <Components/Sky.h>
 #include <Network/Commons.h>
 
@@ -371,6 +373,9 @@ void World::LoadTemplate(const std::string& template_file, bool triangulate, boo
 
 bool World::Load(const std::string& scene_file, float* progress, std::function<void(float)> OnLoadProgress, float progress_unit) {
 	bool ret = true;
+	//Entities get components from several places of the scene,
+	//notify systems only once per entity at the end of the load
+	coordinator->BeginNotificationBatch();
 	try {
 		//Load json world
 		json scene = json::parse(std::ifstream(scene_file));
@@ -685,6 +690,7 @@ bool World::Load(const std::string& scene_file, float* progress, std::function<v
 		printf("World::Load: Fail: %s\n", e.what());
 		assert(false && "Bad world.");
 	}
+	coordinator->EndNotificationBatch();
 
 	printf("Worl load DONE: %llu entities loaded\n", coordinator->GetEntites().size());
 	return ret;
@@ -747,12 +753,14 @@ void World::Init() {
 			Components::Transform& t = coordinator->GetComponent<Components::Transform>(e.second);
 			Components::Bounds& b = coordinator->GetComponent<Components::Bounds>(e.second);
 			Components::Base& base = coordinator->GetComponent<Components::Base>(e.second);
+			//Entity names are indexed as views, the shapes are keyed by std::string
+			std::string name(e.first);
 			if (p.type != reactphysics3d::BodyType::DYNAMIC) {
 				//Dynamic bodies use capsules, can't use mesh shape
-				shape = shapes.Get(e.first);
+				shape = shapes.Get(name);
 			}
 			if (shape == nullptr) {
-				printf("No shape for mesh %s\n", e.first.c_str());
+				printf("No shape for mesh %s\n", name.c_str());
 			}
 			p.Init(phys_world, p.type, shape, b.bounding_box.Extents, t.position, t.scale, t.rotation, p.shape);
 			
@@ -766,6 +774,112 @@ void World::Init() {
 	bvh_buffer->Prepare();
 }
 
+void World::SetPhysicsFixedStep(int64_t step_nsec) {
+	physics_mutex.lock();
+	physics_fixed_step = step_nsec;
+	physics_accumulator = 0;
+	physics_step_time = Scheduler::GetNanoSeconds();
+	physics_mutex.unlock();
+}
+
+void World::StepPhysics(int64_t elapsed_nsec) {
+	HOTBITE_PROFILE_ZONE("World::StepPhysics");
+	physics_accumulator += elapsed_nsec;
+	int steps = 0;
+	while (physics_accumulator >= physics_fixed_step) {
+		if (steps == MAX_PHYSICS_SUBSTEPS) {
+			//Too far behind, drop the time instead of making the next frames slower
+			physics_accumulator %= physics_fixed_step;
+			break;
+		}
+		physics_system->SaveState();
+		phys_world->update((float)physics_fixed_step / 1000000000.0f);
+		physics_accumulator -= physics_fixed_step;
+		++steps;
+	}
+	physics_step_time = Scheduler::GetNanoSeconds();
+}
+
+float World::GetPhysicsAlpha() const {
+	//At the last step the bodies were physics_accumulator behind the real time, they are drawn one step late
+	int64_t behind = physics_accumulator + Scheduler::GetNanoSeconds() - physics_step_time;
+	return std::clamp((float)behind / (float)physics_fixed_step, 0.0f, 1.0f);
+}
+
+void World::BuildFrameGraph() {
+	//Tasks are declared in the order they must be seen to run, the graph only runs concurrently
+	//the ones that don't touch the same components. The systems that only touch their declared
+	//components run in the job system holding the component locks, so they run in parallel with the
+	//other tasks of both graphs using other components. The render mutex takes all the component
+	//locks, the tasks sending events to game code or touching physics take it and run in the
+	//graph thread.
+	ECS::Coordinator* c = coordinator;
+	ECS::ComponentLocks* locks = &render_system->mutex.GetComponentLocks();
+	frame_graph.Clear();
+	frame_graph.SetComponentLocks(locks);
+	frame_graph.AddTask("physics", c->MakeSignature<Components::Base>(), c->MakeSignature<Components::Transform, Components::Bounds, Components::Physics>(), [this]() {
+		//Transform changed events are sent to the game listeners
+		std::lock_guard l(render_system->mutex);
+		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
+		if (physics_fixed_step == 0) {
+			phys_world->update((float)frame_period / 1000000000.0f);
+		}
+		physics_system->Update(frame_period, frame_total, false);
+		}, true);
+	frame_graph.AddTask("camera", c->MakeSignature<Components::Base>(), c->MakeSignature<Components::Camera, Components::Transform>(), [this]() {
+		//Camera moved events are sent to the game listeners
+		std::lock_guard l(render_system->mutex);
+		camera_system->Update(frame_period, frame_total);
+		}, true);
+	frame_graph.AddExclusiveTask("events", [this]() {
+		std::lock_guard l(render_system->mutex);
+		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
+		//Dispatch typed events posted by the other threads (animations, collisions...)
+		coordinator->FlushEvents();
+		coordinator->SendEvent(this, World::EVENT_ID_UPDATE_BACKGROUND);
+		});
+
+	background_graph.Clear();
+	background_graph.SetComponentLocks(locks);
+	background_graph.AddTask("animation", c->MakeSignature<Components::Base>(), c->MakeSignature<Components::Mesh>(), [this]() {
+		animation_mesh_system->Update(background_period, background_total);
+		});
+	background_graph.AddTask("sky", c->MakeSignature<Components::Base>(), c->MakeSignature<Components::Sky, Components::Transform, Components::DirectionalLight, Components::AmbientLight>(), [this]() {
+		sky_system->Update(background_period, background_total);
+		});
+	background_graph.AddTask("static_mesh", c->MakeSignature<Components::Base, Components::Mesh>(), c->MakeSignature<Components::Transform, Components::Bounds>(), [this]() {
+		//Transform changed events are sent to the game listeners
+		std::lock_guard l(render_system->mutex);
+		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
+		static_mesh_system->Update(background_period, background_total);
+		}, true);
+	background_graph.AddTask("dirlight", c->MakeSignature<Components::Base, Components::Camera, Components::Transform>(), c->MakeSignature<Components::DirectionalLight>(), [this]() {
+		dirlight_system->Update(background_period, background_total);
+		});
+	background_graph.AddTask("pointlight", c->MakeSignature<Components::Base>(), c->MakeSignature<Components::PointLight, Components::Transform>(), [this]() {
+		//Parent transforms written by physics are covered by the Transform lock
+		pointlight_system->Update(background_period, background_total);
+		});
+	background_graph.AddExclusiveTask("events", [this]() {
+		std::lock_guard l(render_system->mutex);
+		coordinator->SendEvent(this, World::EVENT_ID_UPDATE_BACKGROUND2);
+		});
+	background_graph.AddTask("render_extract", c->MakeSignature<Components::Transform, Components::Bounds, Components::Mesh, Components::Material, Components::Camera,
+		Components::Sky, Components::AmbientLight, Components::DirectionalLight, Components::PointLight>(), c->MakeSignature<Components::Base>(), [this]() {
+		//Publish the state of this tick to the renderer, it also writes the scene visibility to the base component
+		std::lock_guard l(render_system->mutex);
+		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
+		if (physics_fixed_step > 0) {
+			//Bodies are drawn interpolated between the last two fixed steps at the snapshot time
+			physics_system->GetInterpolation(GetPhysicsAlpha(), physics_corrections);
+			render_system->Extract(&physics_corrections);
+		}
+		else {
+			render_system->Extract();
+		}
+		}, true);
+}
+
 void World::Run(int render_fps, int background_fps, int physics_fps) {
 	if (!running) {
 		running = true;
@@ -783,70 +897,90 @@ void World::Run(int render_fps, int background_fps, int physics_fps) {
 
 			run_timer_ids[DXCore::MAIN_THREAD].push_back(Scheduler::Get(DXCore::MAIN_THREAD)->RegisterTimer(1000000000 / render_fps, [this](const Scheduler::TimerData& t) {
 				//Update render system that don't need sync with lockstep
-				particle_system->Update(t.period, t.total);
-				render_system->Update();
-				render_system->mutex.lock();
-				coordinator->SendEvent(this, World::EVENT_ID_UPDATE_MAIN);
+				{
+					HOTBITE_PROFILE_ZONE("ParticleSystem::Update");
+					particle_system->Update(t.period, t.total);
+				}
+				{
+					HOTBITE_PROFILE_ZONE("RenderSystem::Update");
+					render_system->Update();
+				}
+				{
+					HOTBITE_PROFILE_ZONE("World::WaitRenderLock");
+					render_system->mutex.lock();
+				}
+				{
+					HOTBITE_PROFILE_ZONE("World::UpdateMainEvent");
+					coordinator->SendEvent(this, World::EVENT_ID_UPDATE_MAIN);
+				}
 				render_system->mutex.unlock();
 				return true;
-				}));
+				}, "World::Main"));
 
+			BuildFrameGraph();
 			run_timer_ids[DXCore::BACKGROUND_THREAD].push_back(Scheduler::Get(DXCore::BACKGROUND_THREAD)->RegisterTimer(background_thread_period, [this](const Scheduler::TimerData& t) {
 				//Update systems that need sync with lockstep
 				if (lockstep_sync) {
 					while (current_background_thread_nsec >= current_server_nsec) { Sleep(1); }
 				}
-				render_system->mutex.lock();
+				frame_period = t.period;
+				frame_total = t.total;
 				physics_mutex.lock();
-				//physics systems moves information to transform component used by the renderer,
-				//so we need to take the renderer lock for this
-				phys_world->update((float)t.period / 1000000000.0f);
-				physics_system->Update(t.period, t.total, false);
-				camera_system->Update(t.period, t.total);
-				coordinator->SendEvent(this, World::EVENT_ID_UPDATE_BACKGROUND);
+				if (physics_fixed_step > 0) {
+					//Fixed steps don't touch components, so they run without blocking the renderer
+					StepPhysics(t.period);
+				}
+				physics_mutex.unlock();
+				{
+					HOTBITE_PROFILE_ZONE("World::WaitBackgroundLocks");
+					render_system->mutex.lock();
+					physics_mutex.lock();
+				}
+				{
+					//Sync point: apply structural changes recorded by other threads
+					HOTBITE_PROFILE_ZONE("Coordinator::PlaybackCommands");
+					coordinator->PlaybackCommands();
+				}
 				physics_mutex.unlock();
 				render_system->mutex.unlock();
+				frame_graph.Run();
 				current_background_thread_nsec += background_thread_period;
 				return true;
-				}));
+				}, "World::Background"));
 
 			run_timer_ids[DXCore::BACKGROUND2_THREAD].push_back(Scheduler::Get(DXCore::BACKGROUND2_THREAD)->RegisterTimer(background_thread_period, [this](const Scheduler::TimerData& t) {
-				//Update systems that don't need sync with lockstep nor physics dependencies
-				render_system->mutex.lock();
-				sky_system->Update(t.period, t.total);
-				animation_mesh_system->Update(t.period, t.total);
-				coordinator->SendEvent(this, World::EVENT_ID_UPDATE_BACKGROUND2);
-				render_system->mutex.unlock();
+				//Update systems that don't need sync with lockstep
+				background_period = t.period;
+				background_total = t.total;
+				background_graph.Run();
 				return true;
-				}));
+				}, "World::Background2"));
 
 			run_timer_ids[DXCore::BACKGROUND3_THREAD].push_back(Scheduler::Get(DXCore::BACKGROUND3_THREAD)->RegisterTimer(background_thread_period, [this](const Scheduler::TimerData& t) {
-				//Update systems that don't need sync with lockstep but physics dependencies,
-				//Entities can have parents whose transform is updated by physics so we need 
-				//to take the physics lock for this
+				//Game systems that don't need sync with lockstep but physics dependencies
 				render_system->mutex.lock();
 				physics_mutex.lock();
-				static_mesh_system->Update(t.period, t.total);
-				dirlight_system->Update(t.period, t.total);
-				pointlight_system->Update(t.period, t.total);
 				coordinator->SendEvent(this, World::EVENT_ID_UPDATE_BACKGROUND3);
 				physics_mutex.unlock();
 				render_system->mutex.unlock();
 				return true;
-				}));
+				}, "World::Background3"));
 
 			run_timer_ids[DXCore::PHYSICS_THREAD].push_back(Scheduler::Get(DXCore::PHYSICS_THREAD)->RegisterTimer(physics_thread_period, [this](const Scheduler::TimerData& t) {
 				//Update physics that need sync with lockstep
 				if (lockstep_sync) {
 					while (current_physics_thread_nsec >= current_server_nsec) { Sleep(1); }
 				}
-				physics_mutex.lock();
+				{
+					HOTBITE_PROFILE_ZONE("World::WaitPhysicsLock");
+					physics_mutex.lock();
+				}
 				//phys_world->update((float)t.period / 1000000000.0f);			
 				coordinator->SendEvent(this, World::EVENT_ID_UPDATE_PHYSICS);
 				physics_mutex.unlock();
 				current_physics_thread_nsec += physics_thread_period;
 				return true;
-				}));
+				}, "World::Physics"));
 		}
 	}
 }
@@ -854,17 +988,14 @@ void World::Run(int render_fps, int background_fps, int physics_fps) {
 void World::Stop() {
 	if (running) {
 		running = false;
+		//No world locks here, removal waits for the running callbacks and they take them
 		for (int i = 0; i < DXCore::NTHREADS; ++i) {
-			render_system->mutex.lock();
-			physics_mutex.lock();
 			while (!run_timer_ids[i].empty()) {
-				Scheduler::Get(i)->RemoveTimerAsync(run_timer_ids[i].front());
+				Scheduler::Get(i)->RemoveTimer(run_timer_ids[i].front());
 				run_timer_ids[i].pop_front();
 			}
-			coordinator->GetSystem<AudioSystem>()->Stop();
-			physics_mutex.unlock();
-			render_system->mutex.unlock();
 		}
+		coordinator->GetSystem<AudioSystem>()->Stop();
 	}
 }
 
@@ -32,6 +32,7 @@ SOFTWARE.
 #include <set>
 #include <Loader\FBXLoader.h>
 #include <ECS/Coordinator.h>
+#include <ECS/TaskGraph.h>
 #include <Systems\CameraSystem.h>
 #include <Systems\DirectionalLightSystem.h>
 #include <Systems\PhysicsSystem.h>
@@ -88,10 +89,10 @@ namespace HotBite {
 			std::string path;
 			std::unordered_map<std::string, std::set<ECS::Entity>> template_entities;
 			std::unordered_map<std::string, nlohmann::json> multi_materials;
-			Core::FlatMap<std::string, Core::MaterialData> materials{ ECS::MAX_ENTITIES };
-			Core::FlatMap<std::string, Core::MeshData> meshes{ ECS::MAX_ENTITIES };
-			Core::FlatMap<std::string, Core::ShapeData> shapes{ ECS::MAX_ENTITIES };
-			Core::FlatMap<std::string, std::shared_ptr<Core::Skeleton>> animations{ ECS::MAX_ENTITIES };
+			Core::FlatMap<std::string, Core::MaterialData> materials{ ECS::RESERVED_ENTITIES };
+			Core::FlatMap<std::string, Core::MeshData> meshes{ ECS::RESERVED_ENTITIES };
+			Core::FlatMap<std::string, Core::ShapeData> shapes{ ECS::RESERVED_ENTITIES };
+			Core::FlatMap<std::string, std::shared_ptr<Core::Skeleton>> animations{ ECS::RESERVED_ENTITIES };
 
 			ECS::Coordinator* coordinator = nullptr;
 			ECS::Coordinator* templates_coordinator = nullptr;
@@ -110,10 +111,29 @@ namespace HotBite {
 			bool init = false;
 			std::unordered_map<std::string, std::shared_ptr<ECS::System>> systems_by_name;
 			std::list<int> run_timer_ids[Core::DXCore::NTHREADS];
+			//Systems updated each background frame, scheduled by their component access.
+			//frame_graph runs the systems synced with lockstep, background_graph the ones that
+			//don't need it, so they keep running while the lockstep waits for the server.
+			ECS::TaskGraph frame_graph;
+			ECS::TaskGraph background_graph;
+			int64_t frame_period = 0;
+			int64_t frame_total = 0;
+			int64_t background_period = 0;
+			int64_t background_total = 0;
+			//Fixed step physics, 0 steps physics once per background frame with the frame period
+			static constexpr int MAX_PHYSICS_SUBSTEPS = 8;
+			int64_t physics_fixed_step = 0;
+			int64_t physics_accumulator = 0;
+			//Time of the last StepPhysics, the snapshot interpolation adds the time elapsed since then
+			int64_t physics_step_time = 0;
+			std::unordered_map<ECS::Entity, matrix> physics_corrections;
 			std::set<std::string> loaded_files;
 
 			void OnLockStepTick(ECS::Event& ev);
 			void SetupCoordinator(ECS::Coordinator* c);
+			void BuildFrameGraph();
+			void StepPhysics(int64_t elapsed_nsec);
+			float GetPhysicsAlpha() const;
 			void LoadSky(const nlohmann::json& sky_info);
 			std::set<ECS::Entity> LoadFBX(const std::string& file, bool triangulate, bool relative,
 							Core::FlatMap<std::string, Core::MaterialData>& materials,
@@ -178,6 +198,19 @@ namespace HotBite {
 			Core::FlatMap<std::string, Core::ShapeData>& GetShapes();
 			Core::FlatMap<std::string, std::shared_ptr<Core::Skeleton>>& GetSkeletons();
 			reactphysics3d::PhysicsWorld* GetPhysicsWorld();
+			//Runs physics in fixed steps of step_nsec (0 disables it). Transform components keep the
+			//stepped state, the render snapshot interpolates the bodies between the last two steps
+			void SetPhysicsFixedStep(int64_t step_nsec);
+
+			//Timing of the last lockstep background frame, including its critical path
+			const ECS::TaskGraph::Report& GetFrameReport() const {
+				return frame_graph.GetReport();
+			}
+
+			//Timing of the last background frame of the systems not synced with lockstep
+			const ECS::TaskGraph::Report& GetBackgroundFrameReport() const {
+				return background_graph.GetReport();
+			}
 
 			template<class T>
 			std::shared_ptr<T>  GetSystem() {
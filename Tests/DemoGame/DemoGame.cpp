@@ -387,7 +387,7 @@ public:
 						render->SetDOF(!render->GetDOF());
 					}
 					else if (GetAsyncKeyState('1') & 0x8000) {
-						std::lock_guard<std::recursive_mutex> l(world.GetCoordinator()->GetSystem<RenderSystem>()->mutex);
+						std::lock_guard l(world.GetCoordinator()->GetSystem<RenderSystem>()->mutex);
 						ShaderFactory::Get()->Reload();
 					}
 					else if (GetAsyncKeyState('Y') & 0x8000) {
@@ -413,7 +413,7 @@ public:
 
 
 			//We create a periodic timer to spawn a new fireballs in the scene evey 10 seconds.
-			//It's important to create the fireballs in the rendering thread, as DirectX 11 requires only one thread
+			//The fireballs are recorded in a command buffer and created at the world sync point, with the renderer locked
 			Scheduler::Get(DXCore::MAIN_THREAD)->RegisterTimer(SEC_TO_NSEC(10), [this](const Scheduler::TimerData& td) {
 				static int i = 0;
 			SpawnFireBall(i++);
@@ -586,7 +586,7 @@ public:
 		Scheduler::Get(DXCore::BACKGROUND3_THREAD)->RegisterTimer(1000000000, [this, sky, label2](const Scheduler::TimerData& t) {
 				//This is a timer to update every second the information of the sky component (time of day, time speed and cloud density)
 				ECS::Coordinator* c = world.GetCoordinator();
-				std::lock_guard<std::recursive_mutex> l(c->GetSystem<RenderSystem>()->mutex);
+				std::lock_guard l(c->GetSystem<RenderSystem>()->mutex);
 				label2->SetText("Time: %02d:%02d:%02d\nTime Speed (U/I): x%0.2f\nClouds(O/P): %0.2f\n",
 				(sky->current_minute / 60) % 24, sky->current_minute % 60,
 				(int)sky->second_of_day % 60, sky->second_speed, sky->cloud_density);
@@ -595,57 +595,64 @@ public:
 	}
 
 	std::unordered_map<ECS::Entity, int64_t> last_ball_sound_ts;
+	//Live fireballs, oldest first. Spawning records them and the playback of the spawn fills the handles
+	Core::spin_lock fireballs_lock;
+	std::deque<ECS::EntityHandle> fireballs;
 	//This method spawns a new fireball in the scene
 	void SpawnFireBall(int id) {
 		return;
 		ECS::Coordinator* c = world.GetCoordinator();
-		//NOTE: Always lock first renderer mutex before physics mutex to avoid interlock
-		shared_ptr<RenderSystem> rs = c->GetSystem<RenderSystem>();
-		rs->mutex.lock();
-		physics_mutex.lock();
-		if (id > 5) {
-			//Maximum 5 fireballs in the scene to avoid avorload of particles
-			//we can just remove the entity of the old fireball
-			std::string name2 = "_Ball_" + std::to_string(id - 6);
-			ECS::Entity ball = c->GetEntityByName(name2);
-			if (ball != ECS::INVALID_ENTITY_ID) {
-				c->DestroyEntity(ball);
+		//The spawn is recorded without locking the world, the background thread plays it back
+		//at its sync point with the renderer and physics mutex taken.
+		ECS::CommandBuffer cb;
+		{
+			Core::AutoLock l(fireballs_lock);
+			if (fireballs.size() >= 5) {
+				//Maximum 5 fireballs in the scene to avoid avorload of particles
+				//we can just remove the entity of the old fireball, skipped if it's already gone
+				cb.DestroyEntity(fireballs.front());
+				fireballs.pop_front();
 			}
 		}
 		{
 			std::string name = "_Ball_" + std::to_string(id);
-			ECS::Entity ball = c->CreateEntity(name);
-
-			c->AddComponent<Base>(ball, { .name = name, .id = ball, .draw_method = eDrawMethod::DRAW_SCREEN });
-			c->AddComponent<Bounds>(ball, c->GetConstComponent<Bounds>(c->GetEntityByName("Ball")));
-			c->AddComponent<Mesh>(ball);
-			c->AddComponent<Lighted>(ball);
-			c->AddComponent<Material>(ball, { .data = world.GetMaterials().Get("Ball") });
-			c->AddComponent<Transform>(ball, { .position = fireball_spawn_position });
-			c->AddComponent<Physics>(ball, Physics{});
-			Mesh& m = c->GetComponent<Mesh>(ball);
-			Bounds& b = c->GetComponent<Bounds>(ball);
-			Physics& p = c->GetComponent<Physics>(ball);
-			Transform& t = c->GetComponent<Transform>(ball);
-			m.SetData(world.GetMeshes().Get("Ball"));
-			p.type = reactphysics3d::BodyType::DYNAMIC;
-			p.shape = Physics::SHAPE_SPHERE;
-			p.Init(world.GetPhysicsWorld(), p.type, nullptr, b.bounding_box.Extents, t.position, t.scale, t.rotation, p.shape);
-			SetupFireBall(ball);
-			c->GetSystem<AudioSystem>()->Play(2, 0, true, 1.0f, 10.0f, true, ball);
-			c->AddEventListenerByEntity(PhysicsSystem::EVENT_ID_COLLISION_START, ball, [=] (Event& ev) {
-				if (ev.GetEntity() == ball) {
-					int64_t now = Scheduler::GetNanoSeconds();
-					if (now - last_ball_sound_ts[ball] > MSEC_TO_NSEC(200)) {
-						c->GetSystem<AudioSystem>()->Play(RandType(17, 19).Value(), 0, false, RandType(0.8f, 1.2f).Value(), RandType(10.0f, 15.0f).Value(), true, ball);
-						last_ball_sound_ts[ball] = now;
+			ECS::EntityHandle ball = cb.CreateEntity(name);
+
+			cb.Exec(ball, [name](ECS::Coordinator* c, ECS::Entity e) {
+				c->AddComponent<Base>(e, { .name = name, .id = e, .draw_method = eDrawMethod::DRAW_SCREEN });
+				c->AddComponent<Bounds>(e, c->GetConstComponent<Bounds>(c->GetEntityByName("Ball")));
+				});
+			cb.AddComponent<Mesh>(ball);
+			cb.AddComponent<Lighted>(ball);
+			cb.AddComponent<Material>(ball, { .data = world.GetMaterials().Get("Ball") });
+			cb.AddComponent<Transform>(ball, { .position = fireball_spawn_position });
+			cb.AddComponent<Physics>(ball, Physics{});
+			cb.Exec(ball, [this](ECS::Coordinator* c, ECS::Entity ball) {
+				Mesh& m = c->GetComponent<Mesh>(ball);
+				Bounds& b = c->GetComponent<Bounds>(ball);
+				Physics& p = c->GetComponent<Physics>(ball);
+				Transform& t = c->GetComponent<Transform>(ball);
+				m.SetData(world.GetMeshes().Get("Ball"));
+				p.type = reactphysics3d::BodyType::DYNAMIC;
+				p.shape = Physics::SHAPE_SPHERE;
+				p.Init(world.GetPhysicsWorld(), p.type, nullptr, b.bounding_box.Extents, t.position, t.scale, t.rotation, p.shape);
+				SetupFireBall(ball);
+				c->GetSystem<AudioSystem>()->Play(2, 0, true, 1.0f, 10.0f, true, ball);
+				c->AddEventListenerByEntity<PhysicsSystem::CollisionStartEvent>(ball, [=](const PhysicsSystem::CollisionStartEvent& ev) {
+					if (ev.entity == ball) {
+						int64_t now = Scheduler::GetNanoSeconds();
+						if (now - last_ball_sound_ts[ball] > MSEC_TO_NSEC(200)) {
+							c->GetSystem<AudioSystem>()->Play(RandType(17, 19).Value(), 0, false, RandType(0.8f, 1.2f).Value(), RandType(10.0f, 15.0f).Value(), true, ball);
+							last_ball_sound_ts[ball] = now;
+						}
 					}
-				}
+					});
+				Core::AutoLock l(fireballs_lock);
+				fireballs.push_back(c->GetEntityHandle(ball));
 				});
-			c->NotifySignatureChange(ball);
+			cb.NotifySignatureChange(ball);
 		}
-		physics_mutex.unlock();
-		rs->mutex.unlock();
+		c->Submit(std::move(cb));
 	}
 
 	void SetupFireBall(ECS::Entity ball) {
@@ -71,7 +71,7 @@ public:
 		if ((entity_signature & enemy_signature) == enemy_signature)
 		{
 			enemies.Insert(entity, GameEnemyData{ coordinator, entity });
-			AddEventListenerByEntity(Mesh::EVENT_ID_ANIMATION_END, entity, std::bind(&EnemySystem::OnAnimationEnd, this, std::placeholders::_1));
+			AddEventListenerByEntity<Mesh::AnimationEndEvent>(entity, std::bind(&EnemySystem::OnAnimationEnd, this, std::placeholders::_1));
 		}
 		else {
 			enemies.Remove(entity);
@@ -85,11 +85,12 @@ public:
 		}
 	}
 
-	void OnAnimationEnd(Event& ev) {
-		ECS::Entity e = ev.GetEntity();
+	void OnAnimationEnd(const Mesh::AnimationEndEvent& ev) {
+		ECS::Entity e = ev.entity;
 		GameEnemyData* enemy = enemies.Get(e);
 		if (enemy) {
-			if (enemy->mesh->GetCurrentAnimationName() == enemy->creature->animations[CreatureAnimations::ANIM_ATTACK]) {
+			//Events are delivered deferred, check the animation that ended, not the current one
+			if (ev.animation_name == enemy->creature->animations[CreatureAnimations::ANIM_ATTACK]) {
 				enemy->enemy->is_attacking = false;
 			}
 		}
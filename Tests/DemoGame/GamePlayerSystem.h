@@ -121,8 +121,8 @@ public:
 			GamePlayerData pd{ coordinator, entity };
 			spawn_transform = pd.physics->body->getTransform();
 			players.Insert(entity, GamePlayerData{ coordinator, entity });
-			AddEventListenerByEntity(Mesh::EVENT_ID_ANIMATION_END, entity, std::bind(&GamePlayerSystem::OnAnimationEnd, this, std::placeholders::_1));
-			AddEventListenerByEntity(Mesh::EVENT_ID_ANIMATION_FRAME_EVENT, entity, std::bind(&GamePlayerSystem::OnAnimationFrameEvent, this, std::placeholders::_1));
+			AddEventListenerByEntity<Mesh::AnimationEndEvent>(entity, std::bind(&GamePlayerSystem::OnAnimationEnd, this, std::placeholders::_1));
+			AddEventListenerByEntity<Mesh::AnimationFrameEvent>(entity, std::bind(&GamePlayerSystem::OnAnimationFrameEvent, this, std::placeholders::_1));
 		}
 		else {
 			players.Remove(entity);
@@ -153,7 +153,7 @@ public:
 	}
 
 	void Respawn() {
-		std::lock_guard<std::recursive_mutex> l1(coordinator->GetSystem<RenderSystem>()->mutex);
+		std::lock_guard l1(coordinator->GetSystem<RenderSystem>()->mutex);
 		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
 		GamePlayerData& p = players.GetData().front();
 		
@@ -171,7 +171,7 @@ public:
 	//Update player animation
 	void Update(int64_t elapsed_nsec, int64_t total_nsec) {
 		//We work with just 1 player
-		std::lock_guard<std::recursive_mutex> l1(coordinator->GetSystem<RenderSystem>()->mutex);
+		std::lock_guard l1(coordinator->GetSystem<RenderSystem>()->mutex);
 		std::lock_guard<std::recursive_mutex> l2(physics_mutex);
 		assert(players.GetData().size() == 1);
 		GamePlayerData& p = players.GetData().front();
@@ -271,10 +271,10 @@ public:
 		}
 	}
 
-	void OnAnimationEnd(ECS::Event& ev) {
+	void OnAnimationEnd(const Mesh::AnimationEndEvent& ev) {
 		GamePlayerData& player_data = players.GetData().front();
-		if (ev.GetEntity() == player_data.base->id) {
-			const std::string& name = ev.GetParam<const std::string&>(Mesh::EVENT_PARAM_ANIMATION_NAME);
+		if (ev.entity == player_data.base->id) {
+			std::string_view name = ev.animation_name.view();
 			if (name == player_data.creature->animations[CreatureAnimations::ANIM_ATTACK]) {
 				//Attack finished
 				player_data.player->is_attacking = false;
@@ -282,10 +282,10 @@ public:
 		}
 	}
 
-	void OnAnimationFrameEvent(ECS::Event& ev) {
-		const std::string& anim_name = ev.GetParam<std::string>(Mesh::EVENT_PARAM_ANIMATION_NAME);
-		const int& frame = ev.GetParam<int>(Mesh::EVENT_PARAM_ANIMATION_FRAME);
-		const std::unordered_set<int>& ids = ev.GetParam<std::unordered_set<int>>(Mesh::EVENT_PARAM_ANIMATION_FRAME_ID);
+	void OnAnimationFrameEvent(const Mesh::AnimationFrameEvent& ev) {
+		std::string_view anim_name = ev.animation_name.view();
+		const int& frame = ev.frame;
+		std::span<const int> ids = ev.Ids();
 		if (anim_name == ANIM_WALK || anim_name == ANIM_RUN) {
 			for (const int id : ids) {
 				switch (id) {
@@ -293,13 +293,13 @@ public:
 					//Play random step sound
 					coordinator->GetSystem<AudioSystem>()->Play(RandType(8, 11).Value(), 0, false,
 						RandType(0.8f, 1.1f).Value(), RandType(2.0f, 2.4f).Value(),
-						false, ev.GetEntity(), { -0.5f, 0.0f, 0.0f });
+						false, ev.entity, { -0.5f, 0.0f, 0.0f });
 					break;
 				case ESoundId::SOUND_STEP_LEFT:
 					//Play random step sound
 					coordinator->GetSystem<AudioSystem>()->Play(RandType(8, 11).Value(), 0, false,
 						RandType(0.8f, 1.1f).Value(), RandType(2.0f, 2.4f).Value(),
-						false, ev.GetEntity(), { 0.5f, 0.0f, 0.0f });
+						false, ev.entity, { 0.5f, 0.0f, 0.0f });
 					break;
 				default: break;
 				}
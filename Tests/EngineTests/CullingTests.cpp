@@ -0,0 +1,120 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/Culling.h>
+#include <Core/JobSystem.h>
+#include <random>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+using namespace DirectX;
+
+namespace {
+	//Row vector perspective projection looking to +z, 90 degrees field of view, near 1 and far 100
+	Frustum TestFrustum() {
+		float a = 100.0f / 99.0f;
+		return Frustum::FromViewProjection(XMMatrixSet(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, a, 1.0f,
+			0.0f, 0.0f, -a, 0.0f));
+	}
+
+	//Random boxes around the frustum, every seventh slot is left empty
+	void FillRandom(CullingSet& set, size_t count, uint32_t seed) {
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-120.0f, 120.0f);
+		std::uniform_real_distribution<float> extent(0.0f, 5.0f);
+		set.Reset(count);
+		for (size_t i = 0; i < count; ++i) {
+			if (i % 7 == 3) {
+				continue;
+			}
+			set.Set(i, BoundingBox{ { position(rng), position(rng), position(rng) }, { extent(rng), extent(rng), extent(rng) } });
+		}
+	}
+}
+
+TEST(CullingKnownBoxes) {
+	CullingSet set;
+	set.Reset(5);
+	set.Set(0, BoundingBox{ { 0.0f, 0.0f, 50.0f }, { 1.0f, 1.0f, 1.0f } });
+	//Behind the camera
+	set.Set(1, BoundingBox{ { 0.0f, 0.0f, -50.0f }, { 1.0f, 1.0f, 1.0f } });
+	//Out of the side planes
+	set.Set(2, BoundingBox{ { 200.0f, 0.0f, 50.0f }, { 1.0f, 1.0f, 1.0f } });
+	//Crossing the near plane
+	set.Set(3, BoundingBox{ { 0.0f, 0.0f, 0.0f }, { 2.0f, 2.0f, 2.0f } });
+	//Beyond the far plane
+	set.Set(4, BoundingBox{ { 0.0f, 0.0f, 150.0f }, { 1.0f, 1.0f, 1.0f } });
+	CullingSet::Bitset bits;
+	set.Cull(TestFrustum(), bits);
+	CHECK(bits.size() == 1 && bits[0] == 0x9);
+	set.SetEmpty(0);
+	set.Cull(TestFrustum(), bits);
+	CHECK(bits[0] == 0x8);
+}
+
+TEST(CullingSimdMatchesScalar) {
+	//The SIMD paths must give the same bits as the reference, also in the padding of the last word
+	Frustum f = TestFrustum();
+	JobSystem::Init(2);
+	for (size_t count : { 0, 1, 63, 64, 65, 1000, 5000, 100000 }) {
+		CullingSet set;
+		FillRandom(set, count, (uint32_t)count);
+		CullingSet::Bitset scalar;
+		CullingSet::Bitset sse;
+		CullingSet::Bitset avx;
+		set.CullScalar(f, scalar);
+		set.Cull(f, sse, CullingSet::Simd::SSE);
+		set.Cull(f, avx, CullingSet::Simd::AVX);
+		CHECK(sse == scalar);
+		CHECK(avx == scalar);
+		for (size_t i = 3; i < count; i += 7) {
+			CHECK(!CullingSet::Test(scalar, i));
+		}
+	}
+	JobSystem::Release();
+	if (!CullingSet::HasAVX()) {
+		printf("    no AVX in this CPU, the AVX run used SSE\n");
+	}
+}
+
+TEST(BenchCulling) {
+	static constexpr size_t N = 100000;
+	Frustum f = TestFrustum();
+	CullingSet set;
+	FillRandom(set, N, 1);
+	CullingSet::Bitset bits;
+	//Single thread first, the job system is not running
+	double scalar = Bench("CullScalar 100k boxes", 20, [&]() { set.CullScalar(f, bits); });
+	double sse = Bench("Cull SSE 100k boxes", 20, [&]() { set.Cull(f, bits, CullingSet::Simd::SSE); });
+	double avx = Bench("Cull AVX 100k boxes", 20, [&]() { set.Cull(f, bits, CullingSet::Simd::AVX); });
+	JobSystem::Init();
+	double parallel = Bench("Cull BEST 100k boxes, job system", 20, [&]() { set.Cull(f, bits); });
+	JobSystem::Release();
+	bench_sink = bits[0];
+	printf("    speedup over scalar: SSE %.1fx, AVX %.1fx, parallel %.1fx\n", scalar / sse, scalar / avx, scalar / parallel);
+}
@@ -0,0 +1,83 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/DrawList.h>
+#include <random>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+
+TEST(DrawListOrder) {
+	static constexpr uint32_t PASS = 2;
+	struct Draw {
+		uint32_t shader;
+		uint32_t material;
+		float depth;
+		bool blend;
+	};
+	std::mt19937 rng(11);
+	std::vector<Draw> draws(1000);
+	DrawList list;
+	list.Reset(draws.size() + 10);
+	for (size_t i = 0; i < draws.size(); ++i) {
+		draws[i] = { (uint32_t)(rng() % 4), (uint32_t)(rng() % 8), (float)(rng() % 10000) * 0.01f, rng() % 3 == 0 };
+		list[i] = { DrawList::MakeKey(PASS, draws[i].shader, draws[i].material, draws[i].depth, draws[i].blend), (uint32_t)i };
+	}
+	//Commands of other passes don't mix with this one
+	list[draws.size()] = { DrawList::MakeKey(PASS - 1, 0, 0, 1.0f, true), 0 };
+	list[draws.size() + 1] = { DrawList::MakeKey(PASS + 1, 0, 0, 1.0f), 0 };
+	list.Sort();
+	CHECK(list.Size() == draws.size() + 2);
+	CHECK(list.GetCommands(PASS - 1).size() == 1 && list.GetCommands(PASS + 1).size() == 1);
+
+	std::span<const DrawList::Command> commands = list.GetCommands(PASS);
+	CHECK(commands.size() == draws.size());
+	bool blended = false;
+	int errors = 0;
+	for (size_t i = 0; i < commands.size(); ++i) {
+		const Draw& d = draws[commands[i].index];
+		errors += (DrawList::GetPass(commands[i].key) != PASS);
+		errors += (DrawList::GetShader(commands[i].key) != d.shader);
+		errors += (DrawList::GetMaterial(commands[i].key) != d.material);
+		errors += (DrawList::IsBackToFront(commands[i].key) != d.blend);
+		//Opaque commands first, grouped by shader and material and front to back inside the group
+		errors += (blended && !d.blend);
+		blended = d.blend;
+		if (i == 0) {
+			continue;
+		}
+		const Draw& prev = draws[commands[i - 1].index];
+		if (d.blend && prev.blend) {
+			//Blended commands back to front whatever their shader and material
+			errors += (d.depth > prev.depth);
+		}
+		else if (!d.blend) {
+			errors += (d.shader < prev.shader);
+			errors += (d.shader == prev.shader && d.material < prev.material);
+			errors += (d.shader == prev.shader && d.material == prev.material && d.depth < prev.depth);
+		}
+	}
+	CHECK(blended && errors == 0);
+}
@@ -0,0 +1,502 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <ECS/Coordinator.h>
+#include <ECS/ComponentArray.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+
+using namespace HotBite::Engine;
+using namespace HotBite::Engine::ECS;
+using namespace HotBite::Engine::Tests;
+
+namespace {
+	struct Position {
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+	};
+
+	struct Velocity {
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+	};
+
+	//Families and types only used by the TypeIndex tests, so their indexes start at 0
+	struct FamilyA {};
+	struct FamilyB {};
+	struct ThreadFamily {};
+	template<int N>
+	struct Tag {};
+
+	//Index of every Tag<0..N-1> in the family, each thread asks for them in a different order
+	template<class Family, int... Ns>
+	std::vector<uint32_t> TagIndexes(std::integer_sequence<int, Ns...>, bool reverse) {
+		uint32_t(*getters[])() = { &TypeIndex<Family>::template Get<Tag<Ns>>... };
+		size_t count = sizeof...(Ns);
+		std::vector<uint32_t> ret(count);
+		for (size_t i = 0; i < count; ++i) {
+			size_t n = reverse ? count - 1 - i : i;
+			ret[n] = getters[n]();
+		}
+		return ret;
+	}
+
+	//Copy of the ComponentArray replaced by the sparse set, two hash maps between entities and
+	//indexes of a vector, kept to compare both in BenchComponentArrayVsMaps
+	template<typename T>
+	class MapComponentArray {
+	public:
+		void InsertData(Entity entity, const T& component)
+		{
+			size_t new_index = component_array.size();
+			entity_to_index_map[entity] = new_index;
+			index_to_entity_map[new_index] = entity;
+			component_array.push_back(component);
+		}
+
+		std::vector<T>& Array() {
+			return component_array;
+		}
+
+		Entity RemoveData(Entity entity)
+		{
+			size_t size = component_array.size();
+			size_t index_of_removed_entity = entity_to_index_map[entity];
+			size_t index_of_last_element = size - 1;
+			component_array[index_of_removed_entity] = component_array[index_of_last_element];
+
+			Entity entity_of_last_element = index_to_entity_map[index_of_last_element];
+			entity_to_index_map[entity_of_last_element] = index_of_removed_entity;
+			index_to_entity_map[index_of_removed_entity] = entity_of_last_element;
+
+			entity_to_index_map.erase(entity);
+			index_to_entity_map.erase(index_of_last_element);
+			component_array.pop_back();
+			return entity_of_last_element;
+		}
+
+		T& GetData(Entity entity)
+		{
+			auto it = entity_to_index_map.find(entity);
+			if (it == entity_to_index_map.end()) {
+				throw "Retrieving non-existent component.";
+			}
+			return component_array[it->second];
+		}
+
+		MapComponentArray() {
+			//MAX_ENTITIES was 5000
+			component_array.reserve(5000);
+		}
+	private:
+		std::vector<T> component_array;
+		std::unordered_map<Entity, size_t> entity_to_index_map;
+		std::unordered_map<size_t, Entity> index_to_entity_map;
+	};
+
+	//Lookup, iteration and removal times per entity of an array with n entities
+	template<typename A>
+	void BenchArray(const char* name, int n, const std::vector<Entity>& shuffled, double (&ns)[3]) {
+		A a;
+		for (Entity e = 0; e < n; ++e) {
+			a.InsertData(e, Position{ (float)e, 0.0f, 0.0f });
+		}
+		std::string label = std::string(name) + " lookup";
+		ns[0] = Bench(label.c_str(), 10, [&a, &shuffled]() {
+			for (Entity e : shuffled) {
+				a.GetData(e).y += 1.0f;
+			}
+			}) / n;
+		label = std::string(name) + " iteration";
+		ns[1] = Bench(label.c_str(), 10, [&a]() {
+			for (Position& p : a.Array()) {
+				p.x += 1.0f;
+			}
+			}) / n;
+		//Half of the entities in random order, the swap with the last one is part of the cost
+		label = std::string(name) + " removal";
+		ns[2] = Bench(label.c_str(), 1, [&a, &shuffled, n]() {
+			for (int i = 0; i < n / 2; ++i) {
+				a.RemoveData(shuffled[i]);
+			}
+			}) / (n / 2);
+		bench_sink = (uint64_t)a.Array()[0].y;
+	}
+
+	//Counts the notifications routed to it, T is the component it works with
+	template<typename T>
+	class CountingSystem : public System {
+	public:
+		Signature signature;
+		int changed = 0;
+		int destroyed = 0;
+		void OnRegister(Coordinator* c) override {
+			signature.set(c->GetComponentType<T>(), true);
+		}
+		void OnEntitySignatureChanged(Entity, const Signature&) override { ++changed; }
+		void OnEntityDestroyed(Entity) override { ++destroyed; }
+		std::vector<Signature> GetSignatures() const override { return { signature }; }
+	};
+
+	//Checks the dense arrays are packed and the sparse index points to the right component
+	bool IsPacked(ComponentArray<Position>& a) {
+		const std::vector<Entity>& entities = a.Entities();
+		if (entities.size() != a.Array().size()) {
+			return false;
+		}
+		for (size_t i = 0; i < entities.size(); ++i) {
+			if (a.TryGetData(entities[i]) != &a.Array()[i] || a.Array()[i].x != (float)entities[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST(ComponentArrayInsertRemove) {
+	static constexpr Entity N = 10000;
+	ComponentArray<Position> a;
+	for (Entity e = 0; e < N; ++e) {
+		a.InsertData(e, Position{ (float)e, 0.0f, 0.0f });
+	}
+	CHECK(IsPacked(a));
+	//Components live in pages, growing the array doesn't move them
+	Position* first = a.TryGetData(0);
+	for (Entity e = N; e < 2 * N; ++e) {
+		a.InsertData(e, Position{ (float)e, 0.0f, 0.0f });
+	}
+	CHECK(first == a.TryGetData(0));
+	for (Entity e = 0; e < 2 * N; e += 3) {
+		a.RemoveData(e);
+	}
+	CHECK(IsPacked(a));
+	for (Entity e = 0; e < 2 * N; ++e) {
+		CHECK(a.Contains(e) == (e % 3 != 0));
+	}
+	//Ids far from the others only allocate their own page of the sparse index
+	a.InsertData(1000000, Position{ 1000000.0f, 0.0f, 0.0f });
+	CHECK(a.Contains(1000000) && !a.Contains(999999));
+	CHECK(IsPacked(a));
+}
+
+TEST(ComponentArrayVersions) {
+	ComponentArray<Position> a;
+	for (Entity e = 0; e < 4; ++e) {
+		a.InsertData(e, Position{ (float)e, 0.0f, 0.0f });
+	}
+	//Adding stamps a new version
+	CHECK(a.GetVersion() == 4 && a.GetVersion(0) == 1 && a.GetVersion(3) == 4);
+	CHECK(a.GetVersion(10) == 0);
+	uint64_t since = a.GetVersion();
+	std::vector<Entity> changed;
+	auto collect = [&changed](Entity e, Position& p) {
+		CHECK(p.x == (float)e);
+		changed.push_back(e);
+	};
+	a.ForEachChanged(since, collect);
+	CHECK(changed.empty());
+
+	a.MarkChanged(1);
+	a.MarkChanged(10);
+	CHECK(a.GetVersion(1) == 5 && a.GetVersion() == 5);
+	a.ForEachChanged(since, collect);
+	CHECK(changed == std::vector<Entity>{ 1 });
+
+	//The last component is moved to the removed slot with its version
+	uint64_t last_version = a.GetVersion(3);
+	a.RemoveData(0);
+	CHECK(a.GetVersion(3) == last_version && a.GetVersion(0) == 0);
+	CHECK(a.GetVersion() == 6);
+	changed.clear();
+	a.ForEachChanged(since, collect);
+	CHECK(changed == std::vector<Entity>{ 1 });
+	//Removing the changed one leaves nothing to visit, but the array version still moves
+	a.RemoveData(1);
+	changed.clear();
+	a.ForEachChanged(since, collect);
+	CHECK(changed.empty() && a.GetVersion() == 7);
+	a.ForEachChanged(0, collect);
+	std::sort(changed.begin(), changed.end());
+	CHECK(changed == std::vector<Entity>{ 2, 3 });
+}
+
+TEST(ComponentViewForEach) {
+	Coordinator c;
+	c.Init();
+	c.RegisterComponent<Position>();
+	c.RegisterComponent<Velocity>();
+	static constexpr int N = 1000;
+	std::vector<Entity> entities;
+	for (int i = 0; i < N; ++i) {
+		Entity e = c.CreateEntity("entity_" + std::to_string(i));
+		c.AddComponent<Position>(e, Position{ (float)e, 0.0f, 0.0f });
+		if (i % 2 == 0) {
+			c.AddComponent<Velocity>(e, Velocity{ 1.0f, 0.0f, 0.0f });
+		}
+		entities.push_back(e);
+	}
+	int visited = 0;
+	c.ForEach<Position, Velocity>([&visited](Entity e, Position& p, Velocity& v) {
+		CHECK(p.x == (float)e && v.x == 1.0f);
+		++visited;
+		});
+	CHECK(visited == N / 2);
+	//Removing the current entity inside the loop is allowed
+	c.ForEach<Position, Velocity>([&c](Entity e, Position&, Velocity&) {
+		c.DestroyEntity(e);
+		});
+	visited = 0;
+	c.ForEach<Position>([&visited](Entity, Position&) { ++visited; });
+	CHECK(visited == N / 2);
+	CHECK(c.View<Position, Velocity>().Entities().empty());
+}
+
+TEST(CommandBufferPlayback) {
+	Coordinator c;
+	c.Init();
+	c.RegisterComponent<Position>();
+	c.RegisterComponent<Velocity>();
+	Entity old = c.CreateEntity("old");
+	EntityHandle old_handle = c.GetEntityHandle(old);
+	Entity kept = c.CreateEntity("kept");
+	EntityHandle kept_handle = c.GetEntityHandle(kept);
+	c.AddComponent<Position>(kept, Position{ 1.0f, 0.0f, 0.0f });
+
+	CommandBuffer cb;
+	EntityHandle pending = cb.CreateEntity("new");
+	CHECK(CommandBuffer::IsPending(pending) && cb.PendingEntityCount() == 1);
+	cb.AddComponent<Position>(pending, Position{ 2.0f, 0.0f, 0.0f });
+	cb.AddComponent<Velocity>(pending);
+	Entity created = INVALID_ENTITY_ID;
+	cb.Exec(pending, [&created](Coordinator*, Entity e) { created = e; });
+	cb.NotifySignatureChange(pending);
+	cb.DestroyEntity(kept_handle);
+	cb.AddComponent<Velocity>(old_handle);
+	cb.DestroyEntity(old_handle);
+	c.Submit(std::move(cb));
+
+	//Nothing changes until playback
+	CHECK(c.GetEntityByName("new") == INVALID_ENTITY_ID && c.IsEntityAlive(kept_handle));
+	//The commands of an entity destroyed before the playback are skipped, also when its id is reused
+	c.DestroyEntity(old);
+	Entity reused = c.CreateEntity("reused");
+	CHECK(reused == old && !c.IsEntityAlive(old_handle));
+
+	c.PlaybackCommands();
+	CHECK(created != INVALID_ENTITY_ID && c.GetEntityByName("new") == created);
+	CHECK(c.GetComponent<Position>(created).x == 2.0f && c.ContainsComponent<Velocity>(created));
+	CHECK(!c.IsEntityAlive(kept_handle) && c.GetEntityByName("kept") == INVALID_ENTITY_ID);
+	CHECK(c.IsEntityAlive(c.GetEntityHandle(reused)) && !c.ContainsComponent<Velocity>(reused));
+
+	//Submitted buffers are played back once
+	created = INVALID_ENTITY_ID;
+	c.PlaybackCommands();
+	CHECK(created == INVALID_ENTITY_ID);
+}
+
+TEST(SystemNotificationRouting) {
+	Coordinator c;
+	c.Init();
+	c.RegisterComponent<Position>();
+	c.RegisterComponent<Velocity>();
+	auto positions = c.RegisterSystem<CountingSystem<Position>>();
+	Entity a = c.CreateEntity("a");
+	c.AddComponent<Position>(a, Position{});
+	c.NotifySignatureChange(a);
+	Entity b = c.CreateEntity("b");
+	c.AddComponent<Velocity>(b, Velocity{});
+	c.NotifySignatureChange(b);
+	CHECK(positions->changed == 1);
+	//The matching systems of a known signature change when a system is registered
+	auto velocities = c.RegisterSystem<CountingSystem<Velocity>>();
+	c.NotifySignatureChange(b);
+	CHECK(positions->changed == 1 && velocities->changed == 1);
+	c.AddComponent<Velocity>(a, Velocity{});
+	c.NotifySignatureChange(a);
+	CHECK(positions->changed == 2 && velocities->changed == 2);
+	//Systems where the entity was a member are told it left, and then they are not notified anymore
+	c.RemoveComponent<Position>(a);
+	CHECK(positions->changed > 2);
+	int left = positions->changed;
+	c.NotifySignatureChange(a);
+	CHECK(positions->changed == left);
+	c.DestroyEntity(a);
+	CHECK(positions->destroyed == 0 && velocities->destroyed == 1);
+}
+
+TEST(BenchECSIteration) {
+	static constexpr int N = 100000;
+	Coordinator c;
+	c.Init();
+	c.RegisterComponent<Position>();
+	c.RegisterComponent<Velocity>();
+	for (int i = 0; i < N; ++i) {
+		Entity e = c.CreateEntity("entity_" + std::to_string(i));
+		c.AddComponent<Position>(e, Position{});
+		//One of every four entities doesn't move
+		if (i % 4 != 0) {
+			c.AddComponent<Velocity>(e, Velocity{ 1.0f, 2.0f, 3.0f });
+		}
+	}
+	std::shared_ptr<ComponentArray<Position>> positions = c.GetComponents<Position>();
+	double linear = Bench("packed array pass", 20, [&positions]() {
+		for (Position& p : positions->Array()) {
+			p.x += 1.0f;
+		}
+		}) / N;
+	double view = Bench("ForEach<Position, Velocity> pass", 20, [&c]() {
+		c.ForEach<Position, Velocity>([](Entity, Position& p, Velocity& v) {
+			p.x += v.x;
+			p.y += v.y;
+			p.z += v.z;
+			});
+		}) / N;
+	double lookup = Bench("GetComponent<Position> pass", 20, [&c]() {
+		for (Entity e = 0; e < N; ++e) {
+			c.GetComponent<Position>(e).y += 1.0f;
+		}
+		}) / N;
+	bench_sink = (uint64_t)positions->Array()[0].x;
+	printf("    per entity: packed %.2f ns, view %.2f ns, lookup %.2f ns\n", linear, view, lookup);
+}
+
+TEST(BenchComponentArrayVsMaps) {
+	for (int n : { 5000, 100000 }) {
+		std::vector<Entity> shuffled(n);
+		for (Entity e = 0; e < n; ++e) {
+			shuffled[e] = e;
+		}
+		std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1234));
+		printf("    %d entities\n", n);
+		double sparse[3];
+		double maps[3];
+		BenchArray<ComponentArray<Position>>("sparse set", n, shuffled, sparse);
+		BenchArray<MapComponentArray<Position>>("two unordered_maps", n, shuffled, maps);
+		printf("    per entity (sparse set / maps): lookup %.2f / %.2f ns, iteration %.2f / %.2f ns, removal %.2f / %.2f ns\n",
+			sparse[0], maps[0], sparse[1], maps[1], sparse[2], maps[2]);
+	}
+}
+
+TEST(TypeIndexPerFamily) {
+	uint32_t a0 = TypeIndex<FamilyA>::Get<Position>();
+	uint32_t a1 = TypeIndex<FamilyA>::Get<Velocity>();
+	uint32_t b0 = TypeIndex<FamilyB>::Get<Velocity>();
+	CHECK(a0 == 0 && a1 == 1 && b0 == 0);
+	CHECK(TypeIndex<FamilyA>::Get<Position>() == a0);
+	CHECK(TypeIndex<FamilyA>::Get<Velocity>() == a1);
+	CHECK(TypeIndex<FamilyB>::Get<Position>() == 1);
+}
+
+TEST(TypeIndexThreads) {
+	//Types first seen from several threads at the same time still get dense unique indexes
+	static constexpr int TYPES = 16;
+	static constexpr int THREADS = 8;
+	std::vector<std::vector<uint32_t>> results(THREADS);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; ++t) {
+		threads.emplace_back([&results, t]() {
+			results[t] = TagIndexes<ThreadFamily>(std::make_integer_sequence<int, TYPES>{}, t % 2 == 1);
+			});
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+	std::vector<uint32_t> sorted = results[0];
+	std::sort(sorted.begin(), sorted.end());
+	for (int i = 0; i < TYPES; ++i) {
+		CHECK(sorted[i] == (uint32_t)i);
+	}
+	for (int t = 1; t < THREADS; ++t) {
+		CHECK(results[t] == results[0]);
+	}
+}
+
+TEST(ComponentTypesPerCoordinator) {
+	//Component types follow the registration order of each coordinator, the array index is shared
+	Coordinator a;
+	a.Init();
+	a.RegisterComponent<Position>();
+	a.RegisterComponent<Velocity>();
+	Coordinator b;
+	b.Init();
+	b.RegisterComponent<Velocity>();
+	b.RegisterComponent<Position>();
+	CHECK(a.GetComponentType<Position>() == 0 && a.GetComponentType<Velocity>() == 1);
+	CHECK(b.GetComponentType<Velocity>() == 0 && b.GetComponentType<Position>() == 1);
+	Entity e = b.CreateEntity("entity");
+	b.AddComponent<Position>(e, Position{ 1.0f, 2.0f, 3.0f });
+	CHECK(b.GetComponent<Position>(e).y == 2.0f);
+	CHECK(a.GetComponents<Position>()->Entities().empty());
+}
+
+TEST(BenchTypeIndex) {
+	static constexpr size_t N = 1000000;
+	static constexpr Entity ENTITIES = 1000;
+	Coordinator c;
+	c.Init();
+	c.RegisterComponent<Position>();
+	c.RegisterComponent<Velocity>();
+	for (Entity i = 0; i < ENTITIES; ++i) {
+		Entity e = c.CreateEntity("entity_" + std::to_string(i));
+		c.AddComponent<Position>(e, Position{ (float)e, 0.0f, 0.0f });
+		c.AddComponent<Velocity>(e, Velocity{ 1.0f, 0.0f, 0.0f });
+	}
+	//The path GetComponent replaces: the array is found by typeid(T).name() in a hash map of
+	//shared pointers to the base class, copied and cast to the component array
+	std::unordered_map<const char*, std::shared_ptr<IComponentArray>> by_name;
+	by_name[typeid(Position).name()] = c.GetComponents<Position>();
+	by_name[typeid(Velocity).name()] = c.GetComponents<Velocity>();
+	float sum = 0.0f;
+	double index = Bench("GetComponent<T> (TypeIndex) x1M", 1, [&c, &sum]() {
+		for (size_t i = 0; i < N; ++i) {
+			Entity e = (Entity)(i % ENTITIES);
+			sum += c.GetComponent<Position>(e).x + c.GetComponent<Velocity>(e).x;
+		}
+		});
+	double cast = Bench("name map + static_pointer_cast x1M", 1, [&by_name, &sum]() {
+		for (size_t i = 0; i < N; ++i) {
+			Entity e = (Entity)(i % ENTITIES);
+			sum += std::static_pointer_cast<ComponentArray<Position>>(by_name[typeid(Position).name()])->GetData(e).x +
+				std::static_pointer_cast<ComponentArray<Velocity>>(by_name[typeid(Velocity).name()])->GetData(e).x;
+		}
+		});
+	double dynamic = Bench("name map + dynamic_pointer_cast x1M", 1, [&by_name, &sum]() {
+		for (size_t i = 0; i < N; ++i) {
+			Entity e = (Entity)(i % ENTITIES);
+			sum += std::dynamic_pointer_cast<ComponentArray<Position>>(by_name[typeid(Position).name()])->GetData(e).x +
+				std::dynamic_pointer_cast<ComponentArray<Velocity>>(by_name[typeid(Velocity).name()])->GetData(e).x;
+		}
+		});
+	bench_sink = (uint64_t)sum;
+	printf("    per GetComponent pair: type index %.2f ns, name map + static cast %.2f ns, name map + dynamic cast %.2f ns\n",
+		index / N, cast / N, dynamic / N);
+}
@@ -0,0 +1,74 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/Profiler.h>
+#include <atomic>
+#include <thread>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+
+namespace {
+	uint64_t CountZones(const char* name) {
+		for (const Profiler::ZoneStats& s : Profiler::GetStats(INT64_MAX / 2)) {
+			if (s.name == name) {
+				return s.count;
+			}
+		}
+		return 0;
+	}
+}
+
+TEST(ProfilerClearWhileRecording) {
+	Profiler::Enable(true);
+	std::atomic<bool> stop = false;
+	std::atomic<uint64_t> recorded = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 2; ++t) {
+		threads.emplace_back([&stop, &recorded]() {
+			while (!stop) {
+				HOTBITE_PROFILE_ZONE("ProfilerTests::Zone");
+				recorded++;
+			}
+			});
+	}
+	//Clear can run while the threads record
+	while (recorded < 100000) {
+		Profiler::Clear();
+		std::this_thread::yield();
+	}
+	stop = true;
+	for (std::thread& t : threads) {
+		t.join();
+	}
+	Profiler::Clear();
+	CHECK(CountZones("ProfilerTests::Zone") == 0);
+	{
+		HOTBITE_PROFILE_ZONE("ProfilerTests::Zone");
+	}
+	CHECK(CountZones("ProfilerTests::Zone") == 1);
+	Profiler::Enable(false);
+	Profiler::Clear();
+}
@@ -0,0 +1,174 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/RingQueue.h>
+#include <Core/LockingQueue.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+
+namespace {
+	//Values carry the producer in the high bits and a per producer sequence in the low bits
+	uint64_t MakeValue(uint64_t producer, uint64_t n) { return (producer << 32) | n; }
+
+	//Pushes items_per_producer values from every producer, consumers check each producer's values
+	//come in order and none is lost or duplicated. Returns the nanoseconds per item.
+	template<typename Q>
+	double RunContention(Q& queue, int producers, int consumers, uint64_t items_per_producer) {
+		std::atomic<uint64_t> popped{ 0 };
+		std::atomic<uint64_t> sum{ 0 };
+		std::atomic<int> errors{ 0 };
+		const uint64_t total = items_per_producer * producers;
+		std::vector<std::thread> threads;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int p = 0; p < producers; ++p) {
+			threads.emplace_back([&queue, p, items_per_producer]() {
+				for (uint64_t n = 0; n < items_per_producer; ++n) {
+					while (!queue.Push(MakeValue(p, n))) {
+						std::this_thread::yield();
+					}
+				}
+				});
+		}
+		for (int c = 0; c < consumers; ++c) {
+			threads.emplace_back([&, producers]() {
+				std::vector<int64_t> last(producers, -1);
+				uint64_t local_sum = 0;
+				uint64_t value;
+				while (popped.load(std::memory_order_relaxed) < total) {
+					if (!queue.TryPop(value)) {
+						std::this_thread::yield();
+						continue;
+					}
+					popped.fetch_add(1, std::memory_order_relaxed);
+					int64_t p = (int64_t)(value >> 32);
+					int64_t n = (int64_t)(value & 0xffffffff);
+					if (p >= producers || n <= last[p]) {
+						errors.fetch_add(1, std::memory_order_relaxed);
+					}
+					else {
+						last[p] = n;
+					}
+					local_sum += n;
+				}
+				sum.fetch_add(local_sum, std::memory_order_relaxed);
+				});
+		}
+		for (std::thread& t : threads) {
+			t.join();
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		CHECK(errors.load() == 0);
+		CHECK(popped.load() == total);
+		CHECK(sum.load() == producers * (items_per_producer * (items_per_producer - 1) / 2));
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double)total;
+	}
+
+	//LockingQueue::Push doesn't fail, same interface for RunContention
+	struct BoundlessLockingQueue {
+		LockingQueue<uint64_t> queue;
+		bool Push(uint64_t v) { queue.Push(v); return true; }
+		bool TryPop(uint64_t& v) { return queue.TryPop(v); }
+	};
+}
+
+TEST(RingQueueFullEmpty) {
+	RingQueue<int, 8, QueueMode::SPSC> q;
+	int value = -1;
+	CHECK(q.Empty() && !q.TryPop(value));
+	//Fill and drain several times so the positions wrap around the ring
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < 8; ++i) {
+			CHECK(q.Push(round * 8 + i));
+		}
+		CHECK(!q.Push(-1));
+		CHECK(q.Size() == 8);
+		for (int i = 0; i < 8; ++i) {
+			CHECK(q.TryPop(value) && value == round * 8 + i);
+		}
+		CHECK(!q.TryPop(value));
+	}
+	int values[8] = {};
+	q.Push(1);
+	q.Push(2);
+	CHECK(q.TryPopMany(values, 8) == 2 && values[0] == 1 && values[1] == 2);
+	CHECK(!q.TimedWaitAndPop(value, 1));
+}
+
+TEST(RingQueueBlockingWaits) {
+	using Clock = std::chrono::steady_clock;
+	RingQueue<int, 8, QueueMode::MPMC> q;
+	int value = -1;
+	//Parked consumers are woken by the push, not by their timeout
+	for (int round = 0; round < 20; ++round) {
+		std::thread consumer([&q, round]() {
+			int v = -1;
+			auto t0 = Clock::now();
+			CHECK(q.TimedWaitAndPop(v, 10000) && v == round);
+			CHECK(Clock::now() - t0 < std::chrono::seconds(5));
+			});
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		q.Push(round);
+		consumer.join();
+	}
+	std::thread consumer([&q, &value]() { q.WaitAndPop(value); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	q.Push(42);
+	consumer.join();
+	CHECK(value == 42);
+	consumer = std::thread([&q]() { CHECK(q.TimedWait(10000) && q.Size() == 1); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	q.Push(7);
+	consumer.join();
+	CHECK(q.TryPop(value) && value == 7);
+	//Times out when nothing comes
+	auto t0 = Clock::now();
+	CHECK(!q.TimedWaitAndPop(value, 20) && !q.TimedWait(20));
+	CHECK(Clock::now() - t0 >= std::chrono::milliseconds(40));
+}
+
+TEST(RingQueueModes) {
+	//Every mode with the number of threads it supports, a small ring so it's full most of the time
+	RingQueue<uint64_t, 64, QueueMode::SPSC> spsc;
+	RunContention(spsc, 1, 1, 200000);
+	RingQueue<uint64_t, 64, QueueMode::MPSC> mpsc;
+	RunContention(mpsc, 4, 1, 50000);
+	RingQueue<uint64_t, 64, QueueMode::MPMC> mpmc;
+	RunContention(mpmc, 4, 4, 50000);
+}
+
+TEST(BenchQueueContention) {
+	static constexpr uint64_t ITEMS = 200000;
+	for (int threads : { 1, 2, 4 }) {
+		RingQueue<uint64_t, 1024, QueueMode::MPMC> ring;
+		BoundlessLockingQueue locking;
+		double r = RunContention(ring, threads, threads, ITEMS);
+		double l = RunContention(locking, threads, threads, ITEMS);
+		printf("    %d producers, %d consumers: RingQueue %.1f ns/item, LockingQueue %.1f ns/item\n", threads, threads, r, l);
+	}
+}
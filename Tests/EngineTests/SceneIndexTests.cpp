@@ -0,0 +1,228 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/SceneIndex.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+using namespace DirectX;
+
+namespace {
+	static constexpr float MARGIN = 0.5f;
+
+	//Brute force tests, box enlarged by margin
+	bool SphereHits(const BoundingBox& b, const XMFLOAT3& c, float radius, float margin) {
+		const float cc[3] = { c.x, c.y, c.z };
+		const float bc[3] = { b.Center.x, b.Center.y, b.Center.z };
+		const float be[3] = { b.Extents.x + margin, b.Extents.y + margin, b.Extents.z + margin };
+		float d2 = 0.0f;
+		for (int i = 0; i < 3; ++i) {
+			float d = std::max(std::fabs(cc[i] - bc[i]) - be[i], 0.0f);
+			d2 += d * d;
+		}
+		return d2 <= radius * radius;
+	}
+
+	bool BoxHits(const BoundingBox& b, const BoundingBox& q, float margin) {
+		return std::fabs(q.Center.x - b.Center.x) <= q.Extents.x + b.Extents.x + margin &&
+			std::fabs(q.Center.y - b.Center.y) <= q.Extents.y + b.Extents.y + margin &&
+			std::fabs(q.Center.z - b.Center.z) <= q.Extents.z + b.Extents.z + margin;
+	}
+
+	bool RayHits(const BoundingBox& b, const XMFLOAT3& o, const XMFLOAT3& d, float max_t, float margin) {
+		const float oo[3] = { o.x, o.y, o.z };
+		const float dd[3] = { d.x, d.y, d.z };
+		const float bc[3] = { b.Center.x, b.Center.y, b.Center.z };
+		const float be[3] = { b.Extents.x + margin, b.Extents.y + margin, b.Extents.z + margin };
+		float t0 = 0.0f;
+		float t1 = max_t;
+		for (int i = 0; i < 3; ++i) {
+			float ta = (bc[i] - be[i] - oo[i]) / dd[i];
+			float tb = (bc[i] + be[i] - oo[i]) / dd[i];
+			t0 = std::max(t0, std::min(ta, tb));
+			t1 = std::min(t1, std::max(ta, tb));
+		}
+		return t0 <= t1;
+	}
+
+	//Collects the keys of a query, counting the ones reported twice
+	struct Results {
+		std::vector<int> hits;
+		int duplicates = 0;
+
+		void Reset(size_t count) {
+			hits.assign(count, 0);
+			duplicates = 0;
+		}
+		auto Collector() {
+			return [this](SceneIndex::Key key) {
+				if (hits[key]++ > 0) {
+					++duplicates;
+				}
+			};
+		}
+	};
+
+	//The query must report every box passing the exact test and only boxes passing the test
+	//with twice the margin, as boxes moving inside their enlarged box keep the old one
+	template<typename T>
+	void CheckQuery(const Results& r, const std::vector<BoundingBox>& boxes, const std::vector<bool>& alive, T&& test, const char* name) {
+		int missing = 0;
+		int wrong = 0;
+		for (size_t i = 0; i < boxes.size(); ++i) {
+			bool hit = r.hits[i] > 0;
+			if (!alive[i]) {
+				wrong += hit;
+				continue;
+			}
+			missing += (test(boxes[i], 0.0f) && !hit);
+			wrong += (hit && !test(boxes[i], 2.0f * MARGIN));
+		}
+		if (missing > 0 || wrong > 0 || r.duplicates > 0) {
+			printf("    %s: %d missing, %d wrong, %d duplicated\n", name, missing, wrong, r.duplicates);
+		}
+		CHECK(missing == 0 && wrong == 0 && r.duplicates == 0);
+	}
+}
+
+TEST(SceneIndexQueries) {
+	static constexpr int N = 3000;
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+	std::uniform_real_distribution<float> move(-2.0f, 2.0f);
+	SceneIndex index(MARGIN);
+	std::vector<BoundingBox> boxes(N);
+	std::vector<bool> alive(N, false);
+	Results r;
+	for (int round = 0; round < 20; ++round) {
+		//Insert, move (also within the margin) and remove boxes
+		for (int i = 0; i < N; ++i) {
+			uint32_t action = rng() % 10;
+			if (!alive[i]) {
+				boxes[i] = BoundingBox{ { position(rng), position(rng), position(rng) }, { extent(rng), extent(rng), extent(rng) } };
+				index.Update(i, boxes[i]);
+				alive[i] = true;
+			}
+			else if (action < 6) {
+				boxes[i].Center.x += move(rng) * (action < 3 ? 0.1f : 1.0f);
+				boxes[i].Center.y += move(rng);
+				index.Update(i, boxes[i]);
+			}
+			else if (action == 9) {
+				index.Remove(i);
+				alive[i] = false;
+			}
+		}
+		size_t count = (size_t)std::count(alive.begin(), alive.end(), true);
+		CHECK(index.Size() == count);
+		//The tree is kept balanced
+		CHECK(index.GetHeight() <= 2 * (int)std::ceil(std::log2((double)count)) + 1);
+
+		XMFLOAT3 center{ position(rng), position(rng), position(rng) };
+		r.Reset(N);
+		index.QuerySphere(center, 30.0f, r.Collector());
+		CheckQuery(r, boxes, alive, [&center](const BoundingBox& b, float m) { return SphereHits(b, center, 30.0f, m); }, "sphere");
+
+		BoundingBox q{ { position(rng), position(rng), position(rng) }, { 20.0f, 20.0f, 20.0f } };
+		r.Reset(N);
+		index.QueryBox(q, r.Collector());
+		CheckQuery(r, boxes, alive, [&q](const BoundingBox& b, float m) { return BoxHits(b, q, m); }, "box");
+
+		XMFLOAT3 origin{ 0.0f, 0.0f, -200.0f };
+		XMFLOAT3 direction{ 0.1f, 0.05f, 1.0f };
+		r.Reset(N);
+		index.QueryRay(origin, direction, 400.0f, r.Collector());
+		CheckQuery(r, boxes, alive, [&](const BoundingBox& b, float m) { return RayHits(b, origin, direction, 400.0f, m); }, "ray");
+
+		//The frustum query reports at least the boxes the culling set finds visible
+		Frustum f = Frustum::FromViewProjection(XMMatrixSet(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 1.0f,
+			center.x * 0.1f, 0.0f, -1.0f, 0.0f));
+		CullingSet set;
+		set.Reset(N);
+		for (int i = 0; i < N; ++i) {
+			if (alive[i]) {
+				set.Set(i, boxes[i]);
+			}
+		}
+		CullingSet::Bitset visible;
+		set.CullScalar(f, visible);
+		r.Reset(N);
+		index.QueryFrustum(f, r.Collector());
+		int missing = 0;
+		for (int i = 0; i < N; ++i) {
+			missing += (CullingSet::Test(visible, i) && r.hits[i] == 0);
+			CHECK(r.hits[i] == 0 || alive[i]);
+		}
+		CHECK(missing == 0 && r.duplicates == 0);
+	}
+	index.Clear();
+	CHECK(index.Size() == 0 && index.GetHeight() == 0);
+}
+
+TEST(BenchSceneIndex) {
+	static constexpr int N = 10000;
+	static constexpr int QUERIES = 1000;
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.5f, 3.0f);
+	std::uniform_real_distribution<float> move(-0.2f, 0.2f);
+	std::vector<BoundingBox> boxes(N);
+	SceneIndex index(MARGIN);
+	for (int i = 0; i < N; ++i) {
+		boxes[i] = BoundingBox{ { position(rng), position(rng), position(rng) }, { extent(rng), extent(rng), extent(rng) } };
+		index.Update(i, boxes[i]);
+	}
+	std::vector<XMFLOAT3> centers(QUERIES);
+	for (XMFLOAT3& c : centers) {
+		c = { position(rng), position(rng), position(rng) };
+	}
+	uint64_t found = 0;
+	//Point light sized queries, the tree against testing every box
+	double tree = Bench("QuerySphere r=50, 10k boxes", QUERIES, [&, q = 0]() mutable {
+		index.QuerySphere(centers[q++ % QUERIES], 50.0f, [&found](SceneIndex::Key) { ++found; });
+		});
+	double brute = Bench("brute force sphere, 10k boxes", QUERIES, [&, q = 0]() mutable {
+		const XMFLOAT3& c = centers[q++ % QUERIES];
+		for (const BoundingBox& b : boxes) {
+			found += SphereHits(b, c, 50.0f, 0.0f);
+		}
+		});
+	//Small moves stay in the enlarged box and don't touch the tree
+	Bench("Update 10k moving boxes", 10, [&]() {
+		for (int i = 0; i < N; ++i) {
+			boxes[i].Center.x += move(rng);
+			index.Update(i, boxes[i]);
+		}
+		});
+	bench_sink = found;
+	printf("    sphere query: tree %.2f us, brute force %.2f us, height %d\n", tree / 1000.0, brute / 1000.0, index.GetHeight());
+}
@@ -0,0 +1,121 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <ECS/TaskGraph.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::ECS;
+using namespace HotBite::Engine::Tests;
+
+namespace {
+	Signature Components(std::initializer_list<int> types) {
+		Signature s;
+		for (int t : types) {
+			s.set(t);
+		}
+		return s;
+	}
+}
+
+TEST(ComponentLocksSharedAndExclusive) {
+	ComponentLocks locks;
+	Signature a = Components({ 0 });
+	Signature b = Components({ 1 });
+	CHECK(locks.TryLock(a, {}) && locks.TryLock(a, {}));
+	CHECK(!locks.TryLock({}, a));
+	CHECK(locks.TryLock({}, b));
+	//All or nothing, the read of a is released when b can't be written
+	CHECK(!locks.TryLock(a, b));
+	locks.Unlock(a, {});
+	locks.Unlock(a, {});
+	locks.Unlock({}, b);
+	CHECK(locks.TryLock({}, a | b));
+	locks.Unlock({}, a | b);
+
+	WorldMutex world;
+	world.lock();
+	world.lock();
+	CHECK(!world.GetComponentLocks().TryLock(a, {}));
+	world.unlock();
+	CHECK(!world.GetComponentLocks().TryLock({}, b));
+	world.unlock();
+	CHECK(world.GetComponentLocks().TryLock(a, b));
+	world.GetComponentLocks().Unlock(a, b);
+}
+
+TEST(TaskGraphComponentLocks) {
+	using namespace std::chrono_literals;
+	JobSystem::Init(2);
+	WorldMutex world;
+	TaskGraph graph;
+	graph.SetComponentLocks(&world.GetComponentLocks());
+	Signature a = Components({ 0 });
+	Signature b = Components({ 1 });
+	std::atomic<int> step = 0;
+	int write_a = -1;
+	int read_a = -1;
+	//Disjoint tasks run at the same time, each one waits a bit for the other to start
+	std::atomic<int> started_tasks = 0;
+	std::atomic<int> overlapped = 0;
+	auto overlap = [&started_tasks, &overlapped]() {
+		started_tasks++;
+		auto t0 = std::chrono::steady_clock::now();
+		while (started_tasks < 2 && std::chrono::steady_clock::now() - t0 < 500ms) {
+			std::this_thread::yield();
+		}
+		overlapped += (started_tasks == 2);
+	};
+	graph.AddTask("write_a", {}, a, [&]() { write_a = step++; overlap(); });
+	graph.AddTask("write_b", {}, b, [&]() { overlap(); });
+	graph.AddTask("read_a", a, {}, [&]() { read_a = step++; });
+	graph.Run();
+	CHECK(write_a == 0 && read_a == 1);
+	CHECK(overlapped == 2);
+
+	//The tasks wait for the world mutex held by another thread
+	std::atomic<bool> held = false;
+	std::atomic<int64_t> released = 0;
+	std::atomic<int64_t> started = 0;
+	auto now = []() { return std::chrono::steady_clock::now().time_since_epoch().count(); };
+	std::thread holder([&]() {
+		std::lock_guard l(world);
+		held = true;
+		std::this_thread::sleep_for(50ms);
+		released = now();
+		});
+	while (!held) {
+		std::this_thread::yield();
+	}
+	TaskGraph locked;
+	locked.SetComponentLocks(&world.GetComponentLocks());
+	locked.AddTask("write_a", {}, a, [&]() { started = now(); });
+	locked.Run();
+	holder.join();
+	CHECK(started > 0 && released > 0 && started >= released);
+	JobSystem::Release();
+}
@@ -0,0 +1,252 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <Core/Task.h>
+#include <Core/Scheduler.h>
+#include <Core/JobSystem.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace HotBite::Engine::Core;
+using namespace HotBite::Engine::Tests;
+
+namespace {
+	//Counts the coroutine frames alive, a local of this type dies with the frame
+	struct FrameCounter {
+		static inline int alive = 0;
+		FrameCounter() { ++alive; }
+		~FrameCounter() { --alive; }
+	};
+
+	Task<int> Value(int v) {
+		co_return v;
+	}
+
+	Task<int> AddOne(Task<int> t) {
+		int v = co_await t;
+		co_return v + 1;
+	}
+
+	Task<int> WaitEvent(TaskEvent& e, int v) {
+		FrameCounter c;
+		co_await e.Wait();
+		co_return v;
+	}
+
+	Task<> TickTwice(Scheduler* s, int& step) {
+		step = 1;
+		co_await NextTick(s);
+		step = 2;
+		co_await NextTick(s);
+		step = 3;
+	}
+
+	Task<int64_t> Sleep(Scheduler* s, int64_t nsec) {
+		int64_t t0 = s->GetElapsedNanoSeconds();
+		co_await Delay(s, nsec);
+		co_return s->GetElapsedNanoSeconds() - t0;
+	}
+
+	Task<std::thread::id> JobThenBack(Scheduler* s, std::thread::id& job_thread) {
+		job_thread = co_await RunJob([]() { return std::this_thread::get_id(); }, s);
+		co_return std::this_thread::get_id();
+	}
+
+	//Updates the scheduler until done() or 1 second has passed, timers fire in the first update
+	//after the wheel tick they expire in, not always in the next one
+	template<typename F>
+	bool UpdateUntil(Scheduler* s, F&& done) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+		while (!done() && std::chrono::steady_clock::now() < deadline) {
+			s->Update();
+			std::this_thread::yield();
+		}
+		return done();
+	}
+
+	template<typename T>
+	bool UpdateUntilDone(Scheduler* s, const Task<T>& t) {
+		return UpdateUntil(s, [&t]() { return t.Done(); });
+	}
+}
+
+TEST(TaskSynchronous) {
+	//Tasks that don't suspend are done when the call returns, awaiting them doesn't suspend either
+	Task<int> t = AddOne(Value(41));
+	CHECK(t.Done());
+	Task<int> outer = AddOne(std::move(t));
+	CHECK(outer.Done());
+	int v = 0;
+	[](Task<int>& t, int& v) -> Task<> { v = co_await t; }(outer, v);
+	CHECK(v == 43);
+}
+
+TEST(TaskEventAwaiter) {
+	TaskEvent e;
+	Task<int> inner = WaitEvent(e, 7);
+	CHECK(!inner.Done() && FrameCounter::alive == 1);
+	//The awaiting task is resumed by the thread finishing the inner one
+	Task<int> outer = AddOne(std::move(inner));
+	CHECK(!outer.Done());
+	std::thread setter([&e]() { e.Set(); });
+	setter.join();
+	CHECK(outer.Done());
+	int v = 0;
+	[](Task<int>& t, int& v) -> Task<> { v = co_await t; }(outer, v);
+	CHECK(v == 8);
+	//Already set, waiting doesn't suspend
+	Task<int> ready = WaitEvent(e, 1);
+	CHECK(ready.Done());
+	e.Reset();
+	CHECK(!e.IsSet());
+	{
+		//A dropped task finishes alone and frees its frame
+		Task<int> dropped = WaitEvent(e, 2);
+		CHECK(FrameCounter::alive == 1);
+	}
+	CHECK(FrameCounter::alive == 1);
+	e.Set();
+	CHECK(FrameCounter::alive == 0);
+}
+
+TEST(TaskSchedulerAwaiters) {
+	Scheduler::Init(1);
+	JobSystem::Init(2);
+	Scheduler* s = Scheduler::Get(0);
+
+	int step = 0;
+	Task<> ticks = TickTwice(s, step);
+	CHECK(step == 1);
+	//Each step waits for a scheduler update, they never run in the same update
+	CHECK(UpdateUntil(s, [&step]() { return step != 1; }) && step == 2);
+	CHECK(UpdateUntilDone(s, ticks) && step == 3);
+
+	static constexpr int64_t DELAY = MSEC_TO_NSEC(2);
+	Task<int64_t> sleep = Sleep(s, DELAY);
+	CHECK(!sleep.Done());
+	CHECK(UpdateUntilDone(s, sleep));
+	int64_t slept = 0;
+	[](Task<int64_t>& t, int64_t& v) -> Task<> { v = co_await t; }(sleep, slept);
+	CHECK(slept >= DELAY);
+
+	//The job runs in a worker and the task continues in the thread updating the scheduler
+	std::thread::id job_thread;
+	Task<std::thread::id> job = JobThenBack(s, job_thread);
+	CHECK(UpdateUntilDone(s, job));
+	std::thread::id resumed;
+	[](Task<std::thread::id>& t, std::thread::id& v) -> Task<> { v = co_await t; }(job, resumed);
+	CHECK(job_thread != std::this_thread::get_id());
+	CHECK(resumed == std::this_thread::get_id());
+
+	JobSystem::Release();
+	Scheduler::Release();
+}
+
+TEST(SchedulerRemoveRunningTimer) {
+	Scheduler::Init(1);
+	Scheduler* s = Scheduler::Get(0);
+
+	//Removal from other thread returns once the running callback is done
+	std::atomic<int> state = 0;
+	Scheduler::TimerId id = s->RegisterTimer(0, [&state](const Scheduler::TimerData&) {
+		state = 1;
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		state = 2;
+		return true;
+		});
+	std::thread updater([s, &state]() {
+		while (state == 0) {
+			s->Update();
+		}
+		});
+	while (state == 0) {
+		std::this_thread::yield();
+	}
+	CHECK(s->RemoveTimer(id));
+	CHECK(state == 2);
+	updater.join();
+	CHECK(!s->RemoveTimer(id));
+
+	//The callback can remove itself, it doesn't wait for itself
+	int calls = 0;
+	id = s->RegisterTimer(0, [s, &id, &calls](const Scheduler::TimerData&) {
+		++calls;
+		CHECK(s->RemoveTimer(id));
+		return true;
+		});
+	CHECK(UpdateUntil(s, [&calls]() { return calls > 0; }));
+	s->Update();
+	CHECK(calls == 1);
+
+	//Async removal doesn't wait
+	state = 0;
+	std::atomic<bool> release = false;
+	id = s->RegisterTimer(0, [&state, &release](const Scheduler::TimerData&) {
+		state = 1;
+		while (!release) {
+			std::this_thread::yield();
+		}
+		return true;
+		});
+	updater = std::thread([s, &state]() {
+		while (state == 0) {
+			s->Update();
+		}
+		});
+	while (state == 0) {
+		std::this_thread::yield();
+	}
+	s->RemoveTimerAsync(id);
+	release = true;
+	updater.join();
+	s->Update();
+	CHECK(!s->RemoveTimer(id));
+	Scheduler::Release();
+}
+
+TEST(BenchTask) {
+	static constexpr size_t N = 100000;
+	int64_t sum = 0;
+	Bench("Task call + co_await, ready", N, [&sum]() {
+		Task<int> t = AddOne(Value(1));
+		[](Task<int>& t, int64_t& sum) -> Task<> { sum += co_await t; }(t, sum);
+		});
+	Bench("Task suspend + TaskEvent resume", N, [&sum]() {
+		TaskEvent e;
+		Task<int> t = AddOne(WaitEvent(e, 1));
+		e.Set();
+		[](Task<int>& t, int64_t& sum) -> Task<> { sum += co_await t; }(t, sum);
+		});
+	Scheduler::Init(1);
+	Scheduler* s = Scheduler::Get(0);
+	Bench("2 x NextTick latency", N / 100, [s]() {
+		int step = 0;
+		Task<> t = TickTwice(s, step);
+		UpdateUntilDone(s, t);
+		});
+	Scheduler::Release();
+	bench_sink = (uint64_t)sum;
+}
@@ -0,0 +1,88 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace HotBite {
+	namespace Engine {
+		namespace Tests {
+
+			/**
+			 * Minimal test runner for the engine parts that don't need a window or a device.
+			 * Tests register themselves with TEST(name), a failed CHECK is reported and the test goes on.
+			 * Bench() prints the average time per iteration, benchmarks are part of the tests so the
+			 * numbers of every run can be compared.
+			 */
+			struct TestCase {
+				const char* name;
+				void(*run)();
+			};
+
+			std::vector<TestCase>& GetTests();
+			//Failed checks of the running test
+			int& GetFailures();
+
+			struct TestRegistrar {
+				TestRegistrar(const char* name, void(*run)()) {
+					GetTests().push_back({ name, run });
+				}
+			};
+
+			//Results are written here so the optimizer doesn't drop the benchmarked code
+			inline volatile uint64_t bench_sink = 0;
+
+			//Runs f iterations times and returns the average nanoseconds per iteration
+			template<typename F>
+			double Bench(const char* name, size_t iterations, F&& f) {
+				auto t0 = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < iterations; ++i) {
+					f();
+				}
+				auto t1 = std::chrono::steady_clock::now();
+				double nsec = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double)iterations;
+				printf("    %-40s %12.1f ns\n", name, nsec);
+				return nsec;
+			}
+		}
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static HotBite::Engine::Tests::TestRegistrar name##_registrar(#name, name); \
+	static void name()
+
+//Variadic so template arguments don't split the condition
+#define CHECK(...) \
+	do { \
+		if (!(__VA_ARGS__)) { \
+			printf("    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+			++HotBite::Engine::Tests::GetFailures(); \
+		} \
+	} while (0)
@@ -0,0 +1,60 @@
+/*
+The HotBite Game Engine
+
+Copyright(c) 2023 Vicente Sirvent Orts
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Test.h"
+#include <cstring>
+
+using namespace HotBite::Engine::Tests;
+
+std::vector<TestCase>& HotBite::Engine::Tests::GetTests() {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+int& HotBite::Engine::Tests::GetFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+//Usage: EngineTests [filter], only the tests with filter in their name are run
+int main(int argc, char** argv) {
+	const char* filter = (argc > 1) ? argv[1] : nullptr;
+	int run = 0;
+	int failed = 0;
+	for (const TestCase& t : GetTests()) {
+		if (filter != nullptr && strstr(t.name, filter) == nullptr) {
+			continue;
+		}
+		printf("%s\n", t.name);
+		GetFailures() = 0;
+		t.run();
+		++run;
+		if (GetFailures() > 0) {
+			printf("  FAILED (%d checks)\n", GetFailures());
+			++failed;
+		}
+	}
+	printf("%d tests, %d failed\n", run, failed);
+	return failed;
+}